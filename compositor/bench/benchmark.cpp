@@ -0,0 +1,130 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <thread>
+
+using namespace revyv;
+
+static std::atomic<uint64_t> allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+uint64_t revyv::get_allocation_count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+BenchmarkRunner::BenchmarkRunner(std::string filter, double min_time, std::ostream& log)
+    : _filter(std::move(filter))
+    , _min_time(min_time)
+    , _log(log)
+{
+}
+
+bool BenchmarkRunner::is_enabled(const std::string& name) const
+{
+    return _filter.empty() || name.find(_filter) != std::string::npos;
+}
+
+const std::vector<BenchmarkResult>& BenchmarkRunner::get_results() const
+{
+    return _results;
+}
+
+double BenchmarkRunner::get_thread_cpu_time()
+{
+    timespec time {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+uint64_t BenchmarkRunner::next_iteration_count(uint64_t iterations, double elapsed) const
+{
+    /* Aim a little past the minimum time, but never grow more than tenfold on a noisy short run. */
+    auto estimate = elapsed > 0 ? (double)iterations * _min_time * 1.4 / elapsed : (double)iterations * 10;
+    auto next = (uint64_t)std::clamp(estimate, (double)iterations * 2, (double)iterations * 10);
+    return std::min(next, MAX_ITERATIONS);
+}
+
+void BenchmarkRunner::add_result(const std::string& name, uint64_t iterations, double elapsed, double cpu_elapsed, uint64_t bytes, uint64_t allocations, uint64_t checksum)
+{
+    BenchmarkResult result {};
+    result.name = name;
+    result.iterations = iterations;
+    result.real_time = elapsed * 1e9 / (double)iterations;
+    result.cpu_time = cpu_elapsed * 1e9 / (double)iterations;
+    result.bytes_per_second = elapsed > 0 ? (double)bytes * (double)iterations / elapsed : 0;
+    result.items_per_second = elapsed > 0 ? (double)iterations / elapsed : 0;
+    result.allocations_per_iteration = (double)allocations / (double)iterations;
+    _results.push_back(result);
+
+    _log << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed << std::setprecision(1)
+         << result.real_time << " ns" << std::setw(14) << result.cpu_time << " ns" << std::setw(12) << iterations;
+    if (bytes > 0) {
+        _log << std::setw(12) << std::setprecision(1) << result.bytes_per_second / 1e6 << " MB/s";
+    }
+    _log << std::setw(10) << std::setprecision(2) << result.allocations_per_iteration << " allocs"
+         << " (checksum " << checksum << ")" << std::defaultfloat << std::endl;
+}
+
+static void write_json_string(std::ostream& stream, const std::string& value)
+{
+    stream << '"';
+    for (auto c : value) {
+        if (c == '"' || c == '\\') {
+            stream << '\\';
+        }
+        stream << c;
+    }
+    stream << '"';
+}
+
+void BenchmarkRunner::write_json(std::ostream& stream, const std::string& executable) const
+{
+    char date[32] {};
+    auto now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+    stream << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n    \"executable\": ";
+    write_json_string(stream, executable);
+    stream << ",\n    \"num_cpus\": " << std::thread::hardware_concurrency()
+#ifdef NDEBUG
+           << ",\n    \"library_build_type\": \"release\""
+#else
+           << ",\n    \"library_build_type\": \"debug\""
+#endif
+           << "\n  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < _results.size(); i++) {
+        auto& result = _results[i];
+        stream << (i == 0 ? "\n" : ",\n") << "    {\n      \"name\": ";
+        write_json_string(stream, result.name);
+        stream << ",\n      \"run_name\": ";
+        write_json_string(stream, result.name);
+        stream << ",\n      \"run_type\": \"iteration\",\n      \"iterations\": " << result.iterations
+               << ",\n      \"real_time\": " << result.real_time << ",\n      \"cpu_time\": " << result.cpu_time
+               << ",\n      \"time_unit\": \"ns\",\n      \"bytes_per_second\": " << result.bytes_per_second
+               << ",\n      \"items_per_second\": " << result.items_per_second
+               << ",\n      \"allocations_per_iteration\": " << result.allocations_per_iteration << "\n    }";
+    }
+    stream << "\n  ]\n}" << std::endl;
+}
@@ -0,0 +1,101 @@
+#ifndef REVYV_BENCHMARK_H
+#define REVYV_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace revyv {
+
+typedef struct
+{
+    std::string name;
+    uint64_t iterations;
+    /* Nanoseconds per iteration. */
+    double real_time;
+    double cpu_time;
+    double bytes_per_second;
+    double items_per_second;
+    double allocations_per_iteration;
+} BenchmarkResult;
+
+/* Heap allocations made by the whole process so far. */
+[[nodiscard]] uint64_t get_allocation_count();
+
+/*
+ * Runs every benchmark until it took at least the minimum time, doubling the
+ * iterations between runs, and keeps the results. A benchmark is a function
+ * of the iteration index returning a checksum, so its work can't be
+ * optimized away.
+ */
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(std::string filter, double min_time, std::ostream& log);
+
+    [[nodiscard]] bool is_enabled(const std::string& name) const;
+
+    /* bytes is the amount of data one iteration handles, 0 when it makes no sense. */
+    template <typename F>
+    void run(const std::string& name, uint64_t bytes, F&& f)
+    {
+        if (!is_enabled(name)) {
+            return;
+        }
+        uint64_t checksum = f(0);
+        uint64_t iterations = 1;
+        while (true) {
+            auto allocations = get_allocation_count();
+            auto cpu_start = get_thread_cpu_time();
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; i++) {
+                checksum += f(i);
+            }
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            auto cpu_elapsed = get_thread_cpu_time() - cpu_start;
+            if (elapsed >= _min_time || iterations >= MAX_ITERATIONS) {
+                add_result(name, iterations, elapsed, cpu_elapsed, bytes, get_allocation_count() - allocations, checksum);
+                return;
+            }
+            iterations = next_iteration_count(iterations, elapsed);
+        }
+    }
+
+    [[nodiscard]] const std::vector<BenchmarkResult>& get_results() const;
+
+    /* The same layout as Google Benchmark's, so its tools can compare two runs. */
+    void write_json(std::ostream& stream, const std::string& executable) const;
+
+private:
+    static constexpr uint64_t MAX_ITERATIONS = 1000000000;
+
+    [[nodiscard]] static double get_thread_cpu_time();
+
+    [[nodiscard]] uint64_t next_iteration_count(uint64_t iterations, double elapsed) const;
+
+    void add_result(const std::string& name, uint64_t iterations, double elapsed, double cpu_elapsed, uint64_t bytes, uint64_t allocations, uint64_t checksum);
+
+private:
+    std::string _filter;
+    double _min_time;
+    std::ostream& _log;
+    std::vector<BenchmarkResult> _results;
+};
+
+/* The suites, each file covers one hot path. */
+void run_compression_benchmarks(BenchmarkRunner& runner);
+
+void run_payload_benchmarks(BenchmarkRunner& runner);
+
+void run_hit_test_benchmarks(BenchmarkRunner& runner);
+
+void run_compose_benchmarks(BenchmarkRunner& runner);
+
+/* Routes the input recording at recording_path instead of synthetic events when it is not empty. */
+void run_event_router_benchmarks(BenchmarkRunner& runner, const std::string& recording_path);
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "benchmark.h"
+#include "sdl_compositor.h"
+#include "sdl_window.h"
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+
+using namespace revyv;
+
+static const Size SCREEN_SIZE = make_size(1920, 1080);
+static const Size WINDOW_SIZE = make_size(512, 384);
+static const Size DIRTY_SIZE = make_size(256, 128);
+
+static void run_window_count(BenchmarkRunner& runner, const std::shared_ptr<WorkPool>& work_pool, uint32_t window_count)
+{
+    auto suffix = "/" + std::to_string(window_count);
+    if (!runner.is_enabled("compose/static" + suffix) && !runner.is_enabled("compose/update" + suffix)) {
+        return;
+    }
+
+    /*
+     * Headless, so the numbers are the compositor's own work rather than a
+     * GPU's. No limits, every update is applied on the frame it is posted.
+     */
+    auto compositor = std::make_shared<SDLCompositor>(SCREEN_SIZE, 0, 0, work_pool, true);
+    if (compositor->get_renderer() == nullptr) {
+        std::cerr << "Skipping compose benchmarks: " << SDL_GetError() << std::endl;
+        return;
+    }
+    compositor->set_background_update_interval(0);
+
+    auto window_bytes = (size_t)(WINDOW_SIZE.width * WINDOW_SIZE.height * 4);
+    auto window_pixels = std::shared_ptr<unsigned char[]>(new unsigned char[window_bytes]);
+    std::fill(window_pixels.get(), window_pixels.get() + window_bytes, 0x80);
+    auto dirty_bytes = (size_t)(DIRTY_SIZE.width * DIRTY_SIZE.height * 4);
+    auto dirty_pixels = std::shared_ptr<unsigned char[]>(new unsigned char[dirty_bytes]);
+    std::fill(dirty_pixels.get(), dirty_pixels.get() + dirty_bytes, 0x40);
+
+    /* Cascaded so they overlap, like windows on a real screen. */
+    std::vector<std::shared_ptr<Window>> windows;
+    for (uint32_t i = 0; i < window_count; i++) {
+        auto window = std::make_shared<SDLWindow>(getpid(), i + 1, compositor->get_native_raster_type(), compositor->get_renderer(), compositor->get_texture_uploader());
+        auto x = (double)((i * 37) % (uint32_t)(SCREEN_SIZE.width - WINDOW_SIZE.width));
+        auto y = (double)((i * 23) % (uint32_t)(SCREEN_SIZE.height - WINDOW_SIZE.height));
+        window->create(window_pixels, window_bytes, make_rect(x, y, WINDOW_SIZE.width, WINDOW_SIZE.height), false);
+        compositor->add_window(window);
+        windows.push_back(window);
+    }
+    auto get_pending_task_count = [&windows]() {
+        uint64_t count = 0;
+        for (auto& window : windows) {
+            count += window->get_pending_task_count();
+        }
+        return count;
+    };
+    for (size_t frame = 0; frame < 100 && get_pending_task_count() > 0; frame++) {
+        compositor->compose();
+    }
+
+    runner.run("compose/static" + suffix, 0, [&](uint64_t) -> uint64_t {
+        compositor->compose();
+        return get_pending_task_count();
+    });
+
+    runner.run("compose/update" + suffix, dirty_bytes * window_count, [&](uint64_t i) -> uint64_t {
+        auto x = (double)((i * 16) % (uint64_t)(WINDOW_SIZE.width - DIRTY_SIZE.width));
+        auto y = (double)((i * 8) % (uint64_t)(WINDOW_SIZE.height - DIRTY_SIZE.height));
+        for (auto& window : windows) {
+            window->update_pixels(dirty_pixels, dirty_bytes, make_rect(x, y, DIRTY_SIZE.width, DIRTY_SIZE.height), {}, false);
+        }
+        compositor->compose();
+        return get_pending_task_count();
+    });
+
+    /* Textures go before the renderer does, the frame lets go of the windows it kept. */
+    compositor->remove_windows_by_pid(getpid());
+    windows.clear();
+    compositor->compose();
+}
+
+void revyv::run_compose_benchmarks(BenchmarkRunner& runner)
+{
+    auto work_pool = std::make_shared<WorkPool>(0);
+    for (uint32_t window_count : { 1, 16, 64 }) {
+        run_window_count(runner, work_pool, window_count);
+    }
+}
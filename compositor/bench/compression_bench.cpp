@@ -0,0 +1,113 @@
+#include "benchmark.h"
+#include <compressor.h>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace revyv;
+
+typedef struct {
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+} Resolution;
+
+typedef enum : uint8_t {
+    ContentSolid = 0,
+    ContentText = 1,
+    ContentGradient = 2,
+    ContentNoise = 3,
+} Content;
+
+static const char* get_content_name(Content content)
+{
+    switch (content) {
+    case ContentSolid:
+        return "solid";
+    case ContentText:
+        return "text";
+    case ContentGradient:
+        return "gradient";
+    case ContentNoise:
+        return "noise";
+    default:
+        return "unknown";
+    }
+}
+
+/* ARGB pixels standing in for what browser windows send. */
+static std::vector<unsigned char> make_pixels(const Resolution& resolution, Content content)
+{
+    std::vector<unsigned char> pixels((size_t)resolution.width * resolution.height * 4);
+    std::mt19937 random(11);
+    for (uint32_t y = 0; y < resolution.height; y++) {
+        for (uint32_t x = 0; x < resolution.width; x++) {
+            auto pixel = &pixels[((size_t)y * resolution.width + x) * 4];
+            uint32_t value = 0xfff4f4f4;
+            if (content == ContentText) {
+                /* Short dark runs on lines of glyphs, like a page of text on a light background. */
+                auto line = y % 20;
+                if (line > 4 && line < 16 && (x / 7 + y / 20) % 11 != 0 && (random() % 3) == 0) {
+                    value = 0xff202020 + (random() % 0x40) * 0x010101;
+                }
+            } else if (content == ContentGradient) {
+                value = 0xff000000 | ((x * 255 / resolution.width) << 16) | ((y * 255 / resolution.height) << 8) | ((x + y) & 0xff);
+            } else if (content == ContentNoise) {
+                value = 0xff000000 | (random() & 0xffffff);
+            }
+            std::memcpy(pixel, &value, 4);
+        }
+    }
+    return pixels;
+}
+
+void revyv::run_compression_benchmarks(BenchmarkRunner& runner)
+{
+    std::vector<Resolution> resolutions { { "640x480", 640, 480 }, { "1920x1080", 1920, 1080 }, { "3840x2160", 3840, 2160 } };
+    std::vector<Content> contents { ContentSolid, ContentText, ContentGradient, ContentNoise };
+    if (lzo_init() != LZO_E_OK) {
+        return;
+    }
+
+    for (auto& resolution : resolutions) {
+        for (auto content : contents) {
+            auto suffix = std::string("/") + resolution.name + "/" + get_content_name(content);
+            if (!runner.is_enabled("compress" + suffix) && !runner.is_enabled("decompress" + suffix)) {
+                continue;
+            }
+            auto pixels = make_pixels(resolution, content);
+
+            /* Incompressible content is sent as it is, there is nothing to decompress. */
+            std::shared_ptr<unsigned char[]> compressed;
+            size_t compressed_size = 0;
+            try {
+                Compressor compressor(pixels.data(), pixels.size());
+                compressed = compressor.getData();
+                compressed_size = compressor.getSize();
+            } catch (FailedToCompressDataError&) {
+            }
+
+            runner.run("compress" + suffix, pixels.size(), [&](uint64_t) -> uint64_t {
+                try {
+                    Compressor compressor(pixels.data(), pixels.size());
+                    return compressor.getSize();
+                } catch (FailedToCompressDataError&) {
+                    return 0;
+                }
+            });
+
+            if (compressed == nullptr) {
+                continue;
+            }
+            std::vector<unsigned char> decompressed(pixels.size());
+            runner.run("decompress" + suffix, pixels.size(), [&](uint64_t) -> uint64_t {
+                lzo_uint size = decompressed.size();
+                if (lzo1x_decompress(compressed.get(), compressed_size, decompressed.data(), &size, nullptr) != LZO_E_OK) {
+                    return 0;
+                }
+                return size + decompressed[size / 2];
+            });
+        }
+    }
+}
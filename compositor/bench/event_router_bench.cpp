@@ -0,0 +1,132 @@
+#include "benchmark.h"
+#include "null_compositor.h"
+#include "replay_event_source.h"
+#include "window_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <zmq.hpp>
+
+using namespace revyv;
+
+static std::vector<Event> make_events(size_t count, const Size& screen)
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> x(0, screen.width), y(0, screen.height);
+    std::vector<Event> events;
+    auto pointer = make_point(screen.width / 2, screen.height / 2);
+    for (size_t i = 0; i < count; i++) {
+        auto kind = random() % 100;
+        Event event {};
+        if (kind < 70) {
+            pointer.x = std::clamp(pointer.x + (double)(random() % 9) - 4, 0.0, screen.width);
+            pointer.y = std::clamp(pointer.y + (double)(random() % 9) - 4, 0.0, screen.height);
+            event = make_event(EventTypeMouseMove);
+        } else if (kind < 80) {
+            pointer = make_point(x(random), y(random));
+            event = make_event(EventTypeMouseButton);
+            event.mouse.button = MouseButtonTypeLeft;
+            event.mouse.state = (i % 2) ? MouseButtonStateReleased : MouseButtonStatePressed;
+            event.mouse.clicks = 1;
+        } else if (kind < 90) {
+            event = make_event(EventTypeMouseScroll);
+            event.mouse.scroll_y = 1;
+        } else if (kind < 95) {
+            event = make_event(EventTypeKey);
+            event.key.keycode = 'a';
+            event.key.state = KeyStatePressed;
+        } else {
+            event = make_event(EventTypeText);
+            set_event_text(event, "a");
+        }
+        if (event.type == EventTypeMouseMove || event.type == EventTypeMouseButton || event.type == EventTypeMouseScroll) {
+            event.mouse.x = pointer.x;
+            event.mouse.y = pointer.y;
+        }
+        event.timestamp = (uint32_t)i;
+        events.push_back(event);
+    }
+    return events;
+}
+
+static std::vector<Event> load_events(const std::string& path)
+{
+    ReplayEventSource source(path, 0, nullptr);
+    std::vector<Event> events;
+    Event event {};
+    while (!source.is_finished()) {
+        while (source.poll_event(event)) {
+            events.push_back(event);
+        }
+    }
+    return events;
+}
+
+void revyv::run_event_router_benchmarks(BenchmarkRunner& runner, const std::string& recording_path)
+{
+    const size_t events_per_frame = 16;
+    const auto screen = make_size(1920, 1080);
+    auto suffix = recording_path.empty() ? std::string("/synthetic") : std::string("/recording");
+    if (!runner.is_enabled("event_router/route" + suffix) && !runner.is_enabled("event_router/publish" + suffix)) {
+        return;
+    }
+
+    auto compositor = std::make_shared<NullCompositor>(screen);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> x(0, screen.width), y(0, screen.height), extent(100, 800);
+    for (uint32_t i = 0; i < 100; i++) {
+        compositor->add_window(std::make_shared<NullWindow>(getpid(), i + 1, make_rect(x(random), y(random), extent(random), extent(random))));
+    }
+    auto events = recording_path.empty() ? make_events(100000, screen) : load_events(recording_path);
+    if (events.empty()) {
+        return;
+    }
+
+    {
+        WindowManager window_manager(compositor, [](pid_t) { return std::weak_ptr<Publisher>(); });
+        runner.run("event_router/route" + suffix, 0, [&](uint64_t i) -> uint64_t {
+            auto routed = events[i % events.size()];
+            uint64_t checksum = window_manager.route_event(routed);
+            return checksum + event_to_payload(routed).window_id;
+        });
+    }
+
+    if (!runner.is_enabled("event_router/publish" + suffix)) {
+        return;
+    }
+
+    /* The client end, drained on its own thread so the publisher never blocks. */
+    zmq::context_t context;
+    zmq::socket_t client(context, ZMQ_PULL);
+    client.bind("ipc:///tmp/revyv-publisher-" + std::to_string(PUBLISHER_PORT_BASE + getpid()));
+    std::atomic<bool> running = true;
+    std::thread drain([&]() {
+        zmq::message_t message;
+        while (running) {
+            zmq::pollitem_t items[] = { { static_cast<void*>(client), 0, ZMQ_POLLIN, 0 } };
+            zmq::poll(items, 1, std::chrono::milliseconds(10));
+            while (client.recv(message, zmq::recv_flags::dontwait).has_value()) { }
+        }
+    });
+    auto publisher = std::make_shared<Publisher>(getpid());
+
+    {
+        WindowManager window_manager(compositor, [&publisher](pid_t) { return std::weak_ptr<Publisher>(publisher); });
+        /* Allocations here include the ones zmq makes for each message. */
+        runner.run("event_router/publish" + suffix, 0, [&](uint64_t i) -> uint64_t {
+            auto& event = events[i % events.size()];
+            window_manager.send_event(event);
+            if (i % events_per_frame == events_per_frame - 1) {
+                window_manager.flush_mouse_move_events();
+            }
+            return event.timestamp;
+        });
+        window_manager.flush_mouse_move_events();
+    }
+
+    running = false;
+    drain.join();
+}
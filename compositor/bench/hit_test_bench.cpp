@@ -0,0 +1,70 @@
+#include "benchmark.h"
+#include "null_compositor.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+using namespace revyv;
+
+static void run_window_count(BenchmarkRunner& runner, size_t window_count)
+{
+    const auto screen = make_size(1920, 1080);
+    auto suffix = "/" + std::to_string(window_count);
+    auto names = { "hit_test/linear/random", "hit_test/index/random", "hit_test/linear/trail", "hit_test/index/trail", "hit_test/move", "hit_test/raise" };
+    if (std::none_of(names.begin(), names.end(), [&](const char* name) { return runner.is_enabled(name + suffix); })) {
+        return;
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> x(0, screen.width), y(0, screen.height), extent(50, 400);
+
+    NullCompositor compositor(screen);
+    std::vector<std::shared_ptr<Window>> windows;
+    for (size_t i = 0; i < window_count; i++) {
+        auto window = std::make_shared<NullWindow>(0, i + 1, make_rect(x(random), y(random), extent(random), extent(random)));
+        compositor.add_window(window);
+        windows.push_back(window);
+    }
+
+    std::vector<Point> points;
+    for (size_t i = 0; i < 4096; i++) {
+        points.push_back(make_point(x(random), y(random)));
+    }
+    std::vector<Point> trail;
+    auto pointer = make_point(screen.width / 2, screen.height / 2);
+    for (size_t i = 0; i < 4096; i++) {
+        pointer.x = std::clamp(pointer.x + (double)(random() % 7) - 3, 0.0, screen.width);
+        pointer.y = std::clamp(pointer.y + (double)(random() % 7) - 3, 0.0, screen.height);
+        trail.push_back(pointer);
+    }
+
+    auto id_of = [](const std::weak_ptr<Window>& w) { return w.expired() ? 0 : w.lock()->get_id(); };
+
+    for (auto& point : points) {
+        if (id_of(compositor.find_window_in_location(point)) != id_of(compositor.find_window_in_location_linear(point))) {
+            throw std::runtime_error("Hit test mismatch at " + std::to_string(point.x) + "," + std::to_string(point.y));
+        }
+    }
+
+    runner.run("hit_test/linear/random" + suffix, 0, [&](uint64_t i) { return id_of(compositor.find_window_in_location_linear(points[i % points.size()])); });
+    runner.run("hit_test/index/random" + suffix, 0, [&](uint64_t i) { return id_of(compositor.find_window_in_location(points[i % points.size()])); });
+    runner.run("hit_test/linear/trail" + suffix, 0, [&](uint64_t i) { return id_of(compositor.find_window_in_location_linear(trail[i % trail.size()])); });
+    runner.run("hit_test/index/trail" + suffix, 0, [&](uint64_t i) { return id_of(compositor.find_window_in_location(trail[i % trail.size()])); });
+    runner.run("hit_test/move" + suffix, 0, [&](uint64_t i) {
+        auto& window = windows[i % windows.size()];
+        window->move(make_point(x(random), y(random)));
+        return window->get_id();
+    });
+    runner.run("hit_test/raise" + suffix, 0, [&](uint64_t i) {
+        auto& window = windows[i % windows.size()];
+        compositor.window_bring_to_front(window);
+        return window->get_id();
+    });
+}
+
+void revyv::run_hit_test_benchmarks(BenchmarkRunner& runner)
+{
+    for (size_t window_count : { 10, 100, 1000, 10000 }) {
+        run_window_count(runner, window_count);
+    }
+}
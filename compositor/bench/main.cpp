@@ -0,0 +1,43 @@
+#include "benchmark.h"
+#include <argh.h>
+#include <fstream>
+#include <iostream>
+
+using namespace revyv;
+
+int main(int argc, char** argv)
+{
+    /*
+     * revyv-bench [--filter=<substring of benchmark names>] [--min-time=<seconds per benchmark>]
+     *             [--format=console|json] [--out=<JSON results file>] [--recording=<input recording to route>]
+     */
+    try {
+        argh::parser cmdl({ "--filter", "--min-time", "--format", "--out", "--recording" });
+        cmdl.parse(argc, argv);
+        double min_time = 0.5;
+        if (!cmdl("min-time").str().empty()) {
+            min_time = std::atof(cmdl("min-time").str().c_str());
+        }
+        /* With JSON on stdout the progress goes to stderr. */
+        auto json = cmdl("format").str() == "json";
+        BenchmarkRunner runner(cmdl("filter").str(), min_time, json ? std::cerr : std::cout);
+
+        run_compression_benchmarks(runner);
+        run_payload_benchmarks(runner);
+        run_hit_test_benchmarks(runner);
+        run_event_router_benchmarks(runner, cmdl("recording").str());
+        run_compose_benchmarks(runner);
+
+        if (json) {
+            runner.write_json(std::cout, argv[0]);
+        }
+        if (!cmdl("out").str().empty()) {
+            std::ofstream stream(cmdl("out").str());
+            runner.write_json(stream, argv[0]);
+        }
+        return 0;
+    } catch (std::exception& e) {
+        std::cout << __func__ << ": " << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef REVYV_NULLCOMPOSITOR_H
+#define REVYV_NULLCOMPOSITOR_H
+
+#include "compositor.h"
+
+namespace revyv {
+
+/* Window and compositor that keep geometry only, for benchmarks without a renderer. */
+class NullWindow : public Window {
+public:
+    NullWindow(pid_t pid, uint32_t id, const Rect& frame)
+        : Window(pid, id, WindowRasterARGB)
+    {
+        set_frame(frame);
+    }
+
+    void perform_operations() override { }
+
+    void draw() override { }
+
+    [[nodiscard]] size_t get_pending_task_count() const override { return 0; }
+
+    void move(Point point) override { set_location(point); }
+
+    void create(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect, bool opaque) override { }
+
+    void resize(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque) override { }
+
+    void resize_buffer(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque) override { }
+
+    void update_pixels(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& dirty_rect, const UpdateStamp& stamp, bool opaque) override { }
+
+    void update_rects(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const std::vector<Rect>& dirty_rects, const UpdateStamp& stamp, bool opaque) override { }
+
+    [[nodiscard]] bool is_texture_resident() const override { return true; }
+
+    [[nodiscard]] uint64_t get_texture_bytes() const override { return 0; }
+
+    [[nodiscard]] uint64_t get_evicted_bytes() const override { return 0; }
+
+    void evict_texture() override { }
+};
+
+class NullCompositor : public Compositor {
+public:
+    explicit NullCompositor(const Size& size)
+        : Compositor(size)
+    {
+    }
+
+    void compose() override { }
+
+    [[nodiscard]] WindowRasterType get_native_raster_type() const override { return WindowRasterARGB; }
+
+    /* Hit test without the spatial index, walks the stacking order from the top. */
+    std::weak_ptr<Window> find_window_in_location_linear(Point location)
+    {
+        std::shared_ptr<Window> hit;
+        _window_table.for_each_top_to_bottom([&](const std::shared_ptr<Window>& window, const Rect& frame, bool visible) {
+            if (visible && location.x >= frame.location.x && location.x <= frame.location.x + frame.size.width
+                && location.y >= frame.location.y && location.y <= frame.location.y + frame.size.height) {
+                hit = window;
+                return false;
+            }
+            return true;
+        });
+        return hit;
+    }
+};
+
+}
+
+#endif
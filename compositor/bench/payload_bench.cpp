@@ -0,0 +1,74 @@
+#include "benchmark.h"
+#include <compositor/types.h>
+#include <vector>
+#include <zmq.hpp>
+
+using namespace revyv;
+
+/* Every kind of event a client receives, one after the other. */
+static std::vector<Event> make_events()
+{
+    std::vector<Event> events;
+    auto move = make_event(EventTypeMouseMove);
+    move.mouse.x = 640.5;
+    move.mouse.y = 360.25;
+    events.push_back(move);
+    auto button = make_event(EventTypeMouseButton);
+    button.mouse.button = MouseButtonTypeLeft;
+    button.mouse.state = MouseButtonStatePressed;
+    button.mouse.clicks = 1;
+    events.push_back(button);
+    auto scroll = make_event(EventTypeMouseScroll);
+    scroll.mouse.scroll_y = -3;
+    events.push_back(scroll);
+    auto key = make_event(EventTypeKey);
+    key.key.keycode = 'a';
+    key.key.state = KeyStatePressed;
+    events.push_back(key);
+    auto text = make_event(EventTypeText);
+    set_event_text(text, "a");
+    events.push_back(text);
+    for (size_t i = 0; i < events.size(); i++) {
+        events[i].window_id = (uint32_t)i + 1;
+        events[i].timestamp = (uint32_t)i;
+    }
+    return events;
+}
+
+void revyv::run_payload_benchmarks(BenchmarkRunner& runner)
+{
+    runner.run("payload/listener/encode", sizeof(ListenerPayload), [](uint64_t i) -> uint64_t {
+        auto payload = WindowUpdatePixelsPayload((uint32_t)i, 10, 20, 640, 480, 640 * 480 * 4, true, 4096, 7).get_payload();
+        zmq::message_t message(&payload, sizeof(ListenerPayload));
+        return message.size() + message.data<unsigned char>()[i % sizeof(ListenerPayload)];
+    });
+
+    zmq::message_t listener_message(sizeof(ListenerPayload));
+    auto listener_payload = WindowUpdatePixelsPayload(1, 10, 20, 640, 480, 640 * 480 * 4, true, 4096, 7).get_payload();
+    std::memcpy(listener_message.data(), &listener_payload, sizeof(ListenerPayload));
+    runner.run("payload/listener/decode", sizeof(ListenerPayload), [&listener_message](uint64_t) -> uint64_t {
+        ListenerPayload p {};
+        std::memcpy(&p, listener_message.data(), sizeof(ListenerPayload));
+        if (p.type != RequestTypeWindowUpdatePixels) {
+            return 0;
+        }
+        auto payload = WindowUpdatePixelsPayload(p);
+        return payload.get_window_id() + (uint64_t)(payload.get_x() + payload.get_width()) + payload.get_data_size() + payload.get_compressed_size();
+    });
+
+    auto events = make_events();
+    runner.run("payload/publisher/encode", sizeof(PublisherPayload), [&events](uint64_t i) -> uint64_t {
+        auto payload = event_to_payload(events[i % events.size()]);
+        zmq::message_t message(&payload, sizeof(PublisherPayload));
+        return message.size() + payload.type;
+    });
+
+    std::vector<PublisherPayload> payloads;
+    for (auto& event : events) {
+        payloads.push_back(event_to_payload(event));
+    }
+    runner.run("payload/publisher/decode", sizeof(PublisherPayload), [&payloads](uint64_t i) -> uint64_t {
+        auto event = event_from_payload(payloads[i % payloads.size()]);
+        return event.window_id + event.type + event.timestamp;
+    });
+}
@@ -0,0 +1,130 @@
+#ifndef REVYV_COMPOSITOR_LATENCYHISTOGRAM_H
+#define REVYV_COMPOSITOR_LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace revyv {
+
+/*
+ * Monotonic clock in nanoseconds. steady_clock is CLOCK_MONOTONIC on Linux and
+ * the uptime clock on macOS, both shared by every process on the machine, so
+ * stamps taken by the compositor and by a client can be subtracted.
+ */
+[[nodiscard]] inline uint64_t get_monotonic_time_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+} LatencySummary;
+
+/*
+ * Log-linear histogram of nanosecond durations, 16 buckets per power of two
+ * so percentiles are within about 6%. Recording is wait-free and may happen
+ * on one thread while another reads the summary.
+ */
+class LatencyHistogram {
+public:
+    void record(uint64_t ns)
+    {
+        _counts[get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        auto max = _max.load(std::memory_order_relaxed);
+        while (ns > max && !_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) { }
+    }
+
+    [[nodiscard]] LatencySummary get_summary() const
+    {
+        LatencySummary summary {};
+        summary.count = _count.load(std::memory_order_relaxed);
+        summary.max = _max.load(std::memory_order_relaxed);
+        summary.p50 = get_percentile(summary.count, 0.50, summary.max);
+        summary.p99 = get_percentile(summary.count, 0.99, summary.max);
+        return summary;
+    }
+
+    void reset()
+    {
+        for (auto& count : _counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        _count.store(0, std::memory_order_relaxed);
+        _max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t SUB_BUCKET_BITS = 4;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    /* Durations are clamped to 2^40 ns, about 18 minutes. */
+    static constexpr uint32_t MAX_BIT = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_BIT - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+
+    [[nodiscard]] static size_t get_bucket(uint64_t ns)
+    {
+        if (ns < 2 * SUB_BUCKET_COUNT) {
+            return (size_t)ns;
+        }
+        if (ns >= (1ULL << MAX_BIT)) {
+            ns = (1ULL << MAX_BIT) - 1;
+        }
+        uint32_t top_bit = 63 - __builtin_clzll(ns);
+        uint32_t shift = top_bit - SUB_BUCKET_BITS;
+        return (size_t)(shift * SUB_BUCKET_COUNT + (ns >> shift));
+    }
+
+    /* The largest duration that falls into the bucket. */
+    [[nodiscard]] static uint64_t get_bucket_limit(size_t bucket)
+    {
+        if (bucket < 2 * SUB_BUCKET_COUNT) {
+            return bucket;
+        }
+        uint64_t shift = bucket / SUB_BUCKET_COUNT - 1;
+        uint64_t mantissa = bucket - shift * SUB_BUCKET_COUNT;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    [[nodiscard]] uint64_t get_percentile(uint64_t count, double percentile, uint64_t max) const
+    {
+        if (count == 0) {
+            return 0;
+        }
+        auto target = (uint64_t)((double)count * percentile + 0.5);
+        if (target == 0) {
+            target = 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            seen += _counts[i].load(std::memory_order_relaxed);
+            if (seen >= target) {
+                auto limit = get_bucket_limit(i);
+                return limit < max ? limit : max;
+            }
+        }
+        return max;
+    }
+
+private:
+    std::atomic<uint64_t> _counts[BUCKET_COUNT] {};
+    std::atomic<uint64_t> _count = 0;
+    std::atomic<uint64_t> _max = 0;
+};
+
+/* Writes "name p50 0.12 ms p99 0.40 ms max 1.20 ms (n)". */
+inline void write_latency_summary(std::ostream& stream, const char* name, const LatencySummary& summary)
+{
+    stream << name << " p50 " << (double)summary.p50 / 1e6 << " ms p99 " << (double)summary.p99 / 1e6
+           << " ms max " << (double)summary.max / 1e6 << " ms (" << summary.count << ")";
+}
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef REVYV_COMPOSITOR_TRACE_H
+#define REVYV_COMPOSITOR_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <compositor/latency_histogram.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <pthread.h>
+#else
+#include <sys/syscall.h>
+#endif
+
+namespace revyv {
+
+typedef enum : uint8_t {
+    TraceFlowStart = 0,
+    TraceFlowStep = 1,
+    TraceFlowEnd = 2,
+} TraceFlow;
+
+/* Longest event format_trace_span() and format_trace_flow() write. */
+const size_t TRACE_EVENT_SIZE_MAX = 256;
+
+[[nodiscard]] inline uint64_t get_trace_thread_id()
+{
+#ifdef __APPLE__
+    uint64_t id = 0;
+    pthread_threadid_np(nullptr, &id);
+    return id;
+#else
+    return (uint64_t)syscall(SYS_gettid);
+#endif
+}
+
+[[nodiscard]] inline const char* get_trace_process_name()
+{
+#ifdef __APPLE__
+    return getprogname();
+#else
+    return program_invocation_short_name;
+#endif
+}
+
+/* Chrome trace event of a span from start to end, monotonic nanoseconds. Events end in a comma and a newline. */
+inline int format_trace_span(char* event, size_t capacity, pid_t pid, uint64_t tid, const char* name, uint64_t start, uint64_t end, uint64_t flow_id)
+{
+    if (flow_id != 0) {
+        return std::snprintf(event, capacity,
+            "{\"name\":\"%s\",\"cat\":\"revyv\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%llu,\"args\":{\"update\":\"%llx\"}},\n",
+            name, (double)start / 1e3, (double)(end - start) / 1e3, pid, (unsigned long long)tid, (unsigned long long)flow_id);
+    }
+    return std::snprintf(event, capacity,
+        "{\"name\":\"%s\",\"cat\":\"revyv\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%llu},\n",
+        name, (double)start / 1e3, (double)(end - start) / 1e3, pid, (unsigned long long)tid);
+}
+
+/* Chrome trace flow event, bound to the span enclosing time on thread tid. */
+inline int format_trace_flow(char* event, size_t capacity, pid_t pid, uint64_t tid, TraceFlow flow, uint64_t flow_id, uint64_t time)
+{
+    static const char* phases[] = { "s", "t", "f" };
+    return std::snprintf(event, capacity,
+        "{\"name\":\"update\",\"cat\":\"update\",\"ph\":\"%s\",\"bp\":\"e\",\"id\":%llu,\"ts\":%.3f,\"pid\":%d,\"tid\":%llu},\n",
+        phases[flow], (unsigned long long)flow_id, (double)time / 1e3, pid, (unsigned long long)tid);
+}
+
+inline int format_trace_process_name(char* event, size_t capacity, pid_t pid)
+{
+    return std::snprintf(event, capacity, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s %d\"}},\n",
+        pid, get_trace_process_name(), pid);
+}
+
+/* Receives the spans and flows of every thread, on the thread that traced them. */
+class TraceSink {
+public:
+    virtual ~TraceSink() = default;
+
+    virtual void record_span(const char* name, uint64_t start, uint64_t end, uint64_t flow_id) = 0;
+
+    virtual void record_flow(TraceFlow flow, uint64_t flow_id, uint64_t time) = 0;
+};
+
+/*
+ * Chrome trace event writer, compiled in and enabled at runtime by setting
+ * REVYV_TRACE to a file. The compositor and every client append to the same
+ * file in the JSON array format, which chrome://tracing and Perfetto load
+ * without the closing bracket. Timestamps come from the monotonic clock all
+ * processes share, and a pixel update is followed from the client to the
+ * frame that presented it by a flow named after its UpdateStamp. A sink,
+ * when set, gets the events whether or not they are written.
+ */
+class Tracer {
+public:
+    [[nodiscard]] static Tracer& get()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    ~Tracer()
+    {
+        if (_fd >= 0) {
+            flush();
+            close(_fd);
+        }
+    }
+
+    Tracer(const Tracer&) = delete;
+
+    Tracer& operator=(const Tracer&) = delete;
+
+    [[nodiscard]] bool is_enabled() const { return _fd >= 0 || _sink.load(std::memory_order_relaxed) != nullptr; }
+
+    /* The sink has to outlive the threads tracing while it is set. */
+    void set_sink(TraceSink* sink) { _sink.store(sink, std::memory_order_release); }
+
+    void write_span(const char* name, uint64_t start, uint64_t end, uint64_t flow_id)
+    {
+        if (auto sink = _sink.load(std::memory_order_acquire)) {
+            sink->record_span(name, start, end, flow_id);
+        }
+        if (_fd >= 0) {
+            char event[TRACE_EVENT_SIZE_MAX];
+            append(event, format_trace_span(event, sizeof(event), _pid, get_trace_thread_id(), name, start, end, flow_id));
+        }
+    }
+
+    /* Binds to the span enclosing time on the calling thread. */
+    void write_flow(TraceFlow flow, uint64_t flow_id, uint64_t time)
+    {
+        if (auto sink = _sink.load(std::memory_order_acquire)) {
+            sink->record_flow(flow, flow_id, time);
+        }
+        if (_fd >= 0) {
+            char event[TRACE_EVENT_SIZE_MAX];
+            append(event, format_trace_flow(event, sizeof(event), _pid, get_trace_thread_id(), flow, flow_id, time));
+        }
+    }
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        flush_locked();
+    }
+
+private:
+    /* Buffered events are written at least this often, a killed process loses no more. */
+    static constexpr uint64_t FLUSH_INTERVAL = 100000000;
+    static constexpr size_t FLUSH_SIZE = 64 * 1024;
+
+    Tracer()
+        : _pid(getpid())
+    {
+        auto path = std::getenv("REVYV_TRACE");
+        if (path == nullptr || *path == 0) {
+            return;
+        }
+        /* The process creating the file opens the array, the others append to it. */
+        _fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+        if (_fd >= 0) {
+            _buffer = "[\n";
+        } else {
+            _fd = open(path, O_WRONLY | O_APPEND);
+        }
+        if (_fd < 0) {
+            return;
+        }
+        char event[TRACE_EVENT_SIZE_MAX];
+        append(event, format_trace_process_name(event, sizeof(event), _pid));
+        flush();
+    }
+
+    void append(const char* event, int size)
+    {
+        if (size <= 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _buffer.append(event, std::min((size_t)size, TRACE_EVENT_SIZE_MAX - 1));
+        auto now = get_monotonic_time_ns();
+        if (_buffer.size() >= FLUSH_SIZE || now - _flushed_at >= FLUSH_INTERVAL) {
+            flush_locked();
+            _flushed_at = now;
+        }
+    }
+
+    /* One write per flush, appends of whole events don't interleave with other processes'. */
+    void flush_locked()
+    {
+        if (_fd >= 0 && !_buffer.empty()) {
+            auto result = write(_fd, _buffer.data(), _buffer.size());
+            (void)result;
+        }
+        _buffer.clear();
+    }
+
+private:
+    pid_t _pid;
+    int _fd = -1;
+    std::atomic<TraceSink*> _sink = nullptr;
+    std::mutex _mutex;
+    std::string _buffer;
+    uint64_t _flushed_at = 0;
+};
+
+/* Names the flow of a client's pixel update, unique across clients. */
+[[nodiscard]] inline uint64_t get_update_flow_id(pid_t pid, uint64_t update_id)
+{
+    return ((uint64_t)pid << 40) | (update_id & ((1ULL << 40) - 1));
+}
+
+/* Traces the scope it lives in, nothing is measured while tracing is disabled. */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name)
+        : _name(name)
+        , _start(Tracer::get().is_enabled() ? get_monotonic_time_ns() : 0)
+    {
+    }
+
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    /* Makes the span part of an update's flow across threads and processes. */
+    void add_flow(TraceFlow flow, uint64_t flow_id)
+    {
+        if (_start != 0 && flow_id != 0) {
+            _flow_id = flow_id;
+            Tracer::get().write_flow(flow, flow_id, _start);
+        }
+    }
+
+    /* Ends the span before the scope does. */
+    void end()
+    {
+        if (_start != 0) {
+            Tracer::get().write_span(_name, _start, get_monotonic_time_ns(), _flow_id);
+            _start = 0;
+        }
+    }
+
+private:
+    const char* _name;
+    uint64_t _start;
+    uint64_t _flow_id = 0;
+};
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <csignal>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace revyv {
@@ -17,13 +18,43 @@ typedef enum : uint8_t {
     RequestTypeWindowSetVisibility = 7,
     RequestTypeWindowDestroy = 8,
     RequestTypeWindowBringToFront = 9,
+    RequestTypeWindowResizeBuffer = 10,
+    RequestTypeWindowUpdateRects = 11,
+    RequestTypeClientSetPointerHistory = 12,
 } RequestType;
 
 typedef enum : uint8_t {
     WindowRasterRGBA = 1,
     WindowRasterARGB = 2,
+    WindowRasterABGR = 3,
+    WindowRasterBGRA = 4,
 } WindowRasterType;
 
+typedef struct
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} WindowUpdateRect;
+
+/* Shared memory holds a table of at most this many rects in front of the pixels. */
+const uint32_t WINDOW_UPDATE_RECTS_MAX = 64;
+
+/*
+ * Names a client's pixel update, so the compositor can tell the client when
+ * a frame showing it was presented and traces can follow it across
+ * processes. id is 0 when the client neither asked nor traces.
+ */
+typedef struct
+{
+    uint64_t id;
+    /* Monotonic nanoseconds at which the client submitted the update. */
+    uint64_t submitted;
+    /* The client wants an EventTypeFramePresented for it. */
+    bool acknowledge;
+} UpdateStamp;
+
 const uint32_t PUBLISHER_PORT_BASE = 10000;
 const uint32_t LISTENER_PORT_BASE = 20000;
 
@@ -40,6 +71,8 @@ typedef struct
     uint64_t field5;
     uint64_t field6;
     uint64_t field7;
+    /* Pixel updates only. */
+    UpdateStamp update;
 } ListenerPayload;
 
 class ListenerBasePayload {
@@ -61,6 +94,10 @@ public:
 
     [[nodiscard]] uint32_t get_window_id() const { return _payload.window_id; }
 
+    [[nodiscard]] UpdateStamp get_update_stamp() const { return _payload.update; }
+
+    void set_update_stamp(const UpdateStamp& stamp) { _payload.update = stamp; }
+
 protected:
     ListenerPayload _payload {};
 };
@@ -92,6 +129,23 @@ public:
     }
 };
 
+class ClientSetPointerHistoryPayload : public ListenerBasePayload {
+public:
+    explicit ClientSetPointerHistoryPayload(const ListenerPayload& p)
+        : ListenerBasePayload(p)
+    {
+    }
+
+    ClientSetPointerHistoryPayload(pid_t pid, bool enabled)
+    {
+        _payload.type = RequestTypeClientSetPointerHistory;
+        _payload.pid = pid;
+        _payload.field4 = enabled;
+    }
+
+    [[nodiscard]] bool is_enabled() const { return _payload.field4 != 0; }
+};
+
 class WindowCreatePayload : public ListenerBasePayload {
 public:
     explicit WindowCreatePayload(const ListenerPayload& p)
@@ -278,6 +332,64 @@ public:
     }
 };
 
+class WindowResizeBufferPayload : public ListenerBasePayload {
+public:
+    explicit WindowResizeBufferPayload(const ListenerPayload& p)
+        : ListenerBasePayload(p)
+    {
+    }
+
+    WindowResizeBufferPayload(
+        uint32_t window_id,
+        double width,
+        double height,
+        uint64_t data_size,
+        int shared_memory_id)
+    {
+        _payload.type = RequestTypeWindowResizeBuffer;
+        _payload.window_id = window_id;
+        _payload.field0 = width;
+        _payload.field1 = height;
+        _payload.field5 = data_size;
+        _payload.field6 = shared_memory_id;
+    }
+
+    [[nodiscard]] double get_width() const { return _payload.field0; }
+
+    [[nodiscard]] double get_height() const { return _payload.field1; }
+
+    [[nodiscard]] uint64_t get_data_size() const { return _payload.field5; }
+
+    [[nodiscard]] int get_shared_memory_id() const { return _payload.field6; }
+};
+
+class WindowUpdateRectsPayload : public ListenerBasePayload {
+public:
+    explicit WindowUpdateRectsPayload(const ListenerPayload& p)
+        : ListenerBasePayload(p)
+    {
+    }
+
+    WindowUpdateRectsPayload(
+        uint32_t window_id,
+        uint32_t rect_count,
+        uint64_t data_size,
+        int shared_memory_id)
+    {
+        _payload.type = RequestTypeWindowUpdateRects;
+        _payload.window_id = window_id;
+        _payload.field5 = data_size;
+        _payload.field6 = shared_memory_id;
+        _payload.field7 = rect_count;
+    }
+
+    [[nodiscard]] uint64_t get_data_size() const { return _payload.field5; }
+
+    [[nodiscard]] int get_shared_memory_id() const { return _payload.field6; }
+
+    [[nodiscard]] uint32_t get_rect_count() const { return _payload.field7; }
+};
+
 typedef enum : uint8_t {
     EventTypeUndefined = 0,
     EventTypeMouseMove = 1,
@@ -286,8 +398,21 @@ typedef enum : uint8_t {
     EventTypeKey = 4,
     EventTypeText = 5,
     EventTypeQuit = 6,
+    EventTypeWindowScale = 7,
+    EventTypeCompositorInfo = 8,
+    EventTypeMouseHistory = 9,
+    EventTypeFramePresented = 10,
 } EventType;
 
+/* Monotonic nanoseconds at which an input event passed each stage, 0 when not stamped. */
+typedef struct
+{
+    uint64_t received;
+    uint64_t routed;
+    uint64_t published;
+    uint64_t dequeued;
+} EventStageTimes;
+
 typedef struct
 {
     uint32_t window_id;
@@ -300,6 +425,10 @@ typedef struct
     uint8_t field5;
     uint8_t field6;
     uint32_t field7;
+    EventStageTimes stage_times;
+    /* Frame acknowledgements only. */
+    UpdateStamp update;
+    uint64_t presented;
 } PublisherPayload;
 
 typedef enum {
@@ -321,324 +450,230 @@ typedef enum {
     KeyStateReleased = 2,
 } KeyState;
 
-class Event {
-public:
-    explicit Event(EventType type)
-        : _type(type)
-    {
-    }
-
-    explicit Event(const PublisherPayload& payload)
-        : _window_id(payload.window_id)
-        , _timestamp(payload.field7)
-        , _type((EventType)payload.type)
-    {
-    }
-
-    [[nodiscard]] uint32_t get_timestamp() const { return _timestamp; }
-
-    void set_timestamp(uint32_t timestamp) { _timestamp = timestamp; }
-
-    [[nodiscard]] EventType get_type() const { return _type; }
-
-    void set_type(EventType type) { _type = type; }
-
-    [[nodiscard]] uint32_t get_window_id() const { return _window_id; }
-
-    void set_window_id(uint32_t window_id) { _window_id = window_id; }
-
-    [[nodiscard]] virtual PublisherPayload translate()
-    {
-        PublisherPayload p;
-        p.window_id = get_window_id();
-        p.type = get_type();
-        p.field0 = 0;
-        p.field1 = 0;
-        p.field2 = 0;
-        p.field3 = 0;
-        p.field4 = 0;
-        p.field5 = 0;
-        p.field7 = get_timestamp();
-        return p;
-    }
-
-private:
-    EventType _type = EventTypeUndefined;
-    uint32_t _window_id {};
-    uint32_t _timestamp {};
-};
-
-class QuitEvent : public Event {
-public:
-    QuitEvent()
-        : Event(EventTypeQuit)
-    {
-    }
-};
-
-class MouseEvent : public Event {
-public:
-    explicit MouseEvent(const PublisherPayload& payload)
-        : Event(payload)
-    {
-    }
-
-    explicit MouseEvent(EventType type)
-        : Event(type)
-    {
-    }
-
-    [[nodiscard]] double get_x() const { return _x; }
-
-    void set_x(double x) { _x = x; }
-
-    [[nodiscard]] double get_y() const { return _y; }
-
-    void set_y(double y) { _y = y; }
-
-    [[nodiscard]] double get_window_x() const { return _windowX; }
-
-    void set_window_x(double windowX) { _windowX = windowX; }
-
-    [[nodiscard]] double get_window_y() const { return _windowY; }
-
-    void set_window_y(double windowY) { _windowY = windowY; }
+/* Longest text of a text event including the terminating zero, the same as SDL. */
+const size_t EVENT_TEXT_SIZE = 32;
 
-private:
-    double _x {};
-    double _y {};
-    double _windowX {};
-    double _windowY {};
-};
-
-class MouseMoveEvent : public MouseEvent {
-public:
-    MouseMoveEvent()
-        : MouseEvent(EventTypeMouseMove)
-    {
-    }
-
-    explicit MouseMoveEvent(const PublisherPayload& payload)
-        : MouseEvent(payload)
-    {
-        set_window_x(payload.field0);
-        set_window_y(payload.field1);
-        set_x(payload.field2);
-        set_y(payload.field3);
-    }
-
-    [[nodiscard]] PublisherPayload translate() override
-    {
-        PublisherPayload p;
-        p.window_id = get_window_id();
-        p.type = get_type();
-        p.field0 = get_window_x();
-        p.field1 = get_window_y();
-        p.field2 = get_x();
-        p.field3 = get_y();
-        p.field4 = 0;
-        p.field5 = 0;
-        p.field7 = get_timestamp();
-        return p;
-    }
-};
-
-class MouseButtonEvent : public MouseEvent {
-public:
-    MouseButtonEvent()
-        : MouseEvent(EventTypeMouseButton)
-    {
-    }
-
-    explicit MouseButtonEvent(const PublisherPayload& payload)
-        : MouseEvent(payload)
-        , _button(payload.field4)
-        , _state(payload.field5)
-        , _clicks(payload.field6)
-    {
-        set_window_x(payload.field0);
-        set_window_y(payload.field1);
-        set_x(payload.field2);
-        set_y(payload.field3);
-    }
-
-    [[nodiscard]] uint8_t get_button() const { return _button; }
-
-    void set_button(uint8_t button) { _button = button; }
-
-    [[nodiscard]] uint8_t get_state() const { return _state; }
-
-    void set_state(uint8_t state) { _state = state; }
-
-    [[nodiscard]] uint8_t get_clicks() const { return _clicks; }
-
-    void setClicks(uint8_t clicks) { _clicks = clicks; }
-
-    [[nodiscard]] PublisherPayload translate() override
-    {
-        PublisherPayload p;
-        p.window_id = get_window_id();
-        p.type = get_type();
-        p.field0 = get_window_x();
-        p.field1 = get_window_y();
-        p.field2 = get_x();
-        p.field3 = get_y();
-        p.field4 = get_button();
-        p.field5 = get_state();
-        p.field6 = get_clicks();
-        p.field7 = get_timestamp();
-        return p;
-    }
-
-private:
-    uint8_t _button = MouseButtonTypeUndefined;
-    uint8_t _state = MouseButtonStateUndefined;
-    uint8_t _clicks {};
-};
-
-class MouseScrollEvent : public MouseEvent {
-public:
-    MouseScrollEvent()
-        : MouseEvent(EventTypeMouseScroll)
-    {
-    }
-
-    explicit MouseScrollEvent(const PublisherPayload& payload)
-        : MouseEvent(payload)
-        , _scrollX((int32_t)payload.field2)
-        , _scrollY((int32_t)payload.field3)
-    {
-        set_window_x(payload.field0);
-        set_window_y(payload.field1);
-    }
-
-    [[nodiscard]] int32_t get_scroll_x() const { return _scrollX; }
-
-    void setScrollX(int32_t scrollX) { _scrollX = scrollX; }
-
-    [[nodiscard]] int32_t get_scroll_y() const { return _scrollY; }
-
-    void setScrollY(int32_t scrollY) { _scrollY = scrollY; }
-
-    [[nodiscard]] bool get_flipped() const { return _flipped; }
-
-    void set_flipped(bool flipped) { _flipped = flipped; }
-
-    [[nodiscard]] PublisherPayload translate() override
-    {
-        PublisherPayload p;
-        p.window_id = get_window_id();
-        p.type = get_type();
-        p.field0 = get_window_x();
-        p.field1 = get_window_y();
-        p.field2 = get_scroll_x();
-        p.field3 = get_scroll_y();
-        p.field4 = 0;
-        p.field5 = 0;
-        p.field7 = get_timestamp();
-        return p;
-    }
-
-private:
-    int32_t _scrollX {};
-    int32_t _scrollY {};
-    bool _flipped {};
-};
-
-class TextEvent : public Event {
-public:
-    explicit TextEvent(const PublisherPayload& payload)
-        : Event(payload)
-    {
-    }
-
-    TextEvent()
-        : Event(EventTypeText)
-    {
-    }
-
-    [[nodiscard]] const std::string& get_text() const { return _text; }
-
-    void set_text(const std::string& text) { _text = text; }
-
-    [[nodiscard]] PublisherPayload translate() override
-    {
-        PublisherPayload p;
-        p.window_id = get_window_id();
-        p.type = get_type();
-        p.field0 = (double)(get_text().size() + 1);
-        p.field1 = 0;
-        p.field2 = 0;
-        p.field3 = 0;
-        p.field4 = 0;
-        p.field5 = 0;
-        p.field7 = get_timestamp();
-        return p;
-    }
-
-private:
-    std::string _text;
-};
-
-class KeyEvent : public Event {
-public:
-    KeyEvent()
-        : Event(EventTypeKey)
-    {
-    }
-
-    explicit KeyEvent(const PublisherPayload& payload)
-        : Event(payload)
-        , _keycode((int32_t)payload.field0)
-        , _scancode((int32_t)payload.field1)
-        , _keymod((int32_t)payload.field2)
-        , _state((int8_t)payload.field3)
-        , _repeat((int32_t)payload.field4)
-    {
-    }
-
-    [[nodiscard]] int32_t get_scancode() const { return _scancode; }
-
-    void set_scancode(int32_t scancode) { _scancode = scancode; }
-
-    [[nodiscard]] int32_t get_keycode() const { return _keycode; }
+typedef struct
+{
+    double x;
+    double y;
+    double window_x;
+    double window_y;
+    uint8_t button;
+    uint8_t state;
+    uint8_t clicks;
+    int32_t scroll_x;
+    int32_t scroll_y;
+    bool flipped;
+} MouseEventData;
 
-    void set_keycode(int32_t keycode) { _keycode = keycode; }
+typedef struct
+{
+    int32_t scancode;
+    int32_t keycode;
+    int32_t keymod;
+    int8_t state;
+    bool repeat;
+} KeyEventData;
 
-    [[nodiscard]] int32_t get_keymod() const { return _keymod; }
+typedef struct
+{
+    /* Zero terminated. */
+    char text[EVENT_TEXT_SIZE];
+} TextEventData;
 
-    void set_keymod(int32_t keymod) { _keymod = keymod; }
+typedef struct
+{
+    double scale;
+} WindowScaleEventData;
 
-    [[nodiscard]] int8_t get_state() const { return _state; }
+typedef struct
+{
+    WindowRasterType native_raster_type;
+} CompositorInfoEventData;
+
+/*
+ * Pointer positions that were coalesced into the next mouse move event, oldest
+ * first. Only sent to clients that asked for pointer history, the samples
+ * follow the payload as a separate message.
+ */
+typedef struct
+{
+    uint32_t sample_count;
+} MouseHistoryEventData;
 
-    void set_state(int8_t state) { _state = state; }
+typedef struct
+{
+    double window_x;
+    double window_y;
+    double x;
+    double y;
+    uint32_t timestamp;
+} MouseMoveSample;
+
+/*
+ * Tells a client that asked for acknowledgements that a frame showing its
+ * update was presented. Updates merged into a later one are not acknowledged.
+ */
+typedef struct
+{
+    UpdateStamp update;
+    /* Monotonic nanoseconds. */
+    uint64_t presented;
+} FramePresentedEventData;
+
+/*
+ * Every event passed between the event source, the window manager and the
+ * clients. A plain tagged union that is copied by value, type selects the
+ * member that is set.
+ */
+typedef struct
+{
+    EventType type;
+    uint32_t window_id;
+    uint32_t timestamp;
+    EventStageTimes stage_times;
+    union {
+        MouseEventData mouse;
+        KeyEventData key;
+        TextEventData text;
+        WindowScaleEventData scale;
+        CompositorInfoEventData info;
+        MouseHistoryEventData history;
+        FramePresentedEventData frame;
+    };
+} Event;
+
+inline Event make_event(EventType type)
+{
+    Event event {};
+    event.type = type;
+    return event;
+}
 
-    [[nodiscard]] bool get_repeat() const { return _repeat; }
+inline void set_event_text(Event& event, const char* text)
+{
+    std::strncpy(event.text.text, text, EVENT_TEXT_SIZE - 1);
+    event.text.text[EVENT_TEXT_SIZE - 1] = 0;
+}
 
-    void set_repeat(bool repeat) { _repeat = repeat; }
+[[nodiscard]] inline size_t get_event_text_size(const Event& event)
+{
+    return strnlen(event.text.text, EVENT_TEXT_SIZE - 1);
+}
 
-    [[nodiscard]] PublisherPayload translate() override
-    {
-        PublisherPayload p {};
-        p.window_id = get_window_id();
-        p.type = get_type();
-        p.field0 = get_keycode();
-        p.field1 = get_scancode();
-        p.field2 = get_keymod();
-        p.field3 = get_state();
-        p.field4 = get_repeat();
-        p.field5 = 0;
-        p.field7 = get_timestamp();
-        return p;
-    }
+/* Text and history samples do not fit, they are sent as a second message. */
+[[nodiscard]] inline PublisherPayload event_to_payload(const Event& event)
+{
+    PublisherPayload p {};
+    p.window_id = event.window_id;
+    p.type = event.type;
+    p.field7 = event.timestamp;
+    p.stage_times = event.stage_times;
+    switch (event.type) {
+    case EventTypeMouseMove:
+        p.field0 = event.mouse.window_x;
+        p.field1 = event.mouse.window_y;
+        p.field2 = event.mouse.x;
+        p.field3 = event.mouse.y;
+        break;
+    case EventTypeMouseButton:
+        p.field0 = event.mouse.window_x;
+        p.field1 = event.mouse.window_y;
+        p.field2 = event.mouse.x;
+        p.field3 = event.mouse.y;
+        p.field4 = event.mouse.button;
+        p.field5 = event.mouse.state;
+        p.field6 = event.mouse.clicks;
+        break;
+    case EventTypeMouseScroll:
+        p.field0 = event.mouse.window_x;
+        p.field1 = event.mouse.window_y;
+        p.field2 = event.mouse.scroll_x;
+        p.field3 = event.mouse.scroll_y;
+        break;
+    case EventTypeKey:
+        p.field0 = event.key.keycode;
+        p.field1 = event.key.scancode;
+        p.field2 = event.key.keymod;
+        p.field3 = event.key.state;
+        p.field4 = event.key.repeat;
+        break;
+    case EventTypeText:
+        p.field0 = (double)(get_event_text_size(event) + 1);
+        break;
+    case EventTypeWindowScale:
+        p.field0 = event.scale.scale;
+        break;
+    case EventTypeCompositorInfo:
+        p.field4 = event.info.native_raster_type;
+        break;
+    case EventTypeMouseHistory:
+        p.field0 = event.history.sample_count;
+        break;
+    case EventTypeFramePresented:
+        p.update = event.frame.update;
+        p.presented = event.frame.presented;
+        break;
+    default:
+        break;
+    }
+    return p;
+}
 
-private:
-    int32_t _scancode {};
-    int32_t _keycode {};
-    int32_t _keymod {};
-    int8_t _state = KeyStateUndefined;
-    bool _repeat {};
-};
+[[nodiscard]] inline Event event_from_payload(const PublisherPayload& p)
+{
+    auto event = make_event((EventType)p.type);
+    event.window_id = p.window_id;
+    event.timestamp = p.field7;
+    event.stage_times = p.stage_times;
+    switch (event.type) {
+    case EventTypeMouseMove:
+        event.mouse.window_x = p.field0;
+        event.mouse.window_y = p.field1;
+        event.mouse.x = p.field2;
+        event.mouse.y = p.field3;
+        break;
+    case EventTypeMouseButton:
+        event.mouse.window_x = p.field0;
+        event.mouse.window_y = p.field1;
+        event.mouse.x = p.field2;
+        event.mouse.y = p.field3;
+        event.mouse.button = p.field4;
+        event.mouse.state = p.field5;
+        event.mouse.clicks = p.field6;
+        break;
+    case EventTypeMouseScroll:
+        event.mouse.window_x = p.field0;
+        event.mouse.window_y = p.field1;
+        event.mouse.scroll_x = (int32_t)p.field2;
+        event.mouse.scroll_y = (int32_t)p.field3;
+        break;
+    case EventTypeKey:
+        event.key.keycode = (int32_t)p.field0;
+        event.key.scancode = (int32_t)p.field1;
+        event.key.keymod = (int32_t)p.field2;
+        event.key.state = (int8_t)p.field3;
+        event.key.repeat = p.field4;
+        break;
+    case EventTypeWindowScale:
+        event.scale.scale = p.field0;
+        break;
+    case EventTypeCompositorInfo:
+        event.info.native_raster_type = (WindowRasterType)p.field4;
+        break;
+    case EventTypeMouseHistory:
+        event.history.sample_count = (uint32_t)p.field0;
+        break;
+    case EventTypeFramePresented:
+        event.frame.update = p.update;
+        event.frame.presented = p.presented;
+        break;
+    default:
+        break;
+    }
+    return event;
+}
 }
 
 #endif
@@ -1,80 +1,168 @@
 #include "compositor.h"
-#include <algorithm>
+#include <compositor/latency_histogram.h>
 #include <iostream>
 
 using namespace revyv;
 
-Compositor::Compositor() = default;
+/* Cell edge of the hit test grid in pixels. */
+static const double HIT_TEST_CELL_SIZE = 128;
+
+Compositor::Compositor(const Size& screen_size)
+    : _spatial_index(screen_size, HIT_TEST_CELL_SIZE)
+{
+}
 
 void Compositor::add_window(const std::shared_ptr<Window>& w)
 {
-    _windows[w->get_id()] = w;
-    _orders.push_back(w->get_id());
+    remove_window_by_id(w->get_id());
+    auto handle = _window_table.insert(w);
+    _spatial_index.insert(w.get());
+    w->set_frame_observer([this, handle](Window* window, const Rect&) {
+        _window_table.set_frame(handle, window->get_frame());
+        _window_table.set_visible(handle, window->is_visible());
+        _spatial_index.update(window);
+    });
 }
 
 void Compositor::remove_window_by_id(uint32_t id)
 {
-    _windows.erase(_windows.find(id));
-    _orders.erase(
-        std::remove_if(
-            _orders.begin(),
-            _orders.end(),
-            [&id](auto value) { return value == id; }),
-        _orders.end());
+    auto handle = _window_table.find(id);
+    forget_window(_window_table.get_window(handle));
+    _window_table.remove(handle);
 }
 
 void Compositor::remove_windows_by_pid(pid_t pid)
 {
-    for (auto it = _windows.begin(); it != _windows.end();) {
-        if (it->second != nullptr && it->second->get_pid() == pid) {
-            auto id = it->second->get_id();
-            it = _windows.erase(_windows.find(it->second->get_id()));
-            _orders.erase(
-                std::remove_if(
-                    _orders.begin(),
-                    _orders.end(),
-                    [&id](const uint32_t& value) { return value == id; }),
-                _orders.end());
-        } else {
-            it++;
-        }
+    for (auto& window : _window_table.remove_by_pid(pid)) {
+        forget_window(window);
     }
 }
 
 std::weak_ptr<Window> Compositor::find_window(uint32_t id)
 {
-    return _windows[id];
+    return _window_table.get_window(_window_table.find(id));
 }
 
 std::weak_ptr<Window> Compositor::find_window_in_location(Point location)
 {
-    for (auto it = _orders.rbegin(); it != _orders.rend();) {
-        auto window = _windows[*it];
-        auto frame = window->get_frame();
+    auto* window = get_window_in_location(location);
+    if (window == nullptr) {
+        return {};
+    }
+    return find_window(window->get_id());
+}
+
+Window* Compositor::get_window_in_location(Point location)
+{
+    if (_last_hit != nullptr && _last_hit_generation == _spatial_index.get_generation()) {
+        auto frame = _last_hit->get_frame();
         if (location.x >= frame.location.x && location.x <= frame.location.x + frame.size.width
             && location.y >= frame.location.y && location.y <= frame.location.y + frame.size.height) {
-            return window;
+            return _last_hit;
         }
-        it++;
     }
-    return {};
+
+    auto* window = _spatial_index.find_top_most(location);
+    _last_hit = window != nullptr && _spatial_index.is_uncovered(window->get_id()) ? window : nullptr;
+    _last_hit_generation = _spatial_index.get_generation();
+    return window;
+}
+
+uint64_t Compositor::get_generation() const
+{
+    return _spatial_index.get_generation();
 }
 
 void Compositor::window_bring_to_front(const std::shared_ptr<Window>& w)
 {
-    _orders.erase(
-        std::remove_if(
-            _orders.begin(),
-            _orders.end(),
-            [&w](const uint32_t& value) { return value == w->get_id(); }),
-        _orders.end());
-    _orders.push_back(w->get_id());
+    _window_table.raise(_window_table.find(w->get_id()));
+    _spatial_index.raise(w->get_id());
 }
 
 std::weak_ptr<Window> Compositor::get_top_most_window()
 {
-    if (_windows.empty() || _orders.empty() || _windows.find(_orders.back()) == _windows.end()) {
-        return {};
+    return _window_table.get_window(_window_table.get_top());
+}
+
+void Compositor::for_each_window(const std::function<void(const std::shared_ptr<Window>&)>& callback)
+{
+    _window_table.for_each_bottom_to_top(callback);
+}
+
+void Compositor::set_pointer_location(Point location)
+{
+    _pointer_location = location;
+}
+
+FrameProfiler& Compositor::get_profiler()
+{
+    return _profiler;
+}
+
+Point Compositor::get_pointer_location() const
+{
+    return _pointer_location;
+}
+
+void Compositor::set_background_update_interval(uint64_t interval)
+{
+    _background_update_interval = interval;
+}
+
+void Compositor::schedule_updates(const std::vector<std::shared_ptr<Window>>& windows)
+{
+    auto* top_most_window = _window_table.get_window(_window_table.get_top()).get();
+    auto* pointer_window = get_window_in_location(_pointer_location);
+    auto now = get_monotonic_time_ns();
+    for (auto& window : windows) {
+        if (window.get() == top_most_window || window.get() == pointer_window) {
+            window->set_update_priority(UpdatePriorityForeground);
+            window->set_updates_deferred(false);
+            continue;
+        }
+        window->set_update_priority(UpdatePriorityBackground);
+        /* Every background window keeps its own pace, so they don't all upload on the same frame. */
+        if (now - window->get_updates_released_at() >= _background_update_interval) {
+            window->set_updates_released_at(now);
+            window->set_updates_deferred(false);
+        } else {
+            window->set_updates_deferred(true);
+        }
+    }
+}
+
+void Compositor::forget_window(const std::shared_ptr<Window>& w)
+{
+    if (w == nullptr) {
+        return;
+    }
+    w->set_frame_observer(nullptr);
+    _spatial_index.remove(w->get_id());
+    if (_last_hit == w.get()) {
+        _last_hit = nullptr;
+    }
+}
+
+double Compositor::get_last_frame_time() const
+{
+    return _last_frame_time;
+}
+
+void Compositor::post_command(CompositorCommand command)
+{
+    _commands.push(std::move(command));
+}
+
+void Compositor::run_commands()
+{
+    CompositorCommand command;
+    while (_commands.pop(command)) {
+        try {
+            command(*this);
+        } catch (std::exception& e) {
+            std::cout << __func__ << ": " << e.what() << std::endl;
+        }
     }
-    return _windows[_orders.back()];
+    /* Captured windows and buffers are released here, on the render thread. */
+    command = nullptr;
 }
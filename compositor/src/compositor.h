@@ -1,20 +1,36 @@
 #ifndef REVYV_COMPOSITOR_H
 #define REVYV_COMPOSITOR_H
 
+#include "frame_profiler.h"
 #include "geometry.h"
+#include "mpsc_queue.h"
+#include "spatial_index.h"
 #include "window.h"
+#include "window_table.h"
+#include <functional>
 #include <iostream>
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
 namespace revyv {
+class Compositor;
+
+typedef std::function<void(Compositor&)> CompositorCommand;
+
+/*
+ * Windows and their stacking order belong to the render thread. Other
+ * threads change them by posting commands, which run at the start of the
+ * next frame.
+ */
 class Compositor {
 public:
-    Compositor();
+    explicit Compositor(const Size& screen_size);
 
     virtual void compose() = 0;
 
+    /* The raster type the renderer uploads without converting pixels. */
+    [[nodiscard]] virtual WindowRasterType get_native_raster_type() const = 0;
+
     void add_window(const std::shared_ptr<Window>& w);
 
     [[nodiscard]] std::weak_ptr<Window> find_window(uint32_t id);
@@ -25,13 +41,60 @@ public:
 
     [[nodiscard]] std::weak_ptr<Window> find_window_in_location(Point location);
 
+    /* Like find_window_in_location() without taking a reference, the window
+     * stays valid as long as get_generation() does not change. */
+    [[nodiscard]] Window* get_window_in_location(Point location);
+
+    /* Changes whenever a window is added, removed, moved, resized, hidden or restacked. */
+    [[nodiscard]] uint64_t get_generation() const;
+
     void window_bring_to_front(const std::shared_ptr<Window>& w);
 
     [[nodiscard]] std::weak_ptr<Window> get_top_most_window();
 
+    void for_each_window(const std::function<void(const std::shared_ptr<Window>&)>& callback);
+
+    [[nodiscard]] double get_last_frame_time() const;
+
+    /* The window under the pointer gets its updates first, like the top most one. */
+    void set_pointer_location(Point location);
+
+    [[nodiscard]] Point get_pointer_location() const;
+
+    /* Background windows apply pixel updates at most once per interval in nanoseconds, 0 never holds them back. */
+    void set_background_update_interval(uint64_t interval);
+
+    /* Recorded into on the render thread, read from any thread. */
+    [[nodiscard]] FrameProfiler& get_profiler();
+
+    /* Safe to call from any thread. */
+    void post_command(CompositorCommand command);
+
+    /* Runs the commands posted so far, on the render thread. */
+    void run_commands();
+
 protected:
-    std::unordered_map<uint32_t, std::shared_ptr<Window>> _windows;
-    std::vector<uint32_t> _orders;
+    /* Sets every window's update priority and whether it may apply pixel updates this frame. */
+    void schedule_updates(const std::vector<std::shared_ptr<Window>>& windows);
+
+protected:
+    WindowTable _window_table;
+    double _last_frame_time = 0;
+    uint64_t _frame = 0;
+    FrameProfiler _profiler;
+
+private:
+    void forget_window(const std::shared_ptr<Window>& w);
+
+private:
+    MpscQueue<CompositorCommand> _commands;
+    SpatialIndex _spatial_index;
+    /* Reused while the pointer stays inside it and nothing moved or got
+     * restacked, only set for windows no other window overlaps. */
+    Window* _last_hit = nullptr;
+    uint64_t _last_hit_generation = 0;
+    Point _pointer_location {};
+    uint64_t _background_update_interval = 0;
 };
 }
 
@@ -0,0 +1,53 @@
+#ifndef REVYV_EVENTRECORDING_H
+#define REVYV_EVENTRECORDING_H
+
+#include <compositor/types.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace revyv {
+
+/*
+ * Input recordings start with an EventRecordingHeader, followed by one
+ * EventRecord per event and the event data its type uses, written as is.
+ * Recordings are meant to be replayed by the same build on the same machine.
+ */
+static const char EVENT_RECORDING_MAGIC[8] = { 'R', 'E', 'V', 'Y', 'V', 'R', 'E', 'C' };
+static const uint32_t EVENT_RECORDING_VERSION = 1;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+} EventRecordingHeader;
+
+#pragma pack(push, 1)
+typedef struct
+{
+    /* Nanoseconds since the recording started. */
+    uint64_t time;
+    uint8_t type;
+    uint32_t timestamp;
+} EventRecord;
+#pragma pack(pop)
+
+[[nodiscard]] inline size_t get_event_record_data_size(EventType type)
+{
+    switch (type) {
+    case EventTypeMouseMove:
+    case EventTypeMouseButton:
+    case EventTypeMouseScroll:
+        return sizeof(MouseEventData);
+    case EventTypeKey:
+        return sizeof(KeyEventData);
+    case EventTypeText:
+        return sizeof(TextEventData);
+    default:
+        return 0;
+    }
+}
+
+}
+
+#endif
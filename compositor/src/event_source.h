@@ -9,7 +9,10 @@ namespace revyv {
 
 class EventSource {
 public:
-    [[nodiscard]] virtual std::shared_ptr<Event> poll_event() = 0;
+    virtual ~EventSource() = default;
+
+    /* Fills in the next pending event, false when there is none. */
+    [[nodiscard]] virtual bool poll_event(Event& event) = 0;
 };
 }
 
@@ -0,0 +1,126 @@
+#include "flight_recorder.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+using namespace revyv;
+
+namespace {
+/* The calling thread's ring, marked exited with the thread so the recorder can let go of it. */
+struct ThreadRecording {
+    FlightRecorder* recorder = nullptr;
+    std::shared_ptr<FlightThread> thread;
+
+    ~ThreadRecording()
+    {
+        if (thread != nullptr) {
+            thread->exited = true;
+        }
+    }
+};
+}
+
+static thread_local ThreadRecording thread_recording;
+
+FlightRecorder::FlightRecorder(std::string directory, uint64_t window)
+    : _directory(std::move(directory))
+    , _window(window)
+    , _pid(getpid())
+{
+}
+
+void FlightRecorder::record_span(const char* name, uint64_t start, uint64_t end, uint64_t flow_id)
+{
+    get_thread().events.push({ name, start, end, flow_id, TraceFlowStart });
+}
+
+void FlightRecorder::record_flow(TraceFlow flow, uint64_t flow_id, uint64_t time)
+{
+    get_thread().events.push({ nullptr, time, time, flow_id, flow });
+}
+
+FlightThread& FlightRecorder::get_thread()
+{
+    if (thread_recording.recorder == this) {
+        return *thread_recording.thread;
+    }
+    auto thread = std::make_shared<FlightThread>();
+    thread->tid = get_trace_thread_id();
+    auto now = get_monotonic_time_ns();
+    auto cutoff = now > _window ? now - _window : 0;
+    {
+        std::lock_guard<std::mutex> lock(_threads_mutex);
+        /* Threads that exited are kept until their events are older than any dump would cover. */
+        _threads.erase(std::remove_if(_threads.begin(), _threads.end(), [cutoff](const std::shared_ptr<FlightThread>& t) {
+            if (!t->exited) {
+                return false;
+            }
+            auto latest = t->events.get_latest(1);
+            return latest.empty() || latest.back().end < cutoff;
+        }),
+            _threads.end());
+        _threads.push_back(thread);
+    }
+    thread_recording.recorder = this;
+    thread_recording.thread = thread;
+    return *thread;
+}
+
+bool FlightRecorder::dump(const std::string& reason)
+{
+    if (_dumping.exchange(true)) {
+        return false;
+    }
+    auto now = get_monotonic_time_ns();
+    auto since = now > _window ? now - _window : 0;
+    auto path = _directory + "/revyv-flight-" + std::to_string(_pid) + "-" + std::to_string(++_dump_count) + ".json";
+    /* The rings are read without stopping their threads, the render thread only starts the dump. */
+    std::thread([self = shared_from_this(), path, reason, since, now]() {
+        std::vector<std::pair<uint64_t, std::vector<FlightEvent>>> threads;
+        {
+            std::lock_guard<std::mutex> lock(self->_threads_mutex);
+            for (auto& thread : self->_threads) {
+                threads.emplace_back(thread->tid, thread->events.get_latest(FLIGHT_EVENTS_PER_THREAD));
+            }
+        }
+        for (auto& thread : threads) {
+            auto& events = thread.second;
+            events.erase(std::remove_if(events.begin(), events.end(), [since](const FlightEvent& e) { return e.end < since; }), events.end());
+        }
+        self->write_dump(path, reason, now, threads);
+        self->_dumping = false;
+    }).detach();
+    return true;
+}
+
+void FlightRecorder::write_dump(const std::string& path, const std::string& reason, uint64_t now, const std::vector<std::pair<uint64_t, std::vector<FlightEvent>>>& threads) const
+{
+    std::ofstream stream(path);
+    if (!stream) {
+        std::cout << __func__ << ": cannot write " << path << std::endl;
+        return;
+    }
+    char event[TRACE_EVENT_SIZE_MAX];
+    size_t count = 0;
+    stream << "[\n";
+    if (format_trace_process_name(event, sizeof(event), _pid) > 0) {
+        stream << event;
+    }
+    for (auto& [tid, events] : threads) {
+        for (auto& e : events) {
+            auto size = e.name != nullptr ? format_trace_span(event, sizeof(event), _pid, tid, e.name, e.start, e.end, e.flow_id)
+                                          : format_trace_flow(event, sizeof(event), _pid, tid, e.flow, e.flow_id, e.start);
+            if (size > 0 && (size_t)size < sizeof(event)) {
+                stream << event;
+                count++;
+            }
+        }
+    }
+    /* The last event marks when the dump was asked for, and why. */
+    stream << "{\"name\":\"" << reason << "\",\"cat\":\"revyv\",\"ph\":\"i\",\"s\":\"g\",\"ts\":" << std::fixed << (double)now / 1e3
+           << ",\"pid\":" << _pid << ",\"tid\":0}\n]\n";
+    stream.close();
+    std::cout << "Flight recorder wrote " << count << " events to " << path << " after " << reason << std::endl;
+}
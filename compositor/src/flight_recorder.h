@@ -0,0 +1,76 @@
+#ifndef REVYV_FLIGHTRECORDER_H
+#define REVYV_FLIGHTRECORDER_H
+
+#include "sample_ring.h"
+#include <atomic>
+#include <compositor/trace.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace revyv {
+
+typedef struct
+{
+    /* nullptr for a flow event. */
+    const char* name;
+    /* Monotonic nanoseconds, a flow event's time is its start. */
+    uint64_t start;
+    uint64_t end;
+    uint64_t flow_id;
+    TraceFlow flow;
+} FlightEvent;
+
+/* Enough for a few seconds of frames, messages and uploads on the busiest thread. */
+static const size_t FLIGHT_EVENTS_PER_THREAD = 8192;
+
+typedef struct FlightThread {
+    uint64_t tid;
+    std::atomic<bool> exited = false;
+    SampleRing<FlightEvent, FLIGHT_EVENTS_PER_THREAD> events;
+} FlightThread;
+
+/*
+ * Always-on recording of the latest trace events of every thread, for
+ * hitches that are gone by the time tracing is enabled. Each thread records
+ * into a lock-free ring of its own; a dump writes the events of the last
+ * window as Chrome trace events to a new file in the directory. One
+ * recorder per process.
+ */
+class FlightRecorder : public TraceSink, public std::enable_shared_from_this<FlightRecorder> {
+public:
+    FlightRecorder(std::string directory, uint64_t window);
+
+    void record_span(const char* name, uint64_t start, uint64_t end, uint64_t flow_id) override;
+
+    void record_flow(TraceFlow flow, uint64_t flow_id, uint64_t time) override;
+
+    /*
+     * Writes the dump on a thread of its own, reason is noted in it. Returns
+     * false without dumping while the previous dump is still being written.
+     */
+    bool dump(const std::string& reason);
+
+    [[nodiscard]] uint64_t get_window() const { return _window; }
+
+private:
+    [[nodiscard]] FlightThread& get_thread();
+
+    void write_dump(const std::string& path, const std::string& reason, uint64_t now, const std::vector<std::pair<uint64_t, std::vector<FlightEvent>>>& threads) const;
+
+private:
+    std::string _directory;
+    uint64_t _window;
+    pid_t _pid;
+    /* Guards the threads, taken once per thread and on dumps. */
+    std::mutex _threads_mutex;
+    std::vector<std::shared_ptr<FlightThread>> _threads;
+    std::atomic<bool> _dumping = false;
+    uint32_t _dump_count = 0;
+};
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include "frame_profiler.h"
+#include <algorithm>
+
+using namespace revyv;
+
+/* Frame intervals this much longer than the median are counted as missed vsyncs. */
+static const double MISSED_FRAME_RATIO = 1.5;
+
+void FrameProfiler::begin_frame()
+{
+    _current = {};
+    _current.frame = ++_frame;
+    _current.time = get_monotonic_time_ns();
+    if (_interval_started_at == 0) {
+        _interval_started_at = _current.time;
+    }
+    for (auto& client : _clients) {
+        client.second.windows = 0;
+        client.second.queue_depth = 0;
+    }
+}
+
+void FrameProfiler::record_stage(FrameStage stage, uint64_t ns)
+{
+    _current.stages[stage] += ns;
+}
+
+void FrameProfiler::record_window(Window& window)
+{
+    auto activity = window.take_activity();
+    auto pending_tasks = (uint32_t)window.get_pending_task_count();
+    auto& client = _clients[window.get_pid()];
+    client.pid = window.get_pid();
+    client.windows++;
+    client.queue_depth += pending_tasks;
+    client.max_queue_depth = std::max(client.max_queue_depth, client.queue_depth);
+    client.updates += activity.updates;
+    client.dropped_updates += activity.dropped_updates;
+    client.uploaded_bytes += activity.uploaded_bytes;
+    client.upload_time += activity.upload_time;
+    client.decode_time += activity.decode_time;
+    _current.windows++;
+    _current.pending_tasks += pending_tasks;
+    _current.uploaded_bytes += activity.uploaded_bytes;
+}
+
+void FrameProfiler::end_frame()
+{
+    _frames.push(_current);
+    auto now = get_monotonic_time_ns();
+    if (now - _interval_started_at >= CLIENT_INTERVAL) {
+        flush_clients(now);
+    }
+}
+
+void FrameProfiler::flush_clients(uint64_t now)
+{
+    for (auto& client : _clients) {
+        client.second.time = now;
+        client.second.interval = now - _interval_started_at;
+        _client_samples.push(client.second);
+    }
+    /* Clients without windows left are not carried over. */
+    _clients.clear();
+    _interval_started_at = now;
+}
+
+std::vector<FrameSample> FrameProfiler::get_frames(size_t count) const
+{
+    return _frames.get_latest(count);
+}
+
+std::vector<ClientSample> FrameProfiler::get_clients() const
+{
+    auto samples = _client_samples.get_latest(CLIENT_SAMPLE_COUNT);
+    if (samples.empty()) {
+        return {};
+    }
+    auto time = samples.back().time;
+    std::vector<ClientSample> clients;
+    for (auto& sample : samples) {
+        if (sample.time == time) {
+            clients.push_back(sample);
+        }
+    }
+    return clients;
+}
+
+const char* FrameProfiler::get_stage_name(FrameStage stage)
+{
+    switch (stage) {
+    case FrameStageInput:
+        return "input";
+    case FrameStageCommands:
+        return "commands";
+    case FrameStageUpload:
+        return "upload";
+    case FrameStageDraw:
+        return "draw";
+    case FrameStagePresent:
+        return "present";
+    default:
+        return "unknown";
+    }
+}
+
+static LatencySummary summarize(std::vector<uint64_t> values)
+{
+    LatencySummary summary {};
+    if (values.empty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    summary.count = values.size();
+    summary.p50 = values[(values.size() - 1) / 2];
+    summary.p99 = values[(values.size() - 1) * 99 / 100];
+    summary.max = values.back();
+    return summary;
+}
+
+typedef struct
+{
+    LatencySummary stages[FRAME_STAGE_COUNT];
+    LatencySummary total;
+    double fps;
+    uint64_t missed_frames;
+} FrameSummary;
+
+static FrameSummary summarize_frames(const std::vector<FrameSample>& frames)
+{
+    FrameSummary summary {};
+    std::vector<uint64_t> totals;
+    for (size_t stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+        std::vector<uint64_t> values;
+        for (auto& frame : frames) {
+            values.push_back(frame.stages[stage]);
+        }
+        summary.stages[stage] = summarize(values);
+    }
+    for (auto& frame : frames) {
+        uint64_t total = 0;
+        for (auto stage : frame.stages) {
+            total += stage;
+        }
+        totals.push_back(total);
+    }
+    summary.total = summarize(totals);
+    if (frames.size() < 2) {
+        return summary;
+    }
+    std::vector<uint64_t> intervals;
+    for (size_t i = 1; i < frames.size(); i++) {
+        intervals.push_back(frames[i].time - frames[i - 1].time);
+    }
+    auto median = summarize(intervals).p50;
+    for (auto interval : intervals) {
+        if ((double)interval > (double)median * MISSED_FRAME_RATIO) {
+            summary.missed_frames++;
+        }
+    }
+    auto span = frames.back().time - frames.front().time;
+    summary.fps = span > 0 ? (double)(frames.size() - 1) * 1e9 / (double)span : 0;
+    return summary;
+}
+
+static void write_summary_json(std::ostream& stream, const LatencySummary& summary)
+{
+    stream << "{\"p50_ms\":" << (double)summary.p50 / 1e6 << ",\"p99_ms\":" << (double)summary.p99 / 1e6
+           << ",\"max_ms\":" << (double)summary.max / 1e6 << "}";
+}
+
+void revyv::write_profile_json(std::ostream& stream, const FrameProfiler& profiler, size_t frame_count)
+{
+    auto frames = profiler.get_frames(frame_count);
+    auto summary = summarize_frames(frames);
+    stream << "{\"frames\":" << frames.size() << ",\"fps\":" << summary.fps << ",\"missed_frames\":" << summary.missed_frames
+           << ",\"total\":";
+    write_summary_json(stream, summary.total);
+    stream << ",\"stages\":{";
+    for (size_t stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+        stream << (stage == 0 ? "" : ",") << "\"" << FrameProfiler::get_stage_name((FrameStage)stage) << "\":";
+        write_summary_json(stream, summary.stages[stage]);
+    }
+    stream << "},\"clients\":[";
+    auto clients = profiler.get_clients();
+    for (size_t i = 0; i < clients.size(); i++) {
+        auto& client = clients[i];
+        auto seconds = (double)client.interval / 1e9;
+        stream << (i == 0 ? "" : ",") << "{\"pid\":" << client.pid << ",\"windows\":" << client.windows
+               << ",\"queue_depth\":" << client.queue_depth << ",\"max_queue_depth\":" << client.max_queue_depth
+               << ",\"fps\":" << (double)client.updates / seconds
+               << ",\"dropped_fps\":" << (double)client.dropped_updates / seconds
+               << ",\"upload_bytes_per_second\":" << (double)client.uploaded_bytes / seconds
+               << ",\"upload_ms_per_second\":" << (double)client.upload_time / 1e6 / seconds
+               << ",\"decode_ms_per_second\":" << (double)client.decode_time / 1e6 / seconds << "}";
+    }
+    stream << "]}";
+}
+
+void revyv::write_frames_json(std::ostream& stream, const FrameProfiler& profiler, size_t frame_count)
+{
+    auto frames = profiler.get_frames(frame_count);
+    stream << "[";
+    for (size_t i = 0; i < frames.size(); i++) {
+        auto& frame = frames[i];
+        stream << (i == 0 ? "" : ",") << "{\"frame\":" << frame.frame << ",\"time\":" << frame.time;
+        for (size_t stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+            stream << ",\"" << FrameProfiler::get_stage_name((FrameStage)stage) << "_ns\":" << frame.stages[stage];
+        }
+        stream << ",\"uploaded_bytes\":" << frame.uploaded_bytes << ",\"windows\":" << frame.windows
+               << ",\"pending_tasks\":" << frame.pending_tasks << "}";
+    }
+    stream << "]";
+}
+
+void revyv::write_profile_summary(std::ostream& stream, const FrameProfiler& profiler, size_t frame_count)
+{
+    auto frames = profiler.get_frames(frame_count);
+    if (frames.empty()) {
+        return;
+    }
+    auto summary = summarize_frames(frames);
+    stream << "Frames: " << summary.fps << " fps, " << summary.missed_frames << " missed, ";
+    write_latency_summary(stream, "total", summary.total);
+    for (size_t stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+        stream << ", ";
+        write_latency_summary(stream, FrameProfiler::get_stage_name((FrameStage)stage), summary.stages[stage]);
+    }
+    stream << std::endl;
+    for (auto& client : profiler.get_clients()) {
+        auto seconds = (double)client.interval / 1e9;
+        stream << "Client " << client.pid << ": " << client.windows << " windows, "
+               << (double)client.updates / seconds << " fps, " << (double)client.dropped_updates / seconds << " dropped/s, "
+               << client.queue_depth << " queued (max " << client.max_queue_depth << "), "
+               << (double)client.uploaded_bytes / seconds / 1e6 << " MB/s uploaded in "
+               << (double)client.upload_time / 1e6 / seconds << " ms/s, decoded in "
+               << (double)client.decode_time / 1e6 / seconds << " ms/s" << std::endl;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef REVYV_FRAMEPROFILER_H
+#define REVYV_FRAMEPROFILER_H
+
+#include "sample_ring.h"
+#include "window.h"
+#include <compositor/latency_histogram.h>
+#include <cstdint>
+#include <ostream>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace revyv {
+
+typedef enum : uint8_t {
+    FrameStageInput = 0,
+    FrameStageCommands = 1,
+    /* Applying the windows' pending tasks, decoding evicted pixels and uploading. */
+    FrameStageUpload = 2,
+    FrameStageDraw = 3,
+    FrameStagePresent = 4,
+} FrameStage;
+
+static const size_t FRAME_STAGE_COUNT = 5;
+
+typedef struct
+{
+    uint64_t frame;
+    /* Start of the frame, monotonic nanoseconds. */
+    uint64_t time;
+    uint64_t stages[FRAME_STAGE_COUNT];
+    uint64_t uploaded_bytes;
+    uint32_t windows;
+    /* Tasks still queued in all windows at the end of the frame. */
+    uint32_t pending_tasks;
+} FrameSample;
+
+/* One client over one CLIENT_INTERVAL. */
+typedef struct
+{
+    uint64_t time;
+    uint64_t interval;
+    pid_t pid;
+    uint32_t windows;
+    uint32_t queue_depth;
+    uint32_t max_queue_depth;
+    uint64_t updates;
+    uint64_t dropped_updates;
+    uint64_t uploaded_bytes;
+    uint64_t upload_time;
+    uint64_t decode_time;
+} ClientSample;
+
+/*
+ * Where the render thread's time goes, per frame and per client. The render
+ * thread records into lock-free rings, the control socket and the log read
+ * them from other threads.
+ */
+class FrameProfiler {
+public:
+    void begin_frame();
+
+    void record_stage(FrameStage stage, uint64_t ns);
+
+    /* Takes the window's activity since it was last recorded. */
+    void record_window(Window& window);
+
+    void end_frame();
+
+    /* Up to count of the latest frames, oldest first. */
+    [[nodiscard]] std::vector<FrameSample> get_frames(size_t count) const;
+
+    /* Every client over the latest complete interval. */
+    [[nodiscard]] std::vector<ClientSample> get_clients() const;
+
+    [[nodiscard]] static const char* get_stage_name(FrameStage stage);
+
+private:
+    static constexpr size_t FRAME_SAMPLE_COUNT = 1024;
+    static constexpr size_t CLIENT_SAMPLE_COUNT = 1024;
+    static constexpr uint64_t CLIENT_INTERVAL = 1000000000;
+
+    void flush_clients(uint64_t now);
+
+private:
+    FrameSample _current {};
+    uint64_t _frame = 0;
+    std::unordered_map<pid_t, ClientSample> _clients;
+    uint64_t _interval_started_at = 0;
+    SampleRing<FrameSample, FRAME_SAMPLE_COUNT> _frames;
+    SampleRing<ClientSample, CLIENT_SAMPLE_COUNT> _client_samples;
+};
+
+/* The stages of the latest frames and every client, for the control socket. */
+void write_profile_json(std::ostream& stream, const FrameProfiler& profiler, size_t frame_count);
+
+/* The latest frames one by one. */
+void write_frames_json(std::ostream& stream, const FrameProfiler& profiler, size_t frame_count);
+
+/* A few lines for the log. */
+void write_profile_summary(std::ostream& stream, const FrameProfiler& profiler, size_t frame_count);
+
+}
+
+#endif
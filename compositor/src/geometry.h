@@ -43,6 +43,14 @@ inline Size make_size(double w, double h)
     size.height = h;
     return size;
 }
+
+/* Whether other lies entirely inside rect. */
+inline bool rect_contains(const Rect& rect, const Rect& other)
+{
+    return rect.location.x <= other.location.x && rect.location.y <= other.location.y
+        && rect.location.x + rect.size.width >= other.location.x + other.size.width
+        && rect.location.y + rect.size.height >= other.location.y + other.size.height;
+}
 }
 
 #endif
@@ -3,6 +3,7 @@
 #include "sdl_compositor.h"
 #include "sdl_window.h"
 #include "server.h"
+#include <compositor/trace.h>
 #include <compositor/types.h>
 #include <lzo/lzo1x.h>
 #include <sys/ipc.h>
@@ -20,7 +21,11 @@ Listener::Listener(pid_t pid)
     _socket->set(zmq::sockopt::sndtimeo, 10000);
     _socket->set(zmq::sockopt::rcvtimeo, 10000);
     _socket->bind(_url.c_str());
-    _thread = std::make_shared<std::thread>(Listener::listener_thread, this);
+}
+
+void Listener::start()
+{
+    _thread = std::make_shared<std::thread>(Listener::listener_thread, shared_from_this());
     _thread->detach();
 }
 
@@ -29,7 +34,7 @@ void Listener::shutdown()
     _running = false;
 }
 
-void Listener::listener_thread(Listener* listener)
+void Listener::listener_thread(std::shared_ptr<Listener> listener)
 {
     std::cout << "Started listener thread for PID " << listener->_pid << " on " << listener->_url
               << std::endl;
@@ -37,7 +42,8 @@ void Listener::listener_thread(Listener* listener)
         try {
             ListenerPayload p {};
             auto result = listener->_socket->recv(zmq::mutable_buffer(&p, sizeof(ListenerPayload)), zmq::recv_flags::none);
-            if (result.has_value()) {
+            /* Whatever the client queued before it died is dropped. */
+            if (result.has_value() && listener->_running) {
                 listener->process_message(p);
             }
         } catch (std::exception& e) {
@@ -45,11 +51,14 @@ void Listener::listener_thread(Listener* listener)
         }
     }
     listener->_socket->close();
+    /* The strands hand their windows over to the render thread. */
+    listener->_windows.clear();
     std::cout << "Stopped listener thread for PID " << listener->_pid << std::endl;
 }
 
 void Listener::process_message(const ListenerPayload& p)
 {
+    TraceSpan span("listener message");
     try {
         if (p.type == RequestTypeWindowCreate) {
             window_create(p);
@@ -61,10 +70,16 @@ void Listener::process_message(const ListenerPayload& p)
             window_bring_to_front(p);
         } else if (p.type == RequestTypeWindowUpdatePixels) {
             window_update_pixels(p);
+        } else if (p.type == RequestTypeWindowUpdateRects) {
+            window_update_rects(p);
         } else if (p.type == RequestTypeWindowResize) {
             window_resize(p);
+        } else if (p.type == RequestTypeWindowResizeBuffer) {
+            window_resize_buffer(p);
         } else if (p.type == RequestTypeWindowDestroy) {
             window_destroy(p);
+        } else if (p.type == RequestTypeClientSetPointerHistory) {
+            client_set_pointer_history(p);
         } else if (p.type == RequestTypeClientUnregister) {
             _running = false;
         }
@@ -73,105 +88,249 @@ void Listener::process_message(const ListenerPayload& p)
     }
 }
 
+void Listener::client_set_pointer_history(const ListenerPayload& p)
+{
+    auto payload = ClientSetPointerHistoryPayload(p);
+    auto publisher = Server::get_shared_instance()->get_publisher(_pid);
+    if (publisher.expired() || publisher.lock() == nullptr) {
+        return;
+    }
+    publisher.lock()->set_pointer_history_enabled(payload.is_enabled());
+}
+
 void Listener::window_create(const ListenerPayload& p)
 {
     auto payload = WindowCreatePayload(p);
 
+    auto server = Server::get_shared_instance();
     auto data = std::shared_ptr<unsigned char[]>(new unsigned char[payload.get_data_size()]);
     unsigned char* shared_memory = (unsigned char*)shmat(payload.get_shared_memory_id(), 0, 0);
-    std::memcpy(data.get(), shared_memory, payload.get_data_size());
+    server->get_work_pool()->copy(data.get(), shared_memory, payload.get_data_size());
+    _counters->received_bytes.fetch_add(payload.get_data_size(), std::memory_order_relaxed);
 
-    auto compositor = Server::get_shared_instance()->get_compositor();
+    auto compositor = server->get_compositor();
     auto sdl_compositor = std::dynamic_pointer_cast<SDLCompositor>(compositor);
-    auto window = std::make_shared<SDLWindow>(_pid, payload.get_window_id(), payload.get_raster_type(), sdl_compositor->get_renderer());
-    window->create(data, payload.get_data_size(), make_rect(payload.get_x(), payload.get_y(), payload.get_width(), payload.get_height()));
+    auto window = std::make_shared<SDLWindow>(_pid, payload.get_window_id(), payload.get_raster_type(), sdl_compositor->get_renderer(), sdl_compositor->get_texture_uploader());
     window->set_shared_memory_id(payload.get_shared_memory_id());
     window->set_shared_memory_address(shared_memory);
-    compositor->add_window(window);
+
+    auto strand = std::make_shared<WindowStrand>(window, compositor, server->get_work_pool());
+    auto data_size = payload.get_data_size();
+    auto frame = make_rect(payload.get_x(), payload.get_y(), payload.get_width(), payload.get_height());
+    auto opaque = are_pixels_opaque(data.get(), data_size, payload.get_raster_type());
+    strand->post([data, data_size, frame, opaque](Compositor& compositor, const std::shared_ptr<Window>& window) {
+        window->create(data, data_size, frame, opaque);
+        compositor.add_window(window);
+    });
+    _windows[payload.get_window_id()] = { strand, frame.size };
 }
 
 void Listener::window_update_pixels(const ListenerPayload& p)
 {
     auto payload = WindowUpdatePixelsPayload(p);
-    auto window = Server::get_shared_instance()->get_compositor()->find_window(payload.get_window_id());
-    if (window.expired() || window.lock() == nullptr) {
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
         return;
     }
 
-    auto size = payload.is_compressed() ? payload.get_compressed_size() : payload.get_data_size();
-    auto buffer = std::shared_ptr<unsigned char[]>(new unsigned char[size]);
-    std::memcpy(buffer.get(), window.lock()->get_shared_memory_address(), size);
+    auto data_size = payload.get_data_size();
+    auto rect = make_rect(payload.get_x(), payload.get_y(), payload.get_width(), payload.get_height());
+    auto stamp = payload.get_update_stamp();
+    auto flow_id = get_update_flow_id(_pid, stamp.id);
+    auto raster_type = (WindowRasterType)client_window->strand->get_window()->get_raster_type();
+    TraceSpan span("listener update_pixels");
+    span.add_flow(TraceFlowStep, flow_id);
+    _counters->update_bytes.fetch_add(data_size, std::memory_order_relaxed);
+    if (!payload.is_compressed()) {
+        _counters->update_received_bytes.fetch_add(data_size, std::memory_order_relaxed);
+        TraceSpan copy_span("copy");
+        auto data = copy_shared_memory(client_window->strand->get_window(), 0, data_size);
+        copy_span.end();
+        auto opaque = are_pixels_opaque(data.get(), data_size, raster_type);
+        client_window->strand->post([data, data_size, rect, stamp, opaque](Compositor&, const std::shared_ptr<Window>& window) {
+            window->update_pixels(data, data_size, rect, stamp, opaque);
+        });
+        return;
+    }
+
+    /* Decompressing is left to the pool, only the compressed bytes are copied here. */
+    auto compressed_size = payload.get_compressed_size();
+    _counters->update_received_bytes.fetch_add(compressed_size, std::memory_order_relaxed);
+    TraceSpan copy_span("copy");
+    auto compressed = copy_shared_memory(client_window->strand->get_window(), 0, compressed_size);
+    copy_span.end();
+    client_window->strand->submit([compressed, compressed_size, data_size, rect, stamp, flow_id, raster_type, counters = _counters]() -> WindowCommand {
+        TraceSpan decompress_span("decompress");
+        decompress_span.add_flow(TraceFlowStep, flow_id);
+        auto start = get_monotonic_time_ns();
+        auto data = std::shared_ptr<unsigned char[]>(new unsigned char[data_size]);
+        lzo_uint new_size = static_cast<lzo_uint>(data_size);
+        auto decompress_result = lzo1x_decompress(compressed.get(), compressed_size, data.get(), &new_size, nullptr);
+        if (decompress_result != LZO_E_OK || new_size != static_cast<lzo_uint>(data_size)) {
+            counters->decode_time.fetch_add(get_monotonic_time_ns() - start, std::memory_order_relaxed);
+            return nullptr;
+        }
+        auto opaque = are_pixels_opaque(data.get(), data_size, raster_type);
+        counters->decode_time.fetch_add(get_monotonic_time_ns() - start, std::memory_order_relaxed);
+        return [data, data_size, rect, stamp, opaque](Compositor&, const std::shared_ptr<Window>& window) {
+            window->update_pixels(data, data_size, rect, stamp, opaque);
+        };
+    });
+}
+
+void Listener::window_update_rects(const ListenerPayload& p)
+{
+    auto payload = WindowUpdateRectsPayload(p);
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
+        return;
+    }
+    auto& window = client_window->strand->get_window();
+
+    auto table = (const WindowUpdateRect*)window->get_shared_memory_address();
+    auto table_size = payload.get_rect_count() * sizeof(WindowUpdateRect);
+    if (payload.get_rect_count() > WINDOW_UPDATE_RECTS_MAX || table_size > payload.get_data_size()) {
+        return;
+    }
 
-    std::shared_ptr<unsigned char[]> data;
-    if (payload.is_compressed()) {
-        data = std::shared_ptr<unsigned char[]>(new unsigned char[payload.get_data_size()]);
-        lzo_uint new_size = static_cast<lzo_uint>(payload.get_data_size());
-        auto decompress_result =
-            lzo1x_decompress(buffer.get(), payload.get_compressed_size(), data.get(), &new_size, nullptr);
-        if (decompress_result != LZO_E_OK || new_size != static_cast<lzo_uint>(payload.get_data_size())) {
+    auto buffer_width = (uint64_t)client_window->buffer_size.width;
+    auto buffer_height = (uint64_t)client_window->buffer_size.height;
+    std::vector<Rect> rects;
+    size_t pixels_size = 0;
+    for (uint32_t i = 0; i < payload.get_rect_count(); i++) {
+        /* Read once, the client can still write to its shared memory. Summed in 64 bits so they can't wrap. */
+        auto r = table[i];
+        if ((uint64_t)r.x + r.width > buffer_width || (uint64_t)r.y + r.height > buffer_height) {
             return;
         }
-    } else {
-        data = buffer;
+        rects.push_back(make_rect(r.x, r.y, r.width, r.height));
+        pixels_size += (size_t)r.width * r.height * 4;
     }
-    window.lock()->update_pixels(data, payload.get_data_size(), make_rect(payload.get_x(), payload.get_y(), payload.get_width(), payload.get_height()));
+    if (table_size + pixels_size != payload.get_data_size()) {
+        return;
+    }
+
+    auto stamp = payload.get_update_stamp();
+    TraceSpan span("listener update_rects");
+    span.add_flow(TraceFlowStep, get_update_flow_id(_pid, stamp.id));
+    _counters->update_bytes.fetch_add(pixels_size, std::memory_order_relaxed);
+    _counters->update_received_bytes.fetch_add(pixels_size, std::memory_order_relaxed);
+    TraceSpan copy_span("copy");
+    auto data = copy_shared_memory(window, table_size, pixels_size);
+    copy_span.end();
+    auto opaque = are_pixels_opaque(data.get(), pixels_size, (WindowRasterType)window->get_raster_type());
+    client_window->strand->post([data, pixels_size, rects = std::move(rects), stamp, opaque](Compositor&, const std::shared_ptr<Window>& window) {
+        window->update_rects(data, pixels_size, rects, stamp, opaque);
+    });
 }
 
 void Listener::window_resize(const ListenerPayload& p)
 {
     auto payload = WindowResizePayload(p);
-    auto window = Server::get_shared_instance()->get_compositor()->find_window(payload.get_window_id());
-    if (window.expired() || window.lock() == nullptr) {
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
         return;
     }
-    auto data = std::shared_ptr<unsigned char[]>(new unsigned char[payload.get_data_size()]);
-    std::memcpy(data.get(), window.lock()->get_shared_memory_address(), payload.get_data_size());
-    window.lock()->resize(data, payload.get_data_size(), make_size(payload.get_width(), payload.get_height()));
+    auto data_size = payload.get_data_size();
+    auto data = copy_shared_memory(client_window->strand->get_window(), 0, data_size);
+    auto size = make_size(payload.get_width(), payload.get_height());
+    client_window->buffer_size = size;
+    auto opaque = are_pixels_opaque(data.get(), data_size, (WindowRasterType)client_window->strand->get_window()->get_raster_type());
+    client_window->strand->post([data, data_size, size, opaque](Compositor&, const std::shared_ptr<Window>& window) {
+        window->resize(data, data_size, size, opaque);
+    });
+}
+
+void Listener::window_resize_buffer(const ListenerPayload& p)
+{
+    auto payload = WindowResizeBufferPayload(p);
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
+        return;
+    }
+    auto data_size = payload.get_data_size();
+    auto data = copy_shared_memory(client_window->strand->get_window(), 0, data_size);
+    auto size = make_size(payload.get_width(), payload.get_height());
+    client_window->buffer_size = size;
+    auto opaque = are_pixels_opaque(data.get(), data_size, (WindowRasterType)client_window->strand->get_window()->get_raster_type());
+    client_window->strand->post([data, data_size, size, opaque](Compositor&, const std::shared_ptr<Window>& window) {
+        window->resize_buffer(data, data_size, size, opaque);
+    });
 }
 
 void Listener::window_set_visibility(const ListenerPayload& p)
 {
     auto payload = WindowSetVisibilityPayload(p);
-    auto window = Server::get_shared_instance()->get_compositor()->find_window(payload.get_window_id());
-    if (window.expired() || window.lock() == nullptr) {
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
         return;
     }
-    window.lock()->set_visible((bool)payload.is_visible());
+    auto visible = (bool)payload.is_visible();
+    client_window->strand->post([visible](Compositor&, const std::shared_ptr<Window>& window) { window->set_visible(visible); });
 }
 
 void Listener::window_move(const ListenerPayload& p)
 {
     auto payload = WindowMovePayload(p);
-    auto window = Server::get_shared_instance()->get_compositor()->find_window(payload.get_window_id());
-    if (window.expired() || window.lock() == nullptr) {
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
         return;
     }
     auto point = make_point(payload.get_x(), payload.get_y());
-    window.lock()->set_location(point);
-    window.lock()->move(point);
+    client_window->strand->post([point](Compositor&, const std::shared_ptr<Window>& window) {
+        window->set_location(point);
+        window->move(point);
+    });
 }
 
 void Listener::window_bring_to_front(const ListenerPayload& p)
 {
     auto payload = WindowBringToFrontPayload(p);
-    auto window = Server::get_shared_instance()->get_compositor()->find_window(payload.get_window_id());
-    if (window.expired() || window.lock() == nullptr) {
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
         return;
     }
-    Server::get_shared_instance()->get_compositor()->window_bring_to_front(window.lock());
+    client_window->strand->post([](Compositor& compositor, const std::shared_ptr<Window>& window) { compositor.window_bring_to_front(window); });
 }
 
 void Listener::window_destroy(const ListenerPayload& p)
 {
     auto payload = WindowDestroyPayload(p);
-    auto window = Server::get_shared_instance()->get_compositor()->find_window(payload.get_window_id());
-    if (window.expired() || window.lock() == nullptr) {
+    auto client_window = find_window(payload.get_window_id());
+    if (client_window == nullptr) {
         return;
     }
-    Server::get_shared_instance()->get_compositor()->remove_window_by_id(payload.get_window_id());
+    client_window->strand->post([](Compositor& compositor, const std::shared_ptr<Window>& window) {
+        if (compositor.find_window(window->get_id()).lock() == window) {
+            compositor.remove_window_by_id(window->get_id());
+        }
+    });
+    _windows.erase(payload.get_window_id());
+}
+
+Listener::ClientWindow* Listener::find_window(uint32_t window_id)
+{
+    auto it = _windows.find(window_id);
+    if (it == _windows.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+std::shared_ptr<unsigned char[]> Listener::copy_shared_memory(const std::shared_ptr<Window>& window, size_t offset, size_t size)
+{
+    auto data = std::shared_ptr<unsigned char[]>(new unsigned char[size]);
+    Server::get_shared_instance()->get_work_pool()->copy(data.get(), window->get_shared_memory_address() + offset, size);
+    _counters->received_bytes.fetch_add(size, std::memory_order_relaxed);
+    return data;
 }
 
 bool Listener::is_running() const
 {
     return _running;
 }
+
+const ClientCounters& Listener::get_counters() const
+{
+    return *_counters;
+}
@@ -1,30 +1,60 @@
 #ifndef REVYV_LISTENER_H
 #define REVYV_LISTENER_H
 
+#include "compositor.h"
+#include "geometry.h"
+#include "metrics.h"
+#include "window.h"
+#include "window_strand.h"
+#include <atomic>
 #include <compositor/types.h>
 #include <memory>
 #include <thread>
+#include <unordered_map>
 #include <zmq.hpp>
 
 namespace revyv {
 
-class Listener {
+class Listener : public std::enable_shared_from_this<Listener> {
 public:
     explicit Listener(pid_t pid);
 
+    /* Starts the listener thread, which holds on to the listener until it stops. */
+    void start();
+
     void shutdown();
 
     [[nodiscard]] bool is_running() const;
 
+    [[nodiscard]] const ClientCounters& get_counters() const;
+
 private:
+    typedef struct
+    {
+        std::shared_ptr<WindowStrand> strand;
+        /* Size of the client's pixel buffer, to validate updates against. */
+        Size buffer_size;
+    } ClientWindow;
+
     void process_message(const ListenerPayload& p);
 
+    [[nodiscard]] ClientWindow* find_window(uint32_t window_id);
+
+    /* Copies out of the window's shared memory before the client reuses it. */
+    [[nodiscard]] std::shared_ptr<unsigned char[]> copy_shared_memory(const std::shared_ptr<Window>& window, size_t offset, size_t size);
+
+    void client_set_pointer_history(const ListenerPayload& p);
+
     void window_create(const ListenerPayload& p);
 
     void window_update_pixels(const ListenerPayload& p);
 
+    void window_update_rects(const ListenerPayload& p);
+
     void window_resize(const ListenerPayload& p);
 
+    void window_resize_buffer(const ListenerPayload& p);
+
     void window_set_visibility(const ListenerPayload& p);
 
     void window_move(const ListenerPayload& p);
@@ -34,7 +64,7 @@ private:
     void window_destroy(const ListenerPayload& p);
 
 private:
-    static void listener_thread(Listener* listener);
+    static void listener_thread(std::shared_ptr<Listener> listener);
 
 private:
     std::string _url;
@@ -42,7 +72,11 @@ private:
     std::shared_ptr<zmq::context_t> _ctx;
     std::shared_ptr<zmq::socket_t> _socket;
     std::shared_ptr<std::thread> _thread;
-    bool _running = true;
+    std::atomic<bool> _running = true;
+    /* Shared with the decode jobs, which may finish after the listener is gone. */
+    std::shared_ptr<ClientCounters> _counters = std::make_shared<ClientCounters>();
+    /* The client's windows, only used by the listener thread. */
+    std::unordered_map<uint32_t, ClientWindow> _windows;
 };
 
 }
@@ -6,18 +6,63 @@ using namespace revyv;
 int main(int argc, char** argv)
 {
     try {
-        argh::parser cmdl({ "-w", "--width", "-h", "--height" });
+        argh::parser cmdl({ "-w", "--width", "-h", "--height", "--frame-budget", "--texture-budget", "--upload-budget", "--latency-log-interval", "--profile-log-interval", "--record", "--replay", "--replay-speed", "--workers", "--background-update-rate", "--refresh-rate", "--flight-recorder-window", "--jank-threshold", "--flight-recorder-dir", "--metrics-port" });
         cmdl.parse(argc, argv);
-        auto screen_size = make_size(1920, 1080);
+        ServerOptions options;
         if (!cmdl("width").str().empty()) {
-            screen_size.width = std::atoi(cmdl("width").str().c_str());
+            options.screen_size.width = std::atoi(cmdl("width").str().c_str());
         }
         if (!cmdl("height").str().empty()) {
-            screen_size.height = std::atoi(cmdl("height").str().c_str());
+            options.screen_size.height = std::atoi(cmdl("height").str().c_str());
         }
-        Server::get_shared_instance()->run(screen_size);
+        if (!cmdl("frame-budget").str().empty()) {
+            options.frame_budget = std::atof(cmdl("frame-budget").str().c_str());
+        }
+        if (!cmdl("texture-budget").str().empty()) {
+            /* Megabytes, 0 means unlimited. */
+            options.texture_budget = std::strtoull(cmdl("texture-budget").str().c_str(), nullptr, 10) * 1024 * 1024;
+        }
+        if (!cmdl("upload-budget").str().empty()) {
+            options.upload_budget = std::atof(cmdl("upload-budget").str().c_str());
+        }
+        if (!cmdl("latency-log-interval").str().empty()) {
+            options.latency_log_interval = std::atof(cmdl("latency-log-interval").str().c_str());
+        }
+        if (!cmdl("profile-log-interval").str().empty()) {
+            options.profile_log_interval = std::atof(cmdl("profile-log-interval").str().c_str());
+        }
+        options.record_path = cmdl("record").str();
+        options.replay_path = cmdl("replay").str();
+        if (!cmdl("replay-speed").str().empty()) {
+            /* 0 replays as fast as possible. */
+            options.replay_speed = std::atof(cmdl("replay-speed").str().c_str());
+        }
+        if (!cmdl("workers").str().empty()) {
+            options.worker_count = std::strtoul(cmdl("workers").str().c_str(), nullptr, 10);
+        }
+        if (!cmdl("background-update-rate").str().empty()) {
+            options.background_update_rate = std::atof(cmdl("background-update-rate").str().c_str());
+        }
+        options.headless = cmdl["headless"];
+        if (!cmdl("refresh-rate").str().empty()) {
+            options.refresh_rate = std::atof(cmdl("refresh-rate").str().c_str());
+        }
+        if (!cmdl("flight-recorder-window").str().empty()) {
+            options.flight_recorder_window = std::atof(cmdl("flight-recorder-window").str().c_str());
+        }
+        if (!cmdl("jank-threshold").str().empty()) {
+            options.jank_threshold = std::atof(cmdl("jank-threshold").str().c_str());
+        }
+        if (!cmdl("flight-recorder-dir").str().empty()) {
+            options.flight_recorder_directory = cmdl("flight-recorder-dir").str();
+        }
+        if (!cmdl("metrics-port").str().empty()) {
+            options.metrics_port = (uint16_t)std::atoi(cmdl("metrics-port").str().c_str());
+        }
+        Server::get_shared_instance()->run(options);
         return 0;
-    } catch (std::exception&) {
+    } catch (std::exception& e) {
+        std::cout << __func__ << ": " << e.what() << std::endl;
         return -1;
     }
 }
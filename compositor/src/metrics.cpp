@@ -0,0 +1,147 @@
+#include "metrics.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace revyv;
+
+#ifdef __APPLE__
+static const int SEND_FLAGS = 0;
+#else
+/* A scraper hanging up early must not take the compositor down with SIGPIPE. */
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+static void write_header(std::ostream& stream, const char* name, const char* type, const char* help)
+{
+    stream << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+template <typename F>
+static void write_client_metric(std::ostream& stream, const MetricsSnapshot& metrics, const char* name, const char* type, const char* help, F value)
+{
+    write_header(stream, name, type, help);
+    for (auto& client : metrics.clients) {
+        stream << name << "{pid=\"" << client.pid << "\"} " << value(client) << "\n";
+    }
+}
+
+void revyv::write_metrics(std::ostream& stream, const MetricsSnapshot& metrics)
+{
+    write_header(stream, "revyv_clients", "gauge", "Connected clients.");
+    stream << "revyv_clients " << metrics.clients.size() << "\n";
+    write_header(stream, "revyv_windows", "gauge", "Windows of all clients.");
+    stream << "revyv_windows " << metrics.windows << "\n";
+    write_header(stream, "revyv_texture_resident_bytes", "gauge", "Texture memory of the windows not evicted.");
+    stream << "revyv_texture_resident_bytes " << metrics.texture_resident_bytes << "\n";
+    write_header(stream, "revyv_frames_composited_total", "counter", "Frames composited.");
+    stream << "revyv_frames_composited_total " << metrics.frames_composited << "\n";
+    write_header(stream, "revyv_frames_missed_total", "counter", "Frames that started more than one and a half refresh intervals after the previous one.");
+    stream << "revyv_frames_missed_total " << metrics.frames_missed << "\n";
+    write_header(stream, "revyv_event_send_failures_total", "counter", "Events that could not be sent to a client.");
+    stream << "revyv_event_send_failures_total " << metrics.event_send_failures << "\n";
+
+    write_client_metric(stream, metrics, "revyv_client_received_bytes_total", "counter", "Bytes copied out of the client's shared memory.",
+        [](const ClientMetrics& c) { return c.received_bytes; });
+    write_client_metric(stream, metrics, "revyv_client_update_received_bytes_total", "counter", "Bytes of pixel updates as received, compressed or not.",
+        [](const ClientMetrics& c) { return c.update_received_bytes; });
+    write_client_metric(stream, metrics, "revyv_client_update_bytes_total", "counter", "Bytes of pixel updates once decompressed.",
+        [](const ClientMetrics& c) { return c.update_bytes; });
+    write_client_metric(stream, metrics, "revyv_client_compression_ratio", "gauge", "Decompressed over received bytes of the client's pixel updates so far.",
+        [](const ClientMetrics& c) { return c.update_received_bytes == 0 ? 1.0 : (double)c.update_bytes / (double)c.update_received_bytes; });
+    write_client_metric(stream, metrics, "revyv_client_decode_seconds_total", "counter", "Time spent decompressing the client's pixel updates.",
+        [](const ClientMetrics& c) { return (double)c.decode_time / 1e9; });
+    write_client_metric(stream, metrics, "revyv_client_event_send_failures_total", "counter", "Events that could not be sent to the client.",
+        [](const ClientMetrics& c) { return c.event_send_failures; });
+}
+
+MetricsServer::MetricsServer(uint16_t port, std::function<MetricsSnapshot()> get_snapshot)
+    : _port(port)
+    , _get_snapshot(std::move(get_snapshot))
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    if (_socket >= 0) {
+        close(_socket);
+    }
+}
+
+void MetricsServer::start()
+{
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (_socket < 0) {
+        throw std::runtime_error(std::string("metrics socket: ") + std::strerror(errno));
+    }
+    int reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(_port);
+    /* Loopback only, the node's exporter or a local Prometheus scrapes it. */
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(_socket, (const sockaddr*)&address, sizeof(address)) != 0 || listen(_socket, 8) != 0) {
+        throw std::runtime_error("metrics port " + std::to_string(_port) + ": " + std::strerror(errno));
+    }
+    std::cout << "Serving metrics on http://127.0.0.1:" << _port << "/metrics" << std::endl;
+    _thread = std::make_shared<std::thread>([this]() { serve(); });
+    _thread->detach();
+}
+
+void MetricsServer::serve()
+{
+    for (;;) {
+        auto client = accept(_socket, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cout << __func__ << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        try {
+            answer(client);
+        } catch (std::exception& e) {
+            std::cout << __func__ << ": " << e.what() << std::endl;
+        }
+        close(client);
+    }
+}
+
+void MetricsServer::answer(int client)
+{
+    /* A scraper's requests fit in one read, what they ask for doesn't matter. */
+    timeval timeout { 1, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef __APPLE__
+    int no_sigpipe = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+    char request[4096];
+    if (recv(client, request, sizeof(request), 0) <= 0) {
+        return;
+    }
+    std::ostringstream body;
+    write_metrics(body, _get_snapshot());
+    auto text = body.str();
+    std::ostringstream response;
+    response << "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << text.size()
+             << "\r\nConnection: close\r\n\r\n"
+             << text;
+    auto data = response.str();
+    for (size_t sent = 0; sent < data.size();) {
+        auto result = send(client, data.data() + sent, data.size() - sent, SEND_FLAGS);
+        if (result <= 0) {
+            return;
+        }
+        sent += (size_t)result;
+    }
+}
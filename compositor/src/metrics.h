@@ -0,0 +1,76 @@
+#ifndef REVYV_METRICS_H
+#define REVYV_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace revyv {
+
+/* Totals of one client since it connected, counted by its listener and read from any thread. */
+typedef struct ClientCounters {
+    /* Everything copied out of the client's shared memory. */
+    std::atomic<uint64_t> received_bytes = 0;
+    /* Pixel updates, as received and once decompressed. */
+    std::atomic<uint64_t> update_received_bytes = 0;
+    std::atomic<uint64_t> update_bytes = 0;
+    std::atomic<uint64_t> decode_time = 0;
+} ClientCounters;
+
+typedef struct
+{
+    pid_t pid;
+    uint64_t received_bytes;
+    uint64_t update_received_bytes;
+    uint64_t update_bytes;
+    uint64_t decode_time;
+    uint64_t event_send_failures;
+} ClientMetrics;
+
+typedef struct
+{
+    uint64_t windows;
+    uint64_t texture_resident_bytes;
+    uint64_t frames_composited;
+    uint64_t frames_missed;
+    /* Includes the clients that are gone, unlike the sum over clients. */
+    uint64_t event_send_failures;
+    std::vector<ClientMetrics> clients;
+} MetricsSnapshot;
+
+/* Prometheus text exposition format. */
+void write_metrics(std::ostream& stream, const MetricsSnapshot& metrics);
+
+/*
+ * Serves the metrics over HTTP on the loopback interface, for Prometheus or
+ * a node exporter to scrape. Every request gets the metrics, whatever its
+ * path. The snapshot is taken on the server's thread.
+ */
+class MetricsServer {
+public:
+    MetricsServer(uint16_t port, std::function<MetricsSnapshot()> get_snapshot);
+
+    ~MetricsServer();
+
+    void start();
+
+private:
+    void serve();
+
+    void answer(int client);
+
+private:
+    uint16_t _port;
+    std::function<MetricsSnapshot()> _get_snapshot;
+    int _socket = -1;
+    std::shared_ptr<std::thread> _thread;
+};
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef REVYV_MPSCQUEUE_H
+#define REVYV_MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace revyv {
+
+/*
+ * Unbounded lock-free queue with any number of producers and one consumer,
+ * after Dmitry Vyukov's intrusive MPSC queue. Pushing is a single atomic
+ * exchange and never waits; only the consumer thread may pop.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue()
+        : _head(&_stub)
+        , _tail(&_stub)
+    {
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) { }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value)
+    {
+        auto* node = new Node();
+        node->value = std::move(value);
+        push_node(node);
+    }
+
+    /*
+     * Takes the oldest value. Returns false when the queue is empty, or when a
+     * producer is halfway through a push, its value is returned by a later pop.
+     */
+    bool pop(T& value)
+    {
+        auto* tail = _tail;
+        auto* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &_stub) {
+            if (next == nullptr) {
+                return false;
+            }
+            _tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next == nullptr) {
+            if (tail != _head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            /* tail is the last node, the stub goes behind it so it can be taken. */
+            push_node(&_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+        }
+        _tail = next;
+        value = std::move(tail->value);
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next { nullptr };
+        T value {};
+    };
+
+    void push_node(Node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        auto* previous = _head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+private:
+    std::atomic<Node*> _head;
+    Node* _tail;
+    Node _stub;
+};
+}
+
+#endif
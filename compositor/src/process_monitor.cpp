@@ -0,0 +1,167 @@
+#include "process_monitor.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <ctime>
+#include <stdexcept>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#else
+#include <sys/event.h>
+#endif
+
+using namespace revyv;
+
+static constexpr int MAX_EVENTS = 16;
+
+#ifdef __linux__
+/* No pid is this large, it tells the wake eventfd apart from the pidfds. */
+static constexpr uint64_t WAKE_EVENT = UINT64_MAX;
+#endif
+
+ProcessMonitor::ProcessMonitor(bool use_pidfds)
+    : _use_pidfds(use_pidfds)
+{
+#ifdef __linux__
+    _fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_fd == -1) {
+        throw std::runtime_error("epoll_create1() failed");
+    }
+    _wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_EVENT;
+    if (_wake_fd == -1 || epoll_ctl(_fd, EPOLL_CTL_ADD, _wake_fd, &event) == -1) {
+        if (_wake_fd != -1) {
+            close(_wake_fd);
+        }
+        close(_fd);
+        throw std::runtime_error("eventfd() failed");
+    }
+#else
+    _fd = kqueue();
+    if (_fd == -1) {
+        throw std::runtime_error("kqueue() failed");
+    }
+#endif
+}
+
+bool ProcessMonitor::watch(pid_t pid)
+{
+#ifdef __linux__
+    auto pidfd = -1;
+    if (_use_pidfds) {
+        pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    } else {
+        errno = ENOSYS;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (pidfd == -1) {
+        if (errno != ENOSYS || kill(pid, 0) == -1) {
+            return false;
+        }
+        _processes[pid] = -1;
+        if (!_polling) {
+            _polling = true;
+            /* A waiter may be blocked without a timeout, it switches to polling once woken. */
+            uint64_t one = 1;
+            (void)!write(_wake_fd, &one, sizeof(one));
+        }
+        return true;
+    }
+    _processes[pid] = pidfd;
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.u64 = (uint64_t)pid;
+    if (epoll_ctl(_fd, EPOLL_CTL_ADD, pidfd, &event) == -1) {
+        _processes.erase(pid);
+        close(pidfd);
+        return false;
+    }
+    return true;
+#else
+    /* Fails with ESRCH when the process already exited. */
+    struct kevent change {};
+    EV_SET(&change, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+    return kevent(_fd, &change, 1, nullptr, 0, nullptr) != -1;
+#endif
+}
+
+void ProcessMonitor::wait_for_exits(std::vector<pid_t>& pids, int timeout)
+{
+#ifdef __linux__
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_polling && (timeout == -1 || timeout > POLL_INTERVAL)) {
+            timeout = POLL_INTERVAL;
+        }
+    }
+    epoll_event events[MAX_EVENTS];
+    auto count = epoll_wait(_fd, events, MAX_EVENTS, timeout);
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.u64 == WAKE_EVENT) {
+            uint64_t value;
+            (void)!read(_wake_fd, &value, sizeof(value));
+            continue;
+        }
+        auto pid = (pid_t)events[i].data.u64;
+        auto it = _processes.find(pid);
+        if (it != _processes.end()) {
+            epoll_ctl(_fd, EPOLL_CTL_DEL, it->second, nullptr);
+            close(it->second);
+            _processes.erase(it);
+        }
+        pids.push_back(pid);
+    }
+    if (_polling) {
+        poll_processes(pids);
+    }
+#else
+    timespec spec {};
+    timespec* wait = nullptr;
+    if (timeout != -1) {
+        spec.tv_sec = timeout / 1000;
+        spec.tv_nsec = (long)(timeout % 1000) * 1000000;
+        wait = &spec;
+    }
+    struct kevent events[MAX_EVENTS];
+    auto count = kevent(_fd, nullptr, 0, events, MAX_EVENTS, wait);
+    for (int i = 0; i < count; i++) {
+        if (events[i].filter == EVFILT_PROC && (events[i].fflags & NOTE_EXIT) != 0) {
+            pids.push_back((pid_t)events[i].ident);
+        }
+    }
+#endif
+}
+
+void ProcessMonitor::poll_processes(std::vector<pid_t>& pids)
+{
+    for (auto it = _processes.begin(); it != _processes.end();) {
+        if (it->second == -1 && kill(it->first, 0) == -1 && errno == ESRCH) {
+            pids.push_back(it->first);
+            it = _processes.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+ProcessMonitor::~ProcessMonitor()
+{
+    for (auto& process : _processes) {
+        if (process.second != -1) {
+            close(process.second);
+        }
+    }
+    if (_wake_fd != -1) {
+        close(_wake_fd);
+    }
+    close(_fd);
+}
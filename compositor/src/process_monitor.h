@@ -0,0 +1,56 @@
+#ifndef REVYV_PROCESSMONITOR_H
+#define REVYV_PROCESSMONITOR_H
+
+#include <mutex>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace revyv {
+
+/*
+ * Tells when client processes exit. Each watched process gets a pidfd in an
+ * epoll set on Linux, or an EVFILT_PROC filter in a kqueue on macOS, so
+ * waiting costs nothing until a client dies and then returns at once. On
+ * kernels without pidfd_open the watched processes are probed every
+ * POLL_INTERVAL instead, an eventfd in the epoll set wakes a waiter that
+ * started before the first of them was watched.
+ */
+class ProcessMonitor {
+public:
+    /* Without pidfds every process is probed, as on kernels without pidfd_open. For tests. */
+    explicit ProcessMonitor(bool use_pidfds = true);
+
+    ~ProcessMonitor();
+
+    ProcessMonitor(const ProcessMonitor&) = delete;
+
+    ProcessMonitor& operator=(const ProcessMonitor&) = delete;
+
+    /* Safe to call while another thread waits. Returns false when the process is already gone. */
+    bool watch(pid_t pid);
+
+    /*
+     * Blocks until watched processes exit or the timeout in milliseconds
+     * passes, -1 waits for ever. Returns early without exits while polling.
+     */
+    void wait_for_exits(std::vector<pid_t>& pids, int timeout);
+
+private:
+    static constexpr int POLL_INTERVAL = 100;
+
+    void poll_processes(std::vector<pid_t>& pids);
+
+private:
+    int _fd = -1;
+    /* Signalled when polling starts, tagged WAKE_EVENT in the epoll set. */
+    int _wake_fd = -1;
+    bool _use_pidfds;
+    bool _polling = false;
+    std::mutex _mutex;
+    /* pidfd of each watched process, or -1 when it is polled. */
+    std::unordered_map<pid_t, int> _processes;
+};
+}
+
+#endif
@@ -16,73 +16,60 @@ Publisher::Publisher(pid_t pid)
     std::cout << "Connected to event publisher for PID" << pid << " on " << _url << std::endl;
 }
 
-void Publisher::send_mouse_move_event(const std::shared_ptr<MouseMoveEvent>& event)
+void Publisher::send_event(const Event& event)
 {
     try {
-        auto req = event->translate();
-        auto result = _socket->send(zmq::message_t(&req, sizeof(PublisherPayload)), zmq::send_flags::none);
+        auto req = event_to_payload(event);
+        /* The text follows as the second part of the same message, so clients
+         * that drain without blocking never see an event without its text. */
+        auto flags = event.type == EventTypeText ? zmq::send_flags::sndmore : zmq::send_flags::none;
+        auto result = _socket->send(zmq::message_t(&req, sizeof(PublisherPayload)), flags);
         if (!result.has_value()) {
             throw FailedToSendDataError();
         }
+        if (event.type == EventTypeText) {
+            auto text_result = _socket->send(zmq::message_t(event.text.text, get_event_text_size(event)), zmq::send_flags::none);
+            if (!text_result.has_value()) {
+                throw FailedToSendDataError();
+            }
+        }
     } catch (std::exception& e) {
+        _send_failures.fetch_add(1, std::memory_order_relaxed);
         std::cout << __func__ << ": " << e.what() << std::endl;
     }
 }
 
-void Publisher::send_mouse_button_event(const std::shared_ptr<MouseButtonEvent>& event)
+void Publisher::send_mouse_history_event(const Event& event, const std::vector<MouseMoveSample>& samples)
 {
     try {
-        auto req = event->translate();
-        auto result = _socket->send(zmq::message_t(&req, sizeof(PublisherPayload)), zmq::send_flags::none);
-        if (!result.has_value()) {
+        auto req = event_to_payload(event);
+        auto event_result = _socket->send(zmq::message_t(&req, sizeof(PublisherPayload)), zmq::send_flags::sndmore);
+        if (!event_result.has_value()) {
+            throw FailedToSendDataError();
+        }
+        auto samples_result = _socket->send(zmq::message_t(samples.data(), samples.size() * sizeof(MouseMoveSample)), zmq::send_flags::none);
+        if (!samples_result.has_value()) {
             throw FailedToSendDataError();
         }
     } catch (std::exception& e) {
+        _send_failures.fetch_add(1, std::memory_order_relaxed);
         std::cout << __func__ << ": " << e.what() << std::endl;
     }
 }
 
-void Publisher::send_mouse_scroll_event(const std::shared_ptr<MouseScrollEvent>& event)
+bool Publisher::is_pointer_history_enabled() const
 {
-    try {
-        auto req = event->translate();
-        auto result = _socket->send(zmq::message_t(&req, sizeof(PublisherPayload)), zmq::send_flags::none);
-        if (!result.has_value()) {
-            throw FailedToSendDataError();
-        }
-    } catch (std::exception& e) {
-        std::cout << __func__ << ": " << e.what() << std::endl;
-    }
+    return _pointer_history_enabled;
 }
 
-void Publisher::send_text_event(const std::shared_ptr<TextEvent>& event)
+void Publisher::set_pointer_history_enabled(bool enabled)
 {
-    try {
-        auto req = event->translate();
-        auto event_result = _socket->send(zmq::message_t(&req, sizeof(PublisherPayload)), zmq::send_flags::none);
-        if (!event_result.has_value()) {
-            throw FailedToSendDataError();
-        }
-        auto text_result = _socket->send(zmq::message_t(event->get_text().c_str(), event->get_text().size()), zmq::send_flags::none);
-        if (!text_result.has_value()) {
-            throw FailedToSendDataError();
-        }
-    } catch (std::exception& e) {
-        std::cout << __func__ << ": " << e.what() << std::endl;
-    }
+    _pointer_history_enabled = enabled;
 }
 
-void Publisher::send_key_event(const std::shared_ptr<KeyEvent>& event)
+uint64_t Publisher::get_send_failure_count() const
 {
-    try {
-        auto req = event->translate();
-        auto result = _socket->send(zmq::message_t(&req, sizeof(PublisherPayload)), zmq::send_flags::none);
-        if (!result.has_value()) {
-            throw FailedToSendDataError();
-        }
-    } catch (std::exception& e) {
-        std::cout << __func__ << ": " << e.what() << std::endl;
-    }
+    return _send_failures.load(std::memory_order_relaxed);
 }
 
 Publisher::~Publisher()
@@ -1,8 +1,10 @@
 #ifndef REVYV_PUBLISHER_H
 #define REVYV_PUBLISHER_H
 
+#include <atomic>
 #include <compositor/types.h>
 #include <memory>
+#include <vector>
 #include <zmq.hpp>
 
 namespace revyv {
@@ -13,20 +15,23 @@ public:
 
     ~Publisher();
 
-    void send_mouse_move_event(const std::shared_ptr<MouseMoveEvent>& event);
+    /* Text events carry their text in a second message part. */
+    void send_event(const Event& event);
 
-    void send_mouse_button_event(const std::shared_ptr<MouseButtonEvent>& event);
+    void send_mouse_history_event(const Event& event, const std::vector<MouseMoveSample>& samples);
 
-    void send_mouse_scroll_event(const std::shared_ptr<MouseScrollEvent>& event);
+    [[nodiscard]] bool is_pointer_history_enabled() const;
 
-    void send_text_event(const std::shared_ptr<TextEvent>& event);
+    void set_pointer_history_enabled(bool enabled);
 
-    void send_key_event(const std::shared_ptr<KeyEvent>& event);
+    [[nodiscard]] uint64_t get_send_failure_count() const;
 
 private:
     std::string _url;
     std::shared_ptr<zmq::context_t> _ctx;
     std::shared_ptr<zmq::socket_t> _socket;
+    std::atomic<bool> _pointer_history_enabled = false;
+    std::atomic<uint64_t> _send_failures = 0;
 };
 
 }
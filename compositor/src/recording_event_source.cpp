@@ -0,0 +1,52 @@
+#include "recording_event_source.h"
+#include "event_recording.h"
+#include <compositor/latency_histogram.h>
+
+using namespace revyv;
+
+RecordingEventSource::RecordingEventSource(const std::shared_ptr<EventSource>& source, const std::string& path)
+    : _source(source)
+    , _file(path, std::ios::binary | std::ios::trunc)
+{
+    if (!_file) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    EventRecordingHeader header {};
+    std::memcpy(header.magic, EVENT_RECORDING_MAGIC, sizeof(header.magic));
+    header.version = EVENT_RECORDING_VERSION;
+    header.event_size = sizeof(Event);
+    _file.write((const char*)&header, sizeof(header));
+    _start = get_monotonic_time_ns();
+    std::cout << "Recording input to " << path << std::endl;
+}
+
+RecordingEventSource::~RecordingEventSource()
+{
+    _file.flush();
+    std::cout << "Recorded " << _event_count << " events" << std::endl;
+}
+
+bool RecordingEventSource::poll_event(Event& event)
+{
+    if (!_source->poll_event(event)) {
+        /* The source is drained once per frame, a crash loses at most one frame. */
+        _file.flush();
+        return false;
+    }
+    if (event.type != EventTypeQuit) {
+        record_event(event);
+    }
+    return true;
+}
+
+void RecordingEventSource::record_event(const Event& event)
+{
+    EventRecord record {};
+    auto received = event.stage_times.received != 0 ? event.stage_times.received : get_monotonic_time_ns();
+    record.time = received > _start ? received - _start : 0;
+    record.type = event.type;
+    record.timestamp = event.timestamp;
+    _file.write((const char*)&record, sizeof(record));
+    _file.write((const char*)&event.mouse, (std::streamsize)get_event_record_data_size(event.type));
+    _event_count++;
+}
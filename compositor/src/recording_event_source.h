@@ -0,0 +1,31 @@
+#ifndef REVYV_RECORDINGEVENTSOURCE_H
+#define REVYV_RECORDINGEVENTSOURCE_H
+
+#include "event_source.h"
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace revyv {
+
+/* Passes the events of another source through, writing them to a recording. */
+class RecordingEventSource : public EventSource {
+public:
+    RecordingEventSource(const std::shared_ptr<EventSource>& source, const std::string& path);
+
+    ~RecordingEventSource() override;
+
+    [[nodiscard]] bool poll_event(Event& event) override;
+
+private:
+    void record_event(const Event& event);
+
+private:
+    std::shared_ptr<EventSource> _source;
+    std::ofstream _file;
+    uint64_t _start = 0;
+    uint64_t _event_count = 0;
+};
+}
+
+#endif
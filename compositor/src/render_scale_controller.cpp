@@ -0,0 +1,76 @@
+#include "render_scale_controller.h"
+#include "server.h"
+#include <algorithm>
+
+using namespace revyv;
+
+const double RENDER_SCALE_STEP = 0.25;
+const double RENDER_SCALE_MIN = 0.5;
+const double RENDER_SCALE_MAX = 1.0;
+const double HEADROOM_RATIO = 0.6;
+const uint32_t FRAMES_BETWEEN_CHANGES = 30;
+
+RenderScaleController::RenderScaleController(double frame_budget)
+    : _frame_budget(frame_budget)
+{
+}
+
+void RenderScaleController::frame_completed(const std::shared_ptr<Compositor>& compositor)
+{
+    _average_frame_time = 0.9 * _average_frame_time + 0.1 * compositor->get_last_frame_time();
+    if (++_frames_since_change < FRAMES_BETWEEN_CHANGES) {
+        return;
+    }
+    if (_average_frame_time > _frame_budget) {
+        scale_down_heaviest_window(compositor);
+    } else if (_average_frame_time < _frame_budget * HEADROOM_RATIO) {
+        scale_up_smallest_window(compositor);
+    }
+    /* Upload counters cover the frames since the last decision. */
+    compositor->for_each_window([](const std::shared_ptr<Window>& window) { (void)window->take_uploaded_bytes(); });
+    _frames_since_change = 0;
+}
+
+void RenderScaleController::scale_down_heaviest_window(const std::shared_ptr<Compositor>& compositor)
+{
+    std::shared_ptr<Window> heaviest;
+    uint64_t heaviest_bytes = 0;
+    compositor->for_each_window([&](const std::shared_ptr<Window>& window) {
+        auto bytes = window->take_uploaded_bytes();
+        if (bytes > heaviest_bytes && window->get_render_scale() > RENDER_SCALE_MIN) {
+            heaviest = window;
+            heaviest_bytes = bytes;
+        }
+    });
+    if (heaviest != nullptr) {
+        set_render_scale(heaviest, std::max(RENDER_SCALE_MIN, heaviest->get_render_scale() - RENDER_SCALE_STEP));
+    }
+}
+
+void RenderScaleController::scale_up_smallest_window(const std::shared_ptr<Compositor>& compositor)
+{
+    std::shared_ptr<Window> smallest;
+    compositor->for_each_window([&](const std::shared_ptr<Window>& window) {
+        if (window->get_render_scale() < RENDER_SCALE_MAX
+            && (smallest == nullptr || window->get_render_scale() < smallest->get_render_scale())) {
+            smallest = window;
+        }
+    });
+    if (smallest != nullptr) {
+        set_render_scale(smallest, std::min(RENDER_SCALE_MAX, smallest->get_render_scale() + RENDER_SCALE_STEP));
+    }
+}
+
+void RenderScaleController::set_render_scale(const std::shared_ptr<Window>& window, double scale)
+{
+    window->set_render_scale(scale);
+    auto publisher = Server::get_shared_instance()->get_publisher(window->get_pid());
+    if (publisher.expired() || publisher.lock() == nullptr) {
+        return;
+    }
+    auto event = make_event(EventTypeWindowScale);
+    event.window_id = window->get_id();
+    event.scale.scale = scale;
+    publisher.lock()->send_event(event);
+    std::cout << "Render scale of window " << window->get_id() << " set to " << scale << std::endl;
+}
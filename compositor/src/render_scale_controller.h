@@ -0,0 +1,36 @@
+#ifndef REVYV_RENDERSCALECONTROLLER_H
+#define REVYV_RENDERSCALECONTROLLER_H
+
+#include "compositor.h"
+#include <memory>
+
+namespace revyv {
+
+/*
+ * Lowers the render scale of the heaviest clients when frames take longer
+ * than the budget, and gives it back once there is headroom again. Clients
+ * are told about their new scale with a EventTypeWindowScale event and answer with a
+ * buffer of the new size, which is stretched to the window frame.
+ */
+class RenderScaleController {
+public:
+    explicit RenderScaleController(double frame_budget);
+
+    void frame_completed(const std::shared_ptr<Compositor>& compositor);
+
+private:
+    void scale_down_heaviest_window(const std::shared_ptr<Compositor>& compositor);
+
+    void scale_up_smallest_window(const std::shared_ptr<Compositor>& compositor);
+
+    static void set_render_scale(const std::shared_ptr<Window>& window, double scale);
+
+private:
+    double _frame_budget;
+    double _average_frame_time = 0;
+    uint32_t _frames_since_change = 0;
+};
+
+}
+
+#endif
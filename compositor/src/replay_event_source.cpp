@@ -0,0 +1,96 @@
+#include "replay_event_source.h"
+#include "event_recording.h"
+#include <compositor/latency_histogram.h>
+#include <fstream>
+
+using namespace revyv;
+
+/* At full speed, the events handed out per drain, so frames keep going. */
+static const size_t REPLAY_BURST_MAX = 1024;
+
+ReplayEventSource::ReplayEventSource(const std::string& path, double speed, const std::shared_ptr<EventSource>& live_source)
+    : _speed(speed)
+    , _live_source(live_source)
+{
+    load(path);
+    std::cout << "Replaying " << _events.size() << " events from " << path << std::endl;
+}
+
+void ReplayEventSource::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    EventRecordingHeader header {};
+    file.read((char*)&header, sizeof(header));
+    if (!file || std::memcmp(header.magic, EVENT_RECORDING_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not an input recording");
+    }
+    if (header.version != EVENT_RECORDING_VERSION || header.event_size != sizeof(Event)) {
+        throw std::runtime_error(path + " was recorded by an incompatible build");
+    }
+    EventRecord record {};
+    while (file.read((char*)&record, sizeof(record))) {
+        auto event = make_event((EventType)record.type);
+        event.timestamp = record.timestamp;
+        auto size = get_event_record_data_size(event.type);
+        if (!file.read((char*)&event.mouse, (std::streamsize)size)) {
+            break;
+        }
+        _events.push_back(event);
+        _times.push_back(record.time);
+    }
+}
+
+bool ReplayEventSource::poll_event(Event& event)
+{
+    if (is_finished()) {
+        return _live_source != nullptr && _live_source->poll_event(event);
+    }
+    if (_live_source != nullptr) {
+        Event live_event {};
+        while (_live_source->poll_event(live_event)) {
+            if (live_event.type == EventTypeQuit) {
+                event = live_event;
+                return true;
+            }
+        }
+    }
+    auto now = get_monotonic_time_ns();
+    if (_start == 0) {
+        _start = now;
+    }
+    if (_speed > 0) {
+        if ((double)(now - _start) * _speed < (double)_times[_next]) {
+            return false;
+        }
+    } else if (_burst == REPLAY_BURST_MAX) {
+        _burst = 0;
+        return false;
+    }
+    event = _events[_next++];
+    event.stage_times.received = now;
+    _burst++;
+    if (is_finished()) {
+        std::cout << "Replay finished after " << (double)(now - _start) / 1e9 << " s" << std::endl;
+    }
+    return true;
+}
+
+size_t ReplayEventSource::get_event_count() const
+{
+    return _events.size();
+}
+
+bool ReplayEventSource::is_finished() const
+{
+    return _next >= _events.size();
+}
+
+void ReplayEventSource::rewind()
+{
+    _next = 0;
+    _start = 0;
+    _burst = 0;
+}
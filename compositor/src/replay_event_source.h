@@ -0,0 +1,44 @@
+#ifndef REVYV_REPLAYEVENTSOURCE_H
+#define REVYV_REPLAYEVENTSOURCE_H
+
+#include "event_source.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace revyv {
+
+/*
+ * Feeds a recording back, at its original pace scaled by speed, or as fast as
+ * possible when speed is 0. The live source, when given, takes over once the
+ * recording ends; until then only its quit events are passed through.
+ */
+class ReplayEventSource : public EventSource {
+public:
+    ReplayEventSource(const std::string& path, double speed, const std::shared_ptr<EventSource>& live_source);
+
+    [[nodiscard]] bool poll_event(Event& event) override;
+
+    [[nodiscard]] size_t get_event_count() const;
+
+    [[nodiscard]] bool is_finished() const;
+
+    /* Starts over from the first event. */
+    void rewind();
+
+private:
+    void load(const std::string& path);
+
+private:
+    std::vector<Event> _events;
+    std::vector<uint64_t> _times;
+    double _speed;
+    std::shared_ptr<EventSource> _live_source;
+    size_t _next = 0;
+    uint64_t _start = 0;
+    /* Events handed out since poll_event() last returned false. */
+    size_t _burst = 0;
+};
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef REVYV_SAMPLERING_H
+#define REVYV_SAMPLERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace revyv {
+
+/*
+ * Fixed size ring of the latest samples, written by one thread and read by
+ * any number of others without locks. Every slot is a seqlock, the writer
+ * marks it odd while it writes and readers leave out a slot that changed
+ * while they copied it, so readers never hold up the render thread.
+ */
+template <typename T, size_t N>
+class SampleRing {
+    static_assert(std::is_trivially_copyable<T>::value, "samples are copied word by word");
+
+public:
+    /* Writer thread only. */
+    void push(const T& value)
+    {
+        auto index = _written.load(std::memory_order_relaxed);
+        auto& slot = _slots[index % N];
+        uint64_t words[WORD_COUNT] {};
+        std::memcpy(words, &value, sizeof(T));
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORD_COUNT; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        _written.store(index + 1, std::memory_order_release);
+    }
+
+    /* Up to count of the latest samples, oldest first. */
+    [[nodiscard]] std::vector<T> get_latest(size_t count) const
+    {
+        auto written = _written.load(std::memory_order_acquire);
+        if (count > N) {
+            count = N;
+        }
+        auto first = written > count ? written - count : 0;
+        std::vector<T> values;
+        values.reserve((size_t)(written - first));
+        for (auto index = first; index < written; index++) {
+            auto& slot = _slots[index % N];
+            if (slot.sequence.load(std::memory_order_acquire) != 2 * index + 2) {
+                continue;
+            }
+            uint64_t words[WORD_COUNT];
+            for (size_t i = 0; i < WORD_COUNT; i++) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != 2 * index + 2) {
+                continue;
+            }
+            T value;
+            std::memcpy(&value, words, sizeof(T));
+            values.push_back(value);
+        }
+        return values;
+    }
+
+    /* Samples pushed since the start, including the ones overwritten since. */
+    [[nodiscard]] uint64_t get_count() const
+    {
+        return _written.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    struct Slot {
+        std::atomic<uint64_t> sequence { 0 };
+        std::atomic<uint64_t> words[WORD_COUNT] {};
+    };
+
+    Slot _slots[N];
+    std::atomic<uint64_t> _written = 0;
+};
+}
+
+#endif
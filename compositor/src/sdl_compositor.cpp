@@ -1,32 +1,120 @@
 #include "sdl_compositor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <compositor/trace.h>
+#include <cstdlib>
 #include <memory>
 
 using namespace revyv;
 
-SDLCompositor::SDLCompositor(const Size& size)
+/* The renderer's preferred texture format, ARGB when there is none. */
+static WindowRasterType read_native_raster_type(SDL_Renderer* renderer)
 {
+    SDL_RendererInfo info;
+    if (renderer == nullptr || SDL_GetRendererInfo(renderer, &info) != 0 || info.num_texture_formats == 0) {
+        return WindowRasterARGB;
+    }
+    switch (info.texture_formats[0]) {
+    case SDL_PIXELFORMAT_RGBA8888:
+        return WindowRasterRGBA;
+    case SDL_PIXELFORMAT_ABGR8888:
+        return WindowRasterABGR;
+    case SDL_PIXELFORMAT_BGRA8888:
+        return WindowRasterBGRA;
+    default:
+        return WindowRasterARGB;
+    }
+}
+
+SDLCompositor::SDLCompositor(const Size& size, uint64_t texture_budget, double upload_budget, const std::shared_ptr<WorkPool>& work_pool, bool headless)
+    : Compositor(size)
+    , _texture_budget(texture_budget)
+{
+    /* Either can still be overridden from the environment, to load test a real renderer. */
+    if (headless) {
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+        SDL_SetHintWithPriority(SDL_HINT_RENDER_DRIVER, "software", SDL_HINT_DEFAULT);
+    }
     if (SDL_Init(SDL_INIT_VIDEO) == 0) {
         _window = SDL_CreateWindow("Revyv", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, (int)size.width, (int)size.height, SDL_WINDOW_SHOWN);
         _renderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
         SDL_SetRenderDrawBlendMode(_renderer, SDL_BLENDMODE_BLEND);
     }
+    /* Read once here, clients ask for it from the server thread. */
+    _native_raster_type = read_native_raster_type(_renderer);
+    _texture_uploader = std::make_unique<TextureUploader>(_renderer, work_pool, upload_budget);
 }
 
 void SDLCompositor::compose()
 {
+    TraceSpan span("compose");
+    auto start = std::chrono::steady_clock::now();
+    auto stage_start = get_monotonic_time_ns();
+    _frame++;
+    TraceSpan upload_span("upload");
+    _texture_uploader->begin_frame();
+    _ordered_windows.clear();
+    _window_table.for_each_bottom_to_top([this](const std::shared_ptr<Window>& window) { _ordered_windows.push_back(window); });
+    _window_table.update_occlusion();
+    schedule_updates(_ordered_windows);
+    /* Evict before drawing, render targets are switched to read textures back. */
+    _texture_budget.enforce(_ordered_windows);
+    sort_upload_order();
+    for (auto& window : _upload_order) {
+        window->perform_operations();
+    }
+    _texture_uploader->end_frame();
+    /* The updates just applied may have made windows opaque or translucent. */
+    _window_table.update_occlusion();
+    upload_span.end();
+    auto now = get_monotonic_time_ns();
+    _profiler.record_stage(FrameStageUpload, now - stage_start);
+    stage_start = now;
+    TraceSpan draw_span("draw");
     SDL_SetRenderDrawColor(_renderer, 255, 255, 255, 255);
     SDL_RenderClear(_renderer);
-    for (auto it = _orders.begin(); it != _orders.end();) {
-        if (_windows.find(*it) == _windows.end()) {
-            continue;
+    for (auto& window : _ordered_windows) {
+        window->draw();
+        if (window->is_visible() && !window->is_occluded()) {
+            window->set_last_drawn_frame(_frame);
         }
-        auto window = _windows[*it];
-        if (window != nullptr) {
-            window->perform_operations_and_draw();
-        }
-        it++;
+        _profiler.record_window(*window);
     }
+    /* Present blocks on vsync, so it is left out of the frame time. */
+    _last_frame_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    now = get_monotonic_time_ns();
+    _profiler.record_stage(FrameStageDraw, now - stage_start);
+    draw_span.end();
+    TraceSpan present_span("present");
     SDL_RenderPresent(_renderer);
+    _profiler.record_stage(FrameStagePresent, get_monotonic_time_ns() - now);
+}
+
+void SDLCompositor::sort_upload_order()
+{
+    auto pointer = get_pointer_location();
+    auto get_rank = [pointer](const std::shared_ptr<Window>& window) {
+        auto frame = window->get_frame();
+        auto dx = std::max({ frame.location.x - pointer.x, 0.0, pointer.x - frame.location.x - frame.size.width });
+        auto dy = std::max({ frame.location.y - pointer.y, 0.0, pointer.y - frame.location.y - frame.size.height });
+        double group = 2;
+        if (window->get_update_priority() == UpdatePriorityForeground) {
+            group = 0;
+        } else if (window->is_visible() && !window->is_occluded()) {
+            group = 1;
+        }
+        /* Groups are further apart than any two distances on screen. */
+        return group * 1e9 + std::sqrt(dx * dx + dy * dy);
+    };
+    _upload_order.clear();
+    _upload_order.insert(_upload_order.end(), _ordered_windows.begin(), _ordered_windows.end());
+    std::stable_sort(_upload_order.begin(), _upload_order.end(), [&get_rank](auto& a, auto& b) { return get_rank(a) < get_rank(b); });
+}
+
+WindowRasterType SDLCompositor::get_native_raster_type() const
+{
+    return _native_raster_type;
 }
 
 SDL_Renderer* SDLCompositor::get_renderer() const
@@ -34,7 +122,28 @@ SDL_Renderer* SDLCompositor::get_renderer() const
     return _renderer;
 }
 
+TextureUploader* SDLCompositor::get_texture_uploader() const
+{
+    return _texture_uploader.get();
+}
+
+TextureStatistics SDLCompositor::get_texture_statistics() const
+{
+    return _texture_budget.get_statistics(_ordered_windows);
+}
+
+UploadStatistics SDLCompositor::get_upload_statistics() const
+{
+    return _texture_uploader->get_budget().get_statistics();
+}
+
+void SDLCompositor::reset_upload_statistics()
+{
+    _texture_uploader->get_budget().reset_statistics();
+}
+
 SDLCompositor::~SDLCompositor()
 {
+    _texture_uploader = nullptr;
     SDL_Quit();
 }
@@ -2,23 +2,50 @@
 #define REVYV_SDLCOMPOSITOR_H
 
 #include "compositor.h"
+#include "texture_budget.h"
+#include "texture_uploader.h"
+#include "upload_budget.h"
+#include "work_pool.h"
 #include <SDL2/SDL.h>
 #include <memory>
 
 namespace revyv {
 class SDLCompositor : public Compositor {
 public:
-    explicit SDLCompositor(const Size& size);
+    /*
+     * Headless renders with SDL's software renderer into the dummy video
+     * driver, so no display or GPU is needed, for load tests and benchmarks.
+     */
+    SDLCompositor(const Size& size, uint64_t texture_budget, double upload_budget, const std::shared_ptr<WorkPool>& work_pool, bool headless);
 
     virtual ~SDLCompositor();
 
     void compose() override;
 
+    [[nodiscard]] WindowRasterType get_native_raster_type() const override;
+
     [[nodiscard]] SDL_Renderer* get_renderer() const;
 
+    [[nodiscard]] TextureUploader* get_texture_uploader() const;
+
+    [[nodiscard]] TextureStatistics get_texture_statistics() const;
+
+    [[nodiscard]] UploadStatistics get_upload_statistics() const;
+
+    void reset_upload_statistics();
+
+private:
+    /* Foreground windows first, then the visible ones, each nearest to the pointer first. */
+    void sort_upload_order();
+
 private:
     SDL_Window* _window = nullptr;
     SDL_Renderer* _renderer = nullptr;
+    WindowRasterType _native_raster_type = WindowRasterARGB;
+    TextureBudget _texture_budget;
+    std::unique_ptr<TextureUploader> _texture_uploader;
+    std::vector<std::shared_ptr<Window>> _ordered_windows;
+    std::vector<std::shared_ptr<Window>> _upload_order;
 };
 }
 
@@ -1,77 +1,95 @@
 #include "sdl_event_source.h"
 #include "server.h"
 #include <SDL2/SDL.h>
+#include <compositor/latency_histogram.h>
 
 using namespace revyv;
 
 SDLEventSource::SDLEventSource() = default;
 
-std::shared_ptr<Event> SDLEventSource::poll_event()
+bool SDLEventSource::poll_event(Event& event)
 {
     SDL_Event sdl_event;
-    if (SDL_PollEvent(&sdl_event)) {
-        if (sdl_event.type == SDL_QUIT) {
-            return std::make_shared<QuitEvent>();
-        } else if (sdl_event.type == SDL_MOUSEMOTION) {
-            _mouse_x = sdl_event.motion.x;
-            _mouse_y = sdl_event.motion.y;
-            auto event = std::make_shared<MouseMoveEvent>();
-            event->set_timestamp(sdl_event.motion.timestamp);
-            event->set_x(sdl_event.motion.x);
-            event->set_y(sdl_event.motion.y);
-            return event;
-        } else if (sdl_event.type == SDL_MOUSEBUTTONDOWN || sdl_event.type == SDL_MOUSEBUTTONUP) {
-            auto event = std::make_shared<MouseButtonEvent>();
-            event->set_timestamp(sdl_event.button.timestamp);
-            event->set_x(sdl_event.motion.x);
-            event->set_y(sdl_event.motion.y);
-            if (sdl_event.type == SDL_MOUSEBUTTONDOWN) {
-                event->set_state(MouseButtonStatePressed);
-            } else if (sdl_event.type == SDL_MOUSEBUTTONUP) {
-                event->set_state(MouseButtonStateReleased);
-            } else {
-                event->set_state(MouseButtonStateUndefined);
-            }
-            if (sdl_event.button.button == SDL_BUTTON_RIGHT) {
-                event->set_button(MouseButtonTypeRight);
-            } else if (sdl_event.button.button == SDL_BUTTON_LEFT) {
-                event->set_button(MouseButtonTypeLeft);
-            } else if (sdl_event.button.button == SDL_BUTTON_MIDDLE) {
-                event->set_button(MouseButtonTypeMiddle);
-            } else {
-                event->set_button(MouseButtonTypeUndefined);
-            }
-            event->setClicks(sdl_event.button.clicks);
-            return event;
-        } else if (sdl_event.type == SDL_MOUSEWHEEL) {
-            auto event = std::make_shared<MouseScrollEvent>();
-            event->set_timestamp(sdl_event.wheel.timestamp);
-            event->set_x(_mouse_x);
-            event->set_y(_mouse_y);
-            event->setScrollX(sdl_event.wheel.x);
-            event->setScrollY(sdl_event.wheel.y);
-            event->set_flipped(false);
-            return event;
-        } else if (sdl_event.type == SDL_KEYDOWN || sdl_event.type == SDL_KEYUP) {
-            auto event = std::make_shared<KeyEvent>();
-            event->set_timestamp(sdl_event.key.timestamp);
-            event->set_keycode(sdl_event.key.keysym.sym);
-            event->set_keymod(sdl_event.key.keysym.mod);
-            event->set_scancode(sdl_event.key.keysym.scancode);
-            event->set_repeat(sdl_event.key.repeat);
-            if (sdl_event.key.state == SDL_PRESSED) {
-                event->set_state(KeyStatePressed);
-            } else if (sdl_event.key.state == SDL_RELEASED) {
-                event->set_state(KeyStateReleased);
-            } else {
-                event->set_state(KeyStateUndefined);
-            }
-            return event;
-        } else if (sdl_event.type == SDL_TEXTINPUT) {
-            auto event = std::make_shared<TextEvent>();
-            event->set_text(sdl_event.text.text);
-            return event;
+    while (SDL_PollEvent(&sdl_event)) {
+        if (!translate_event(sdl_event, event)) {
+            continue;
         }
+        /* SDL stamps events in milliseconds when it queues them, the time they
+         * waited in its queue during the frame counts as well. */
+        auto now = get_monotonic_time_ns();
+        auto ticks = SDL_GetTicks();
+        auto waited = ticks >= event.timestamp ? (uint64_t)(ticks - event.timestamp) * 1000000 : 0;
+        event.stage_times.received = now > waited ? now - waited : now;
+        return true;
     }
-    return nullptr;
+    return false;
+}
+
+bool SDLEventSource::translate_event(const SDL_Event& sdl_event, Event& event)
+{
+    if (sdl_event.type == SDL_QUIT) {
+        event = make_event(EventTypeQuit);
+        return true;
+    } else if (sdl_event.type == SDL_MOUSEMOTION) {
+        _mouse_x = sdl_event.motion.x;
+        _mouse_y = sdl_event.motion.y;
+        event = make_event(EventTypeMouseMove);
+        event.timestamp = sdl_event.motion.timestamp;
+        event.mouse.x = sdl_event.motion.x;
+        event.mouse.y = sdl_event.motion.y;
+        return true;
+    } else if (sdl_event.type == SDL_MOUSEBUTTONDOWN || sdl_event.type == SDL_MOUSEBUTTONUP) {
+        event = make_event(EventTypeMouseButton);
+        event.timestamp = sdl_event.button.timestamp;
+        event.mouse.x = sdl_event.button.x;
+        event.mouse.y = sdl_event.button.y;
+        if (sdl_event.type == SDL_MOUSEBUTTONDOWN) {
+            event.mouse.state = MouseButtonStatePressed;
+        } else if (sdl_event.type == SDL_MOUSEBUTTONUP) {
+            event.mouse.state = MouseButtonStateReleased;
+        } else {
+            event.mouse.state = MouseButtonStateUndefined;
+        }
+        if (sdl_event.button.button == SDL_BUTTON_RIGHT) {
+            event.mouse.button = MouseButtonTypeRight;
+        } else if (sdl_event.button.button == SDL_BUTTON_LEFT) {
+            event.mouse.button = MouseButtonTypeLeft;
+        } else if (sdl_event.button.button == SDL_BUTTON_MIDDLE) {
+            event.mouse.button = MouseButtonTypeMiddle;
+        } else {
+            event.mouse.button = MouseButtonTypeUndefined;
+        }
+        event.mouse.clicks = sdl_event.button.clicks;
+        return true;
+    } else if (sdl_event.type == SDL_MOUSEWHEEL) {
+        event = make_event(EventTypeMouseScroll);
+        event.timestamp = sdl_event.wheel.timestamp;
+        event.mouse.x = _mouse_x;
+        event.mouse.y = _mouse_y;
+        event.mouse.scroll_x = sdl_event.wheel.x;
+        event.mouse.scroll_y = sdl_event.wheel.y;
+        event.mouse.flipped = false;
+        return true;
+    } else if (sdl_event.type == SDL_KEYDOWN || sdl_event.type == SDL_KEYUP) {
+        event = make_event(EventTypeKey);
+        event.timestamp = sdl_event.key.timestamp;
+        event.key.keycode = sdl_event.key.keysym.sym;
+        event.key.keymod = sdl_event.key.keysym.mod;
+        event.key.scancode = sdl_event.key.keysym.scancode;
+        event.key.repeat = sdl_event.key.repeat;
+        if (sdl_event.key.state == SDL_PRESSED) {
+            event.key.state = KeyStatePressed;
+        } else if (sdl_event.key.state == SDL_RELEASED) {
+            event.key.state = KeyStateReleased;
+        } else {
+            event.key.state = KeyStateUndefined;
+        }
+        return true;
+    } else if (sdl_event.type == SDL_TEXTINPUT) {
+        event = make_event(EventTypeText);
+        event.timestamp = sdl_event.text.timestamp;
+        set_event_text(event, sdl_event.text.text);
+        return true;
+    }
+    return false;
 }
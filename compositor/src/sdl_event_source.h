@@ -2,6 +2,7 @@
 #define REVYV_SDLINPUTSOURCE_H
 
 #include "event_source.h"
+#include <SDL2/SDL.h>
 #include <memory>
 
 namespace revyv {
@@ -9,7 +10,11 @@ class SDLEventSource : public EventSource {
 public:
     SDLEventSource();
 
-    [[nodiscard]] std::shared_ptr<Event> poll_event() override;
+    [[nodiscard]] bool poll_event(Event& event) override;
+
+private:
+    /* Returns false for SDL events that have no revyv counterpart. */
+    bool translate_event(const SDL_Event& sdl_event, Event& event);
 
 private:
     double _mouse_x = 0;
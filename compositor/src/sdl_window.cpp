@@ -1,13 +1,86 @@
 #include "sdl_window.h"
 #include "geometry.h"
+#include <algorithm>
+#include <compositor/latency_histogram.h>
+#include <compositor/trace.h>
+#include <cstring>
 #include <iostream>
+#include <lzo/lzo1x.h>
 
 using namespace revyv;
 
-SDLWindow::SDLWindow(pid_t pid, uint32_t id, WindowRasterType raster_type, SDL_Renderer* renderer)
+/* Rows of a rect uploaded at once are about this many bytes. */
+static const size_t TILE_BYTES = 256 * 1024;
+
+/* Beyond this many rects, coalesced updates are concatenated without looking for covered ones. */
+static const size_t COALESCE_COVER_CHECK_MAX = 256;
+
+static std::vector<unsigned char> compress_pixels(const unsigned char* pixels, size_t size)
+{
+    std::vector<unsigned char> wrkmem(LZO1X_1_MEM_COMPRESS);
+    std::vector<unsigned char> compressed(size + size / 16 + 64 + 3);
+    lzo_uint compressed_size = 0;
+    if (lzo1x_1_compress(pixels, size, compressed.data(), &compressed_size, wrkmem.data()) != LZO_E_OK) {
+        throw std::runtime_error("lzo1x_1_compress() failed");
+    }
+    compressed.resize(compressed_size);
+    compressed.shrink_to_fit();
+    return compressed;
+}
+
+static std::vector<unsigned char> decompress_pixels(const std::vector<unsigned char>& compressed, size_t size)
+{
+    std::vector<unsigned char> pixels(size);
+    lzo_uint new_size = size;
+    if (lzo1x_decompress(compressed.data(), compressed.size(), pixels.data(), &new_size, nullptr) != LZO_E_OK
+        || new_size != size) {
+        throw std::runtime_error("lzo1x_decompress() failed");
+    }
+    return pixels;
+}
+
+static size_t get_rects_bytes(const std::vector<Rect>& rects)
+{
+    size_t size = 0;
+    for (auto& r : rects) {
+        size += (size_t)(4 * r.size.width * r.size.height);
+    }
+    return size;
+}
+
+/*
+ * Copies the packed rects into a buffer of the given size. Rects are clipped
+ * to the buffer like SDL_UpdateTexture() clips them to a texture, so a rect
+ * sent before a resize can't write past it.
+ */
+static void copy_rects(unsigned char* buffer, const Size& buffer_size, const unsigned char* pixels, const std::vector<Rect>& rects)
+{
+    auto buffer_width = (int64_t)buffer_size.width;
+    auto buffer_height = (int64_t)buffer_size.height;
+    for (auto& r : rects) {
+        auto x = (int64_t)r.location.x;
+        auto y = (int64_t)r.location.y;
+        auto width = std::max((int64_t)r.size.width, (int64_t)0);
+        auto height = std::max((int64_t)r.size.height, (int64_t)0);
+        auto left = std::max(x, (int64_t)0);
+        auto right = std::min(x + width, buffer_width);
+        auto top = std::max(y, (int64_t)0);
+        auto bottom = std::min(y + height, buffer_height);
+        for (auto row = top; left < right && row < bottom; row++) {
+            std::memcpy(
+                buffer + (size_t)(4 * (row * buffer_width + left)),
+                pixels + (size_t)(4 * ((row - y) * width + left - x)),
+                (size_t)(4 * (right - left)));
+        }
+        pixels += (size_t)(4 * width * height);
+    }
+}
+
+SDLWindow::SDLWindow(pid_t pid, uint32_t id, WindowRasterType raster_type, SDL_Renderer* renderer, TextureUploader* uploader)
     : Window(pid, id, raster_type)
     , _texture(nullptr)
     , _renderer(renderer)
+    , _uploader(uploader)
 {
 }
 
@@ -16,96 +89,364 @@ void SDLWindow::move(Point point)
     Task task {};
     task.type = TaskTypeMove;
     task.point = point;
-    _tasks.push(task);
+    _tasks.push_back(task);
 }
 
-void SDLWindow::create(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect)
+void SDLWindow::create(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect, bool opaque)
 {
     Task task {};
     task.type = TaskTypeCreate;
     task.pixels = pixels;
     task.rect = rect;
-    _tasks.push(task);
+    task.opaque = opaque;
+    _tasks.push_back(task);
 }
 
-void SDLWindow::resize(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size)
+void SDLWindow::resize(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque)
 {
     Task task {};
     task.type = TaskTypeResize;
     task.pixels = pixels;
     task.size = size;
-    _tasks.push(task);
+    task.opaque = opaque;
+    _tasks.push_back(task);
 }
 
-void SDLWindow::update_pixels(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect)
+void SDLWindow::resize_buffer(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque)
+{
+    Task task {};
+    task.type = TaskTypeResizeBuffer;
+    task.pixels = pixels;
+    task.size = size;
+    task.opaque = opaque;
+    _tasks.push_back(task);
+}
+
+void SDLWindow::update_pixels(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect, const UpdateStamp& stamp, bool opaque)
 {
     Task task {};
     task.type = TaskTypeUpdatePixels;
     task.pixels = pixels;
-    task.rect = rect;
-    _tasks.push(task);
+    task.rects = { rect };
+    task.stamp = stamp;
+    task.opaque = opaque;
+    _tasks.push_back(task);
 }
 
-void SDLWindow::perform_operations_and_draw()
+void SDLWindow::update_rects(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const std::vector<Rect>& rects, const UpdateStamp& stamp, bool opaque)
+{
+    Task task {};
+    task.type = TaskTypeUpdatePixels;
+    task.pixels = pixels;
+    task.rects = rects;
+    task.stamp = stamp;
+    task.opaque = opaque;
+    _tasks.push_back(task);
+}
+
+void SDLWindow::perform_operations()
 {
     if (_tasks.empty()) {
-        draw();
-    } else {
-        auto task = _tasks.front();
-        switch (task.type) {
-        case TaskTypeCreate:
-            do_create(task);
-            break;
-        case TaskTypeUpdatePixels:
-            do_update_pixels(task);
-            break;
-        case TaskTypeResize:
-            do_resize(task);
-            break;
-        case TaskTypeMove:
-            do_move(task);
-        default:
-            break;
-        }
-        draw();
-        _tasks.pop();
+        return;
+    }
+    auto pixel_update = _tasks.front().type == TaskTypeUpdatePixels && !is_task_in_progress();
+    /* Deferred background windows catch up later, with what piled up merged into one upload. */
+    if (pixel_update && are_updates_deferred()) {
+        return;
+    }
+    if (pixel_update) {
+        coalesce_pixel_updates();
+    }
+    auto type = _tasks.front().type;
+    auto stamp = _tasks.front().stamp;
+    _task_frames++;
+    TraceSpan span("apply task");
+    if (type == TaskTypeUpdatePixels) {
+        span.add_flow(TraceFlowStep, get_update_flow_id(get_pid(), stamp.id));
+    }
+    auto start = get_monotonic_time_ns();
+    auto done = perform_task(_tasks.front());
+    add_upload_time(get_monotonic_time_ns() - start);
+    span.end();
+    if (!done) {
+        return;
     }
+    /* A translucent update leaves the window translucent until its whole buffer is replaced. */
+    if (type == TaskTypeUpdatePixels && !_tasks.front().opaque) {
+        set_opaque(false);
+    }
+    _tasks.pop_front();
+    if (type != TaskTypeMove) {
+        _uploader->get_budget().complete_update(_task_frames);
+        count_updates(1, 0);
+    }
+    if (type == TaskTypeUpdatePixels) {
+        complete_update(stamp);
+    }
+    _task_frames = 0;
+}
+
+size_t SDLWindow::get_pending_task_count() const
+{
+    return _tasks.size();
 }
 
-void SDLWindow::do_create(const Task& task)
+bool SDLWindow::perform_task(const Task& task)
 {
-    Uint32 pixel_format = SDL_PIXELFORMAT_ARGB8888;
-    if (get_raster_type() == WindowRasterRGBA) {
-        pixel_format = SDL_PIXELFORMAT_RGBA8888;
-    } else if (get_raster_type() == WindowRasterARGB) {
-        pixel_format = SDL_PIXELFORMAT_ARGB8888;
+    switch (task.type) {
+    case TaskTypeCreate:
+        return do_create(task);
+    case TaskTypeUpdatePixels:
+        return do_update_pixels(task);
+    case TaskTypeResize:
+        return do_resize(task);
+    case TaskTypeResizeBuffer:
+        return do_resize_buffer(task);
+    case TaskTypeMove:
+        do_move(task);
+        return true;
+    default:
+        return true;
     }
-    if (_texture != nullptr) {
-        SDL_DestroyTexture(_texture);
+}
+
+bool SDLWindow::do_create(const Task& task)
+{
+    if (!replace_texture(task.rect.size, task.pixels, task.opaque)) {
+        return false;
     }
-    _texture = SDL_CreateTexture(_renderer, pixel_format, SDL_TEXTUREACCESS_STREAMING, (int)task.rect.size.width, (int)task.rect.size.height);
-    SDL_SetTextureBlendMode(_texture, SDL_BLENDMODE_BLEND);
-    SDL_UpdateTexture(_texture, nullptr, task.pixels.get(), (int)(4 * task.rect.size.width));
     set_frame(task.rect);
+    return true;
 }
 
-void SDLWindow::do_resize(const Task& task)
+bool SDLWindow::do_resize(const Task& task)
 {
     Task new_task {};
     new_task.type = TaskTypeCreate;
     new_task.pixels = task.pixels;
     new_task.rect = make_rect(get_frame().location.x, get_frame().location.y, task.size.width, task.size.height);
-    this->do_create(new_task);
+    new_task.opaque = task.opaque;
+    return this->do_create(new_task);
 }
 
-void SDLWindow::do_update_pixels(const Task& task)
+bool SDLWindow::do_resize_buffer(const Task& task)
 {
-    SDL_Rect rect;
-    rect.x = (int)task.rect.location.x;
-    rect.y = (int)task.rect.location.y;
-    rect.w = (int)task.rect.size.width;
-    rect.h = (int)task.rect.size.height;
-    SDL_UpdateTexture(_texture, &rect, task.pixels.get(), 4 * rect.w);
+    /* The client rendered at a different scale, the frame stays the same and
+     * the texture gets stretched to it when drawing. */
+    return replace_texture(task.size, task.pixels, task.opaque);
+}
+
+Uint32 SDLWindow::get_pixel_format() const
+{
+    switch (get_raster_type()) {
+    case WindowRasterRGBA:
+        return SDL_PIXELFORMAT_RGBA8888;
+    case WindowRasterABGR:
+        return SDL_PIXELFORMAT_ABGR8888;
+    case WindowRasterBGRA:
+        return SDL_PIXELFORMAT_BGRA8888;
+    default:
+        return SDL_PIXELFORMAT_ARGB8888;
+    }
+}
+
+SDL_Texture* SDLWindow::make_texture(const Size& size, Uint32 pixel_format)
+{
+    auto texture = SDL_CreateTexture(_renderer, pixel_format, SDL_TEXTUREACCESS_STREAMING, (int)size.width, (int)size.height);
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
+    return texture;
+}
+
+void SDLWindow::create_texture(const Size& size, const unsigned char* pixels)
+{
+    _pixel_format = get_pixel_format();
+    if (_texture != nullptr) {
+        SDL_DestroyTexture(_texture);
+    }
+    drop_evicted_pixels();
+    _texture = make_texture(size, _pixel_format);
+    SDL_UpdateTexture(_texture, nullptr, pixels, (int)(4 * size.width));
+    set_buffer_size(size);
+}
+
+bool SDLWindow::replace_texture(const Size& size, const std::shared_ptr<unsigned char[]>& pixels, bool opaque)
+{
+    auto pixel_format = get_pixel_format();
+    if (size.width * size.height == 0) {
+        create_texture(size, pixels.get());
+        set_opaque(false);
+        return true;
+    }
+    auto async = _uploader->is_async(pixel_format);
+    if (_upload_texture == nullptr) {
+        if (async) {
+            _upload = _uploader->begin_upload(pixels, (size_t)(4 * size.width * size.height), get_update_priority() == UpdatePriorityForeground);
+            if (_upload == nullptr) {
+                return false;
+            }
+        }
+        _upload_texture = make_texture(size, pixel_format);
+    }
+    std::vector<Rect> rects = { make_rect(0, 0, size.width, size.height) };
+    if (async) {
+        if (!_uploader->finish_upload(_upload, _upload_texture, pixel_format, rects)) {
+            return false;
+        }
+        _upload = nullptr;
+        add_uploaded_bytes((uint64_t)(4 * size.width * size.height));
+    } else if (!upload_tiles(_upload_texture, pixels.get(), rects)) {
+        return false;
+    }
+    if (_texture != nullptr) {
+        SDL_DestroyTexture(_texture);
+    }
+    _texture = _upload_texture;
+    _upload_texture = nullptr;
+    _pixel_format = pixel_format;
+    set_opaque(opaque);
+    drop_evicted_pixels();
+    set_buffer_size(size);
+    return true;
+}
+
+void SDLWindow::coalesce_pixel_updates()
+{
+    size_t count = 0;
+    while (count < _tasks.size() && _tasks[count].type == TaskTypeUpdatePixels) {
+        count++;
+    }
+    if (count < 2) {
+        return;
+    }
+    typedef struct
+    {
+        const unsigned char* pixels;
+        Rect rect;
+    } Piece;
+    std::vector<Piece> pieces;
+    for (size_t i = 0; i < count; i++) {
+        auto pixels = _tasks[i].pixels.get();
+        for (auto& r : _tasks[i].rects) {
+            pieces.push_back({ pixels, r });
+            pixels += (size_t)(4 * r.size.width * r.size.height);
+        }
+    }
+    /* Rects a later update covers are left out, a video frame replaces the one before it. */
+    std::vector<Piece> kept;
+    size_t size = 0;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        bool covered = false;
+        for (size_t j = i + 1; j < pieces.size() && pieces.size() <= COALESCE_COVER_CHECK_MAX; j++) {
+            if (rect_contains(pieces[j].rect, pieces[i].rect)) {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered) {
+            kept.push_back(pieces[i]);
+            size += (size_t)(4 * pieces[i].rect.size.width * pieces[i].rect.size.height);
+        }
+    }
+    Task task {};
+    auto& last = _tasks[count - 1];
+    auto opaque = true;
+    for (size_t i = 0; i < count; i++) {
+        opaque &= _tasks[i].opaque;
+    }
+    if (!kept.empty() && kept.size() == last.rects.size() && kept.front().pixels == last.pixels.get()) {
+        task = last;
+    } else {
+        task.type = TaskTypeUpdatePixels;
+        task.stamp = last.stamp;
+        task.pixels = std::shared_ptr<unsigned char[]>(new unsigned char[size]);
+        auto destination = task.pixels.get();
+        for (auto& piece : kept) {
+            auto bytes = (size_t)(4 * piece.rect.size.width * piece.rect.size.height);
+            std::memcpy(destination, piece.pixels, bytes);
+            destination += bytes;
+            task.rects.push_back(piece.rect);
+        }
+    }
+    task.opaque = opaque;
+    _tasks.erase(_tasks.begin(), _tasks.begin() + (long)count);
+    _tasks.push_front(task);
+    count_updates(0, count - 1);
+}
+
+bool SDLWindow::do_update_pixels(const Task& task)
+{
+    if (_texture == nullptr && !_evicted_pixels.empty()) {
+        update_evicted_pixels(task);
+        return true;
+    }
+    if (_texture != nullptr && _uploader->is_async(_pixel_format)) {
+        return upload_pixels(task);
+    }
+    return upload_tiles(_texture, task.pixels.get(), task.rects);
+}
+
+bool SDLWindow::upload_tiles(SDL_Texture* texture, const unsigned char* pixels, const std::vector<Rect>& rects)
+{
+    auto& budget = _uploader->get_budget();
+    /* Rows of a rect are contiguous, a tile is a band of rows spanning the rect. */
+    while (_tile_rect < rects.size()) {
+        if (!budget.has_time()) {
+            budget.defer();
+            return false;
+        }
+        auto& r = rects[_tile_rect];
+        auto width = (int)r.size.width;
+        auto height = (int)r.size.height;
+        auto tile_rows = (int)std::max((size_t)1, TILE_BYTES / (size_t)(4 * std::max(width, 1)));
+        SDL_Rect rect;
+        rect.x = (int)r.location.x;
+        rect.y = (int)r.location.y + _tile_row;
+        rect.w = width;
+        rect.h = std::min(height - _tile_row, tile_rows);
+        auto start = get_monotonic_time_ns();
+        if (rect.w > 0 && rect.h > 0) {
+            SDL_UpdateTexture(texture, &rect, pixels + _tile_offset, 4 * rect.w);
+        }
+        budget.charge(get_monotonic_time_ns() - start);
+        auto bytes = (size_t)(4 * std::max(rect.w, 0) * std::max(rect.h, 0));
+        _tile_offset += bytes;
+        add_uploaded_bytes((uint64_t)bytes);
+        _tile_row += std::max(rect.h, 0);
+        if (_tile_row >= height) {
+            _tile_rect++;
+            _tile_row = 0;
+        }
+    }
+    _tile_rect = 0;
+    _tile_row = 0;
+    _tile_offset = 0;
+    return true;
+}
+
+bool SDLWindow::is_task_in_progress() const
+{
+    return _upload != nullptr || _upload_texture != nullptr || _tile_rect != 0 || _tile_row != 0;
+}
+
+bool SDLWindow::upload_pixels(const Task& task)
+{
+    if (_upload == nullptr) {
+        auto size = get_rects_bytes(task.rects);
+        if (size == 0) {
+            return true;
+        }
+        _upload = _uploader->begin_upload(task.pixels, size, get_update_priority() == UpdatePriorityForeground);
+        if (_upload == nullptr) {
+            return false;
+        }
+    }
+    if (!_uploader->finish_upload(_upload, _texture, _pixel_format, task.rects)) {
+        return false;
+    }
+    add_uploaded_bytes((uint64_t)_upload->size);
+    _upload = nullptr;
+    return true;
 }
 
 void SDLWindow::do_move(const Task& task)
@@ -113,8 +454,113 @@ void SDLWindow::do_move(const Task& task)
     set_location(task.point);
 }
 
+void SDLWindow::update_evicted_pixels(const Task& task)
+{
+    _evicted_updates.push_back(task);
+    _evicted_update_bytes += get_rects_bytes(task.rects);
+    /* Folded into the compressed copy only once they'd take more memory than the texture itself. */
+    auto buffer_size = get_buffer_size();
+    if (_evicted_update_bytes >= (size_t)(4 * buffer_size.width * buffer_size.height)) {
+        auto pixels = decompress_evicted_pixels();
+        _evicted_pixels = compress_pixels(pixels.data(), pixels.size());
+    }
+}
+
+std::vector<unsigned char> SDLWindow::decompress_evicted_pixels()
+{
+    auto buffer_size = get_buffer_size();
+    auto pixels = decompress_pixels(_evicted_pixels, (size_t)(4 * buffer_size.width * buffer_size.height));
+    for (auto& task : _evicted_updates) {
+        copy_rects(pixels.data(), buffer_size, task.pixels.get(), task.rects);
+    }
+    _evicted_updates.clear();
+    _evicted_update_bytes = 0;
+    return pixels;
+}
+
+void SDLWindow::drop_evicted_pixels()
+{
+    _evicted_pixels.clear();
+    _evicted_pixels.shrink_to_fit();
+    _evicted_updates.clear();
+    _evicted_update_bytes = 0;
+}
+
+bool SDLWindow::is_texture_resident() const
+{
+    return _texture != nullptr;
+}
+
+uint64_t SDLWindow::get_texture_bytes() const
+{
+    if (_texture == nullptr) {
+        return 0;
+    }
+    return (uint64_t)(4 * get_buffer_size().width * get_buffer_size().height);
+}
+
+uint64_t SDLWindow::get_evicted_bytes() const
+{
+    return _evicted_pixels.size() + _evicted_update_bytes;
+}
+
+void SDLWindow::evict_texture()
+{
+    /* An upload in flight still needs the texture. */
+    if (_texture == nullptr || is_task_in_progress()) {
+        return;
+    }
+    auto pixels = read_texture_pixels();
+    if (pixels.empty()) {
+        return;
+    }
+    _evicted_pixels = compress_pixels(pixels.data(), pixels.size());
+    SDL_DestroyTexture(_texture);
+    _texture = nullptr;
+    increment_eviction_count();
+}
+
+void SDLWindow::restore_texture()
+{
+    if (_texture != nullptr || _evicted_pixels.empty()) {
+        return;
+    }
+    auto pixels = decompress_evicted_pixels();
+    create_texture(get_buffer_size(), pixels.data());
+    /* Not client pixels, kept out of the uploaded bytes the render scale and the profiler go by. */
+    add_restored_bytes((uint64_t)pixels.size());
+}
+
+std::vector<unsigned char> SDLWindow::read_texture_pixels()
+{
+    /* Streaming textures can't be read back, render into a target texture
+     * and read that instead. */
+    auto width = (int)get_buffer_size().width;
+    auto height = (int)get_buffer_size().height;
+    auto target = SDL_CreateTexture(_renderer, _pixel_format, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (target == nullptr) {
+        return {};
+    }
+    std::vector<unsigned char> pixels((size_t)(4 * width * height));
+    SDL_SetTextureBlendMode(_texture, SDL_BLENDMODE_NONE);
+    SDL_SetRenderTarget(_renderer, target);
+    SDL_RenderCopy(_renderer, _texture, nullptr, nullptr);
+    auto result = SDL_RenderReadPixels(_renderer, nullptr, _pixel_format, pixels.data(), 4 * width);
+    SDL_SetRenderTarget(_renderer, nullptr);
+    SDL_SetTextureBlendMode(_texture, SDL_BLENDMODE_BLEND);
+    SDL_DestroyTexture(target);
+    if (result != 0) {
+        return {};
+    }
+    return pixels;
+}
+
 void SDLWindow::draw()
 {
+    if (!is_visible() || is_occluded()) {
+        return;
+    }
+    restore_texture();
     SDL_Rect rect;
     rect.x = (int)get_frame().location.x;
     rect.y = (int)get_frame().location.y;
@@ -125,6 +571,12 @@ void SDLWindow::draw()
 
 SDLWindow::~SDLWindow()
 {
+    if (_upload != nullptr) {
+        _uploader->cancel_upload(_upload);
+    }
+    if (_upload_texture != nullptr) {
+        SDL_DestroyTexture(_upload_texture);
+    }
     if (_texture != nullptr) {
         SDL_DestroyTexture(_texture);
     }
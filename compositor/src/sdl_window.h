@@ -2,17 +2,20 @@
 #define REVYV_SDLWINDOW_H
 
 #include "geometry.h"
+#include "texture_uploader.h"
 #include "window.h"
 #include <SDL2/SDL.h>
 #include <compositor/types.h>
+#include <deque>
 #include <memory>
-#include <queue>
+#include <vector>
 
 namespace revyv {
 enum TaskType {
     TaskTypeCreate,
     TaskTypeUpdatePixels,
     TaskTypeResize,
+    TaskTypeResizeBuffer,
     TaskTypeMove,
 };
 
@@ -22,39 +25,109 @@ struct Task {
     Point point;
     Size size;
     Rect rect;
+    std::vector<Rect> rects;
+    UpdateStamp stamp;
+    /* Every pixel fully opaque, scanned before the task was queued. */
+    bool opaque;
 };
 
 class SDLWindow : public Window {
 public:
-    SDLWindow(pid_t pid, uint32_t id, WindowRasterType raster_type, SDL_Renderer* renderer);
+    SDLWindow(pid_t pid, uint32_t id, WindowRasterType raster_type, SDL_Renderer* renderer, TextureUploader* uploader);
 
     virtual ~SDLWindow();
 
-    void perform_operations_and_draw() override;
+    void perform_operations() override;
+
+    void draw() override;
+
+    [[nodiscard]] size_t get_pending_task_count() const override;
 
     void move(Point point) override;
 
-    void create(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect) override;
+    void create(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect, bool opaque) override;
+
+    void resize(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque) override;
+
+    void resize_buffer(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque) override;
+
+    void update_pixels(std::shared_ptr<unsigned char[]> pixel, size_t bytes, const Rect& rect, const UpdateStamp& stamp, bool opaque) override;
+
+    void update_rects(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const std::vector<Rect>& rects, const UpdateStamp& stamp, bool opaque) override;
 
-    void resize(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size) override;
+    [[nodiscard]] bool is_texture_resident() const override;
 
-    void update_pixels(std::shared_ptr<unsigned char[]> pixel, size_t bytes, const Rect& rect) override;
+    [[nodiscard]] uint64_t get_texture_bytes() const override;
+
+    [[nodiscard]] uint64_t get_evicted_bytes() const override;
+
+    void evict_texture() override;
 
 private:
-    void draw();
+    void restore_texture();
+
+    [[nodiscard]] std::vector<unsigned char> read_texture_pixels();
+
+    /* Queues the update until the texture is restored. */
+    void update_evicted_pixels(const Task& task);
+
+    /* The compressed copy with the queued updates applied, which are then dropped. */
+    [[nodiscard]] std::vector<unsigned char> decompress_evicted_pixels();
+
+    void drop_evicted_pixels();
+
+    /* Returns false while the task waits for its upload, it is retried on the next frame. */
+    bool perform_task(const Task& task);
+
+    bool do_create(const Task& task);
+
+    bool do_resize(const Task& task);
+
+    bool do_resize_buffer(const Task& task);
+
+    [[nodiscard]] Uint32 get_pixel_format() const;
+
+    [[nodiscard]] SDL_Texture* make_texture(const Size& size, Uint32 pixel_format);
+
+    void create_texture(const Size& size, const unsigned char* pixels);
+
+    /* Uploads into a new texture while the current one stays on screen, then swaps them. */
+    bool replace_texture(const Size& size, const std::shared_ptr<unsigned char[]>& pixels, bool opaque);
+
+    /* Merges the pixel updates at the front of the queue into one. */
+    void coalesce_pixel_updates();
+
+    bool do_update_pixels(const Task& task);
 
-    void do_create(const Task& task);
+    /* Uploads the next tiles of the packed rects, returns true once all of them are uploaded. */
+    bool upload_tiles(SDL_Texture* texture, const unsigned char* pixels, const std::vector<Rect>& rects);
 
-    void do_resize(const Task& task);
+    /* Whether the front task was started on an earlier frame and is not done yet. */
+    [[nodiscard]] bool is_task_in_progress() const;
 
-    void do_update_pixels(const Task& task);
+    bool upload_pixels(const Task& task);
 
     void do_move(const Task& task);
 
 private:
     SDL_Texture* _texture;
     SDL_Renderer* _renderer;
-    std::queue<Task> _tasks;
+    TextureUploader* _uploader;
+    /* Upload in flight, into _upload_texture when the texture is being replaced. */
+    std::shared_ptr<TextureUpload> _upload = nullptr;
+    SDL_Texture* _upload_texture = nullptr;
+    /* How far the tiles of the front task got: the rect, the row in it, the bytes before it. */
+    size_t _tile_rect = 0;
+    int _tile_row = 0;
+    size_t _tile_offset = 0;
+    /* Frames the front task has been worked on. */
+    uint32_t _task_frames = 0;
+    Uint32 _pixel_format = SDL_PIXELFORMAT_ARGB8888;
+    std::deque<Task> _tasks;
+    /* LZO compressed copy of the texture while it is evicted, and the updates it hasn't taken yet. */
+    std::vector<unsigned char> _evicted_pixels;
+    std::vector<Task> _evicted_updates;
+    size_t _evicted_update_bytes = 0;
 };
 }
 
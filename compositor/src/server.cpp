@@ -1,12 +1,36 @@
 #include "server.h"
 #include "error.h"
+#include "flight_recorder.h"
+#include "recording_event_source.h"
+#include "replay_event_source.h"
 #include "sdl_compositor.h"
 #include "sdl_event_source.h"
+#include <algorithm>
+#include <atomic>
+#include <compositor/trace.h>
 #include <csignal>
+#include <sstream>
 #include <lzo/lzo1x.h>
 
 using namespace revyv;
 
+/* Frames the statistics cover, a few seconds at 60 Hz. */
+static const size_t PROFILE_FRAME_COUNT = 300;
+
+/* Gauges that take a walk over the windows are refreshed this often, scrapes are seconds apart. */
+static const uint64_t METRICS_GAUGE_INTERVAL = 1000000000;
+
+/* A frame starting this many refresh intervals after the previous one missed at least one. */
+static const double MISSED_FRAME_INTERVALS = 1.5;
+
+/* Set by SIGUSR1, the render thread dumps the flight recorder at the end of its frame. */
+static std::atomic<bool> flight_dump_requested = false;
+
+static void request_flight_dump(int)
+{
+    flight_dump_requested = true;
+}
+
 Server* Server::_shared_instance = nullptr;
 
 Server::Server()
@@ -31,8 +55,18 @@ void Server::request_listener(Server* server)
             }
             if (p.type == RequestTypeClientRegister) {
                 auto pid = RegisterClientPayload(p).get_pid();
-                server->_publishers[pid] = std::make_shared<Publisher>(pid);
-                server->_listeners[pid] = std::make_shared<Listener>(pid);
+                auto publisher = std::make_shared<Publisher>(pid);
+                auto info = make_event(EventTypeCompositorInfo);
+                info.info.native_raster_type = server->_compositor->get_native_raster_type();
+                publisher->send_event(info);
+                auto listener = std::make_shared<Listener>(pid);
+                listener->start();
+                {
+                    std::lock_guard<std::mutex> lock(server->_clients_mutex);
+                    server->_publishers[pid] = publisher;
+                    server->_listeners[pid] = listener;
+                }
+                server->_window_manager->invalidate_routes();
                 server->add_pid(pid);
             }
         } catch (std::exception& e) {
@@ -43,96 +77,329 @@ void Server::request_listener(Server* server)
 
 void Server::process_monitor_thread(Server* server)
 {
+    std::vector<pid_t> pids;
     while (true) {
-        wait(5);
-        for (auto pid : server->_pids) {
-            if (kill(pid, 0) == -1) {
-                server->_listeners[pid]->shutdown();
-                uint8_t remaining_tries = 100;
-                while (server->_listeners[pid]->is_running()) {
-                    if (remaining_tries == 0) {
-                        break;
-                    }
-                    wait(5);
-                    remaining_tries--;
-                }
-                server->remove_pid(pid);
-                server->remove_publisher(pid);
-                server->remove_listener(pid);
-                std::cout << "Unregistered PID " << pid << std::endl;
-            }
+        pids.clear();
+        server->_process_monitor.wait_for_exits(pids, -1);
+        for (auto pid : pids) {
+            server->remove_client(pid);
         }
     }
 }
 
-void Server::run(const Size& size)
+void Server::run(const ServerOptions& options)
 {
     if (lzo_init() != LZO_E_OK) {
         throw std::runtime_error("lzo_init() failed");
     }
+    _work_pool = std::make_shared<WorkPool>(options.worker_count);
+    std::cout << "Decoding window updates on " << _work_pool->get_thread_count() << " threads" << std::endl;
+    _compositor = std::make_shared<SDLCompositor>(options.screen_size, options.texture_budget, options.upload_budget, _work_pool, options.headless);
+    if (options.background_update_rate > 0) {
+        _compositor->set_background_update_interval((uint64_t)(1e9 / options.background_update_rate));
+    }
+    _window_manager = std::make_shared<WindowManager>(_compositor, [this](pid_t pid) { return get_publisher(pid); });
     new std::thread(Server::request_listener, this);
     new std::thread(Server::process_monitor_thread, this);
-    _compositor = std::make_shared<SDLCompositor>(size);
+    new std::thread(Server::control_thread, this);
     _input_source = std::make_shared<SDLEventSource>();
-    _window_manager = std::make_shared<WindowManager>();
+    if (!options.replay_path.empty()) {
+        _input_source = std::make_shared<ReplayEventSource>(options.replay_path, options.replay_speed, _input_source);
+    }
+    if (!options.record_path.empty()) {
+        _input_source = std::make_shared<RecordingEventSource>(_input_source, options.record_path);
+    }
+    _render_scale_controller = std::make_shared<RenderScaleController>(options.frame_budget);
+    auto latency_log_interval = (uint64_t)(options.latency_log_interval * 1e9);
+    auto latency_logged_at = get_monotonic_time_ns();
+    auto profile_log_interval = (uint64_t)(options.profile_log_interval * 1e9);
+    auto profile_logged_at = get_monotonic_time_ns();
+    auto& profiler = _compositor->get_profiler();
+    auto frame_interval = options.headless && options.refresh_rate > 0 ? (uint64_t)(1e9 / options.refresh_rate) : 0;
+    auto next_frame_at = get_monotonic_time_ns();
+    if (options.flight_recorder_window > 0) {
+        _flight_recorder = std::make_shared<FlightRecorder>(options.flight_recorder_directory, (uint64_t)(options.flight_recorder_window * 1e9));
+        Tracer::get().set_sink(_flight_recorder.get());
+        std::signal(SIGUSR1, request_flight_dump);
+    }
+    auto jank_threshold = (uint64_t)(options.jank_threshold * 1e6);
+    uint64_t flight_dumped_at = 0;
+    if (options.metrics_port != 0) {
+        _metrics_server = std::make_shared<MetricsServer>(options.metrics_port, [this]() { return get_metrics(); });
+        _metrics_server->start();
+    }
+    auto missed_frame_interval = (uint64_t)(MISSED_FRAME_INTERVALS * 1e9 / (options.refresh_rate > 0 ? options.refresh_rate : 60));
+    uint64_t previous_frame_start = 0;
+    uint64_t gauges_updated_at = 0;
     while (true) {
         try {
+            profiler.begin_frame();
+            auto frame_start = get_monotonic_time_ns();
+            if (previous_frame_start != 0 && frame_start - previous_frame_start > missed_frame_interval) {
+                _frames_missed.fetch_add(1, std::memory_order_relaxed);
+            }
+            previous_frame_start = frame_start;
+            TraceSpan frame_span("frame");
+            auto stage_start = frame_start;
+            TraceSpan commands_span("commands");
+            _compositor->run_commands();
+            commands_span.end();
+            profiler.record_stage(FrameStageCommands, get_monotonic_time_ns() - stage_start);
             _compositor->compose();
-            auto event = _input_source->poll_event();
-            if (event == nullptr) {
-                continue;
+            _frames_composited.fetch_add(1, std::memory_order_relaxed);
+            acknowledge_updates();
+            _render_scale_controller->frame_completed(_compositor);
+            /* Drain everything that arrived during the frame, mouse moves are coalesced per client. */
+            stage_start = get_monotonic_time_ns();
+            TraceSpan input_span("input");
+            bool quit = false;
+            Event event {};
+            while (_input_source->poll_event(event)) {
+                if (event.type == EventTypeQuit) {
+                    quit = true;
+                    break;
+                }
+                _window_manager->send_event(event);
             }
-            auto eventType = event->get_type();
-            if (eventType == EventTypeQuit) {
+            _window_manager->flush_mouse_move_events();
+            input_span.end();
+            profiler.record_stage(FrameStageInput, get_monotonic_time_ns() - stage_start);
+            profiler.end_frame();
+            frame_span.end();
+            if (quit) {
                 break;
+            }
+            if (latency_log_interval != 0 && get_monotonic_time_ns() - latency_logged_at >= latency_log_interval) {
+                log_input_latency();
+                log_upload_statistics();
+                latency_logged_at = get_monotonic_time_ns();
+            }
+            if (profile_log_interval != 0 && get_monotonic_time_ns() - profile_logged_at >= profile_log_interval) {
+                write_profile_summary(std::cout, profiler, PROFILE_FRAME_COUNT);
+                profile_logged_at = get_monotonic_time_ns();
+            }
+            if (_metrics_server != nullptr && frame_start - gauges_updated_at >= METRICS_GAUGE_INTERVAL) {
+                update_metrics_gauges();
+                gauges_updated_at = frame_start;
+            }
+            if (_flight_recorder != nullptr) {
+                auto now = get_monotonic_time_ns();
+                auto frame_time = now - frame_start;
+                if (flight_dump_requested.exchange(false)) {
+                    _flight_recorder->dump("signal");
+                    flight_dumped_at = now;
+                } else if (jank_threshold != 0 && frame_time > jank_threshold && now - flight_dumped_at >= _flight_recorder->get_window()) {
+                    /* One dump per window, a run of slow frames is in the first one already. */
+                    std::ostringstream reason;
+                    reason << "frame of " << (double)frame_time / 1e6 << " ms";
+                    if (_flight_recorder->dump(reason.str())) {
+                        flight_dumped_at = now;
+                    }
+                }
+            }
+            if (frame_interval != 0) {
+                /* A late frame starts the next one right away rather than hurrying the ones after it. */
+                auto now = get_monotonic_time_ns();
+                next_frame_at = std::max(next_frame_at + frame_interval, now);
+                std::this_thread::sleep_for(std::chrono::nanoseconds(next_frame_at - now));
+            }
+        } catch (std::exception& e) {
+            std::cout << __func__ << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+void Server::control_thread(Server* server)
+{
+    zmq::socket_t socket(*server->_context, ZMQ_REP);
+    std::string url("ipc:///tmp/revyv-control");
+    socket.bind(url);
+    std::cout << "Serving statistics on " << url << std::endl;
+    for (;;) {
+        try {
+            zmq::message_t request;
+            if (!socket.recv(request, zmq::recv_flags::none).has_value()) {
+                continue;
+            }
+            auto command = std::string((const char*)request.data(), request.size());
+            std::ostringstream reply;
+            auto& profiler = server->_compositor->get_profiler();
+            if (command == "frames") {
+                write_frames_json(reply, profiler, PROFILE_FRAME_COUNT);
+            } else if (command == "stats") {
+                write_profile_json(reply, profiler, PROFILE_FRAME_COUNT);
+            } else if (command == "metrics") {
+                write_metrics(reply, server->get_metrics());
             } else {
-                _window_manager->send_event(event);
+                reply << "{\"error\":\"unknown command, expected stats, frames or metrics\"}";
             }
-            wait(1);
+            auto text = reply.str();
+            socket.send(zmq::const_buffer(text.data(), text.size()), zmq::send_flags::none);
         } catch (std::exception& e) {
             std::cout << __func__ << ": " << e.what() << std::endl;
         }
     }
 }
 
+void Server::acknowledge_updates()
+{
+    TraceSpan span("acknowledge updates");
+    auto presented = get_monotonic_time_ns();
+    auto& tracer = Tracer::get();
+    _compositor->for_each_window([this, presented, &tracer](const std::shared_ptr<Window>& window) {
+        auto updates = window->take_completed_updates();
+        if (updates.empty()) {
+            return;
+        }
+        /* Updates are only completed without an acknowledgement to end their flow. */
+        if (tracer.is_enabled()) {
+            for (auto& update : updates) {
+                tracer.write_flow(TraceFlowEnd, get_update_flow_id(window->get_pid(), update.id), presented);
+            }
+        }
+        auto publisher = get_publisher(window->get_pid()).lock();
+        if (publisher == nullptr) {
+            return;
+        }
+        for (auto& update : updates) {
+            if (!update.acknowledge) {
+                continue;
+            }
+            auto event = make_event(EventTypeFramePresented);
+            event.window_id = window->get_id();
+            event.frame.update = update;
+            event.frame.presented = presented;
+            publisher->send_event(event);
+        }
+    });
+}
+
+void Server::log_input_latency()
+{
+    auto route = _window_manager->get_route_latency();
+    if (route.count == 0) {
+        return;
+    }
+    std::cout << "Input latency: ";
+    write_latency_summary(std::cout, "route", route);
+    std::cout << ", ";
+    write_latency_summary(std::cout, "dispatch", _window_manager->get_dispatch_latency());
+    std::cout << std::endl;
+    _window_manager->reset_latency();
+}
+
 void Server::add_pid(pid_t pid)
 {
-    _pids.push_back(pid);
+    if (!_process_monitor.watch(pid)) {
+        remove_client(pid);
+    }
 }
 
 void Server::remove_pid(pid_t pid)
 {
-    _compositor->remove_windows_by_pid(pid);
-    _pids.erase(
-        std::remove_if(
-            _pids.begin(),
-            _pids.end(),
-            [&pid](auto value) { return value == pid; }),
-        _pids.end());
+    /* Runs before the next frame is composed, so the windows are gone from it. */
+    _compositor->post_command([pid](Compositor& compositor) { compositor.remove_windows_by_pid(pid); });
+}
+
+void Server::remove_client(pid_t pid)
+{
+    remove_pid(pid);
+    remove_publisher(pid);
+    remove_listener(pid);
+    std::cout << "Unregistered PID " << pid << std::endl;
 }
 
 void Server::remove_publisher(pid_t pid)
 {
-    _publishers.erase(_publishers.find(pid));
+    {
+        std::lock_guard<std::mutex> lock(_clients_mutex);
+        auto it = _publishers.find(pid);
+        if (it != _publishers.end()) {
+            _departed_send_failures.fetch_add(it->second->get_send_failure_count(), std::memory_order_relaxed);
+            _publishers.erase(it);
+        }
+    }
+    _window_manager->invalidate_routes();
 }
 
 void Server::remove_listener(pid_t pid)
 {
-    _listeners.erase(_listeners.find(pid));
+    std::shared_ptr<Listener> listener;
+    {
+        std::lock_guard<std::mutex> lock(_clients_mutex);
+        auto it = _listeners.find(pid);
+        if (it == _listeners.end()) {
+            return;
+        }
+        listener = it->second;
+        _listeners.erase(it);
+    }
+    /* The listener thread keeps the listener alive until its receive times out. */
+    listener->shutdown();
+}
+
+void Server::update_metrics_gauges()
+{
+    auto sdl_compositor = std::dynamic_pointer_cast<SDLCompositor>(_compositor);
+    auto statistics = sdl_compositor->get_texture_statistics();
+    _window_count.store(statistics.windows.size(), std::memory_order_relaxed);
+    _texture_resident_bytes.store(statistics.resident_bytes, std::memory_order_relaxed);
+}
+
+MetricsSnapshot Server::get_metrics()
+{
+    MetricsSnapshot metrics {};
+    metrics.windows = _window_count.load(std::memory_order_relaxed);
+    metrics.texture_resident_bytes = _texture_resident_bytes.load(std::memory_order_relaxed);
+    metrics.frames_composited = _frames_composited.load(std::memory_order_relaxed);
+    metrics.frames_missed = _frames_missed.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(_clients_mutex);
+    metrics.event_send_failures = _departed_send_failures.load(std::memory_order_relaxed);
+    for (auto& [pid, listener] : _listeners) {
+        auto& counters = listener->get_counters();
+        ClientMetrics client {};
+        client.pid = pid;
+        client.received_bytes = counters.received_bytes.load(std::memory_order_relaxed);
+        client.update_received_bytes = counters.update_received_bytes.load(std::memory_order_relaxed);
+        client.update_bytes = counters.update_bytes.load(std::memory_order_relaxed);
+        client.decode_time = counters.decode_time.load(std::memory_order_relaxed);
+        auto publisher = _publishers.find(pid);
+        if (publisher != _publishers.end()) {
+            client.event_send_failures = publisher->second->get_send_failure_count();
+            metrics.event_send_failures += client.event_send_failures;
+        }
+        metrics.clients.push_back(client);
+    }
+    return metrics;
+}
+
+void Server::log_upload_statistics()
+{
+    auto sdl_compositor = std::dynamic_pointer_cast<SDLCompositor>(_compositor);
+    auto statistics = sdl_compositor->get_upload_statistics();
+    if (statistics.updates == 0) {
+        return;
+    }
+    std::cout << "Uploads: " << statistics.updates << " updates, " << statistics.tiled_updates << " tiled, "
+              << statistics.catch_up_frames << " frames catching up, at most " << statistics.max_update_frames
+              << " frames per update" << std::endl;
+    sdl_compositor->reset_upload_statistics();
 }
 
 std::shared_ptr<Compositor> Server::get_compositor() const { return _compositor; }
 
 std::shared_ptr<WindowManager> Server::get_window_manager() const { return _window_manager; }
 
-std::weak_ptr<Publisher> Server::get_publisher(pid_t pid) { return _publishers[pid]; }
+std::shared_ptr<WorkPool> Server::get_work_pool() const { return _work_pool; }
 
-void Server::wait(const long milliseconds)
+std::weak_ptr<Publisher> Server::get_publisher(pid_t pid)
 {
-    timespec spec {};
-    spec.tv_sec = 0;
-    spec.tv_nsec = milliseconds * 1000000; // 1 Millisecond = 1,000,000 Nanoseconds
-    nanosleep(&spec, nullptr);
+    std::lock_guard<std::mutex> lock(_clients_mutex);
+    auto it = _publishers.find(pid);
+    if (it == _publishers.end()) {
+        return {};
+    }
+    return it->second;
 }
 
 Server* Server::get_shared_instance()
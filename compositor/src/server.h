@@ -3,27 +3,70 @@
 
 #include "compositor.h"
 #include "event_source.h"
+#include "flight_recorder.h"
 #include "listener.h"
+#include "metrics.h"
+#include "process_monitor.h"
 #include "publisher.h"
+#include "render_scale_controller.h"
 #include "window_manager.h"
+#include "work_pool.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <vector>
 #include <zmq.hpp>
 
 namespace revyv {
 
+struct ServerOptions {
+    Size screen_size = make_size(1920, 1080);
+    double frame_budget = 16.6;
+    uint64_t texture_budget = 0;
+    /* Milliseconds per frame spent uploading pixels, 0 for no limit. */
+    double upload_budget = 4;
+    /* Seconds between input latency and upload log lines, 0 disables them. */
+    double latency_log_interval = 10;
+    /* Seconds between frame profile summaries in the log, 0 disables them. */
+    double profile_log_interval = 0;
+    /* Writes the input events to this file when set. */
+    std::string record_path;
+    /* Replays the input events of this recording when set, at replay_speed
+     * times the original pace or as fast as possible when 0. */
+    std::string replay_path;
+    double replay_speed = 1;
+    /* Threads decoding window updates, 0 means one per core. */
+    size_t worker_count = 0;
+    /* Pixel updates per second of the windows neither on top nor under the pointer, 0 for no limit. */
+    double background_update_rate = 15;
+    /* Renders without a display or GPU, frames are paced to refresh_rate as there is no vsync. */
+    bool headless = false;
+    double refresh_rate = 60;
+    /* Seconds of recent events the flight recorder keeps, 0 disables it. */
+    double flight_recorder_window = 2;
+    /* Frames slower than this many milliseconds dump the flight recorder, 0 leaves dumps to SIGUSR1. */
+    double jank_threshold = 50;
+    std::string flight_recorder_directory = "/tmp";
+    /* Serves Prometheus metrics over HTTP on this loopback port, 0 disables it. */
+    uint16_t metrics_port = 0;
+};
+
 class Server {
 public:
     static Server* get_shared_instance();
 
-    void run(const Size& size);
+    void run(const ServerOptions& options);
 
+    /* Tears the client down as soon as its process exits. */
     void add_pid(pid_t pid);
 
     void remove_pid(pid_t pid);
 
+    void remove_client(pid_t pid);
+
     void remove_publisher(pid_t pid);
 
     void remove_listener(pid_t pid);
@@ -34,22 +77,50 @@ public:
 
     [[nodiscard]] std::shared_ptr<WindowManager> get_window_manager() const;
 
+    [[nodiscard]] std::shared_ptr<WorkPool> get_work_pool() const;
+
 private:
     Server();
 
-    static void wait(long milliseconds);
-
     static void request_listener(Server* server);
 
     static void process_monitor_thread(Server* server);
 
+    /* Answers "stats" and "frames" requests with JSON on the control socket. */
+    static void control_thread(Server* server);
+
+    /* Tells the clients that asked which of their updates the frame just presented shows. */
+    void acknowledge_updates();
+
+    void log_input_latency();
+
+    void log_upload_statistics();
+
+    /* Refreshes the gauges only the render thread can read. */
+    void update_metrics_gauges();
+
+    [[nodiscard]] MetricsSnapshot get_metrics();
+
 private:
-    std::vector<pid_t> _pids;
+    ProcessMonitor _process_monitor;
+    /* Guards the listeners and publishers, clients come and go on other threads than the render thread. */
+    std::mutex _clients_mutex;
     std::unordered_map<pid_t, std::shared_ptr<Listener>> _listeners;
     std::unordered_map<pid_t, std::shared_ptr<Publisher>> _publishers;
     std::shared_ptr<EventSource> _input_source = nullptr;
     std::shared_ptr<Compositor> _compositor = nullptr;
+    std::shared_ptr<WorkPool> _work_pool = nullptr;
     std::shared_ptr<WindowManager> _window_manager = nullptr;
+    std::shared_ptr<RenderScaleController> _render_scale_controller = nullptr;
+    std::shared_ptr<FlightRecorder> _flight_recorder = nullptr;
+    std::shared_ptr<MetricsServer> _metrics_server = nullptr;
+    /* Written by the render thread and read by the metrics endpoint. */
+    std::atomic<uint64_t> _frames_composited = 0;
+    std::atomic<uint64_t> _frames_missed = 0;
+    std::atomic<uint64_t> _window_count = 0;
+    std::atomic<uint64_t> _texture_resident_bytes = 0;
+    /* Send failures of the clients that are gone, so the total never goes down. */
+    std::atomic<uint64_t> _departed_send_failures = 0;
     std::shared_ptr<std::thread> _message_dispatcher;
     std::shared_ptr<zmq::context_t> _context = nullptr;
     std::shared_ptr<zmq::socket_t> _socket = nullptr;
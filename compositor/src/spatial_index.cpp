@@ -0,0 +1,172 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace revyv;
+
+SpatialIndex::SpatialIndex(const Size& bounds, double cell_size)
+    : _cell_size(cell_size)
+    , _columns(std::max(1, (int)std::ceil(bounds.width / cell_size)))
+    , _rows(std::max(1, (int)std::ceil(bounds.height / cell_size)))
+{
+    _cells.resize((size_t)_columns * _rows);
+}
+
+void SpatialIndex::insert(Window* window)
+{
+    auto& entry = _entries[window->get_id()];
+    if (entry.window != nullptr) {
+        remove_from_cells(entry);
+    }
+    entry.window = window;
+    entry.frame = window->get_frame();
+    entry.z = ++_next_z;
+    add_to_cells(entry);
+    _generation++;
+}
+
+void SpatialIndex::remove(uint32_t id)
+{
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        return;
+    }
+    remove_from_cells(it->second);
+    _entries.erase(it);
+    _generation++;
+}
+
+void SpatialIndex::update(Window* window)
+{
+    auto it = _entries.find(window->get_id());
+    if (it == _entries.end()) {
+        return;
+    }
+    auto& entry = it->second;
+    remove_from_cells(entry);
+    entry.frame = window->get_frame();
+    add_to_cells(entry);
+    _generation++;
+}
+
+void SpatialIndex::raise(uint32_t id)
+{
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        return;
+    }
+    auto& entry = it->second;
+    entry.z = ++_next_z;
+    auto range = get_cell_range(entry.frame);
+    for (int y = range.top; y <= range.bottom; y++) {
+        for (int x = range.left; x <= range.right; x++) {
+            auto& cell = _cells[(size_t)y * _columns + x];
+            auto found = std::find_if(cell.begin(), cell.end(), [&entry](const CellEntry& e) { return e.window == entry.window; });
+            if (found != cell.end()) {
+                found->z = entry.z;
+                std::rotate(cell.begin(), found, found + 1);
+            }
+        }
+    }
+    _generation++;
+}
+
+Window* SpatialIndex::find_top_most(Point location) const
+{
+    auto& cell = _cells[(size_t)get_cell_y(location.y) * _columns + get_cell_x(location.x)];
+    for (auto& entry : cell) {
+        if (location.x >= entry.left && location.x <= entry.right
+            && location.y >= entry.top && location.y <= entry.bottom
+            && entry.window->is_visible()) {
+            return entry.window;
+        }
+    }
+    return nullptr;
+}
+
+bool SpatialIndex::is_uncovered(uint32_t id) const
+{
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        return false;
+    }
+    auto& entry = it->second;
+    auto& frame = entry.frame;
+    auto range = get_cell_range(frame);
+    for (int y = range.top; y <= range.bottom; y++) {
+        for (int x = range.left; x <= range.right; x++) {
+            for (auto& other : _cells[(size_t)y * _columns + x]) {
+                if (other.z <= entry.z) {
+                    break;
+                }
+                if (other.left <= frame.location.x + frame.size.width && frame.location.x <= other.right
+                    && other.top <= frame.location.y + frame.size.height && frame.location.y <= other.bottom
+                    && other.window->is_visible()) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+uint64_t SpatialIndex::get_generation() const
+{
+    return _generation;
+}
+
+SpatialIndex::CellRange SpatialIndex::get_cell_range(const Rect& frame) const
+{
+    CellRange range {};
+    range.left = get_cell_x(frame.location.x);
+    range.top = get_cell_y(frame.location.y);
+    range.right = get_cell_x(frame.location.x + frame.size.width);
+    range.bottom = get_cell_y(frame.location.y + frame.size.height);
+    return range;
+}
+
+int SpatialIndex::get_cell_x(double x) const
+{
+    return std::clamp((int)std::floor(x / _cell_size), 0, _columns - 1);
+}
+
+int SpatialIndex::get_cell_y(double y) const
+{
+    return std::clamp((int)std::floor(y / _cell_size), 0, _rows - 1);
+}
+
+void SpatialIndex::add_to_cells(const Entry& entry)
+{
+    CellEntry cell_entry {};
+    cell_entry.left = entry.frame.location.x;
+    cell_entry.top = entry.frame.location.y;
+    cell_entry.right = entry.frame.location.x + entry.frame.size.width;
+    cell_entry.bottom = entry.frame.location.y + entry.frame.size.height;
+    cell_entry.z = entry.z;
+    cell_entry.window = entry.window;
+
+    auto range = get_cell_range(entry.frame);
+    for (int y = range.top; y <= range.bottom; y++) {
+        for (int x = range.left; x <= range.right; x++) {
+            auto& cell = _cells[(size_t)y * _columns + x];
+            auto position = std::find_if(cell.begin(), cell.end(), [&entry](const CellEntry& e) { return e.z < entry.z; });
+            cell.insert(position, cell_entry);
+        }
+    }
+}
+
+void SpatialIndex::remove_from_cells(const Entry& entry)
+{
+    auto range = get_cell_range(entry.frame);
+    for (int y = range.top; y <= range.bottom; y++) {
+        for (int x = range.left; x <= range.right; x++) {
+            auto& cell = _cells[(size_t)y * _columns + x];
+            cell.erase(
+                std::remove_if(
+                    cell.begin(),
+                    cell.end(),
+                    [&entry](const CellEntry& e) { return e.window == entry.window; }),
+                cell.end());
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef REVYV_SPATIALINDEX_H
+#define REVYV_SPATIALINDEX_H
+
+#include "geometry.h"
+#include "window.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace revyv {
+
+/*
+ * Uniform grid over the screen that answers which window is top most at a
+ * point. Every window is listed in the cells its frame touches, frames
+ * reaching outside the screen are clamped to the border cells. Windows are
+ * updated one at a time when they move, resize or get restacked.
+ */
+class SpatialIndex {
+public:
+    SpatialIndex(const Size& bounds, double cell_size);
+
+    void insert(Window* window);
+
+    void remove(uint32_t id);
+
+    /* Called after the frame or the visibility of a window changed. */
+    void update(Window* window);
+
+    void raise(uint32_t id);
+
+    [[nodiscard]] Window* find_top_most(Point location) const;
+
+    /* Whether no visible window above overlaps the window. */
+    [[nodiscard]] bool is_uncovered(uint32_t id) const;
+
+    /* Changes whenever the result of find_top_most() may change. */
+    [[nodiscard]] uint64_t get_generation() const;
+
+private:
+    typedef struct
+    {
+        Window* window;
+        Rect frame;
+        uint64_t z;
+    } Entry;
+
+    /* Copy of the frame kept in the cell, so a lookup does not chase pointers. */
+    typedef struct
+    {
+        double left;
+        double top;
+        double right;
+        double bottom;
+        uint64_t z;
+        Window* window;
+    } CellEntry;
+
+    typedef struct
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    } CellRange;
+
+    [[nodiscard]] CellRange get_cell_range(const Rect& frame) const;
+
+    [[nodiscard]] int get_cell_x(double x) const;
+
+    [[nodiscard]] int get_cell_y(double y) const;
+
+    void add_to_cells(const Entry& entry);
+
+    void remove_from_cells(const Entry& entry);
+
+private:
+    double _cell_size;
+    int _columns;
+    int _rows;
+    /* Each cell is sorted top most first. */
+    std::vector<std::vector<CellEntry>> _cells;
+    std::unordered_map<uint32_t, Entry> _entries;
+    uint64_t _next_z = 0;
+    uint64_t _generation = 0;
+};
+
+}
+
+#endif
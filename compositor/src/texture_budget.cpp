@@ -0,0 +1,65 @@
+#include "texture_budget.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace revyv;
+
+TextureBudget::TextureBudget(uint64_t budget)
+    : _budget(budget)
+{
+}
+
+void TextureBudget::enforce(const std::vector<std::shared_ptr<Window>>& windows)
+{
+    if (_budget == 0) {
+        return;
+    }
+    uint64_t resident_bytes = 0;
+    std::vector<std::shared_ptr<Window>> candidates;
+    for (auto& window : windows) {
+        resident_bytes += window->get_texture_bytes();
+        if (window->is_texture_resident() && (!window->is_visible() || window->is_occluded())) {
+            candidates.push_back(window);
+        }
+    }
+    if (resident_bytes <= _budget) {
+        return;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](auto& a, auto& b) {
+        return a->get_last_drawn_frame() < b->get_last_drawn_frame();
+    });
+    for (auto& window : candidates) {
+        if (resident_bytes <= _budget) {
+            break;
+        }
+        auto bytes = window->get_texture_bytes();
+        window->evict_texture();
+        if (window->is_texture_resident()) {
+            continue;
+        }
+        resident_bytes -= bytes;
+        _evictions++;
+        std::cout << "Evicted texture of window " << window->get_id() << " (" << bytes << " bytes, "
+                  << window->get_evicted_bytes() << " bytes compressed, " << window->get_eviction_count()
+                  << " evictions)" << std::endl;
+    }
+}
+
+TextureStatistics TextureBudget::get_statistics(const std::vector<std::shared_ptr<Window>>& windows) const
+{
+    TextureStatistics statistics {};
+    statistics.budget = _budget;
+    statistics.evictions = _evictions;
+    for (auto& window : windows) {
+        WindowTextureStatistics window_statistics {};
+        window_statistics.window_id = window->get_id();
+        window_statistics.resident_bytes = window->get_texture_bytes();
+        window_statistics.evicted_bytes = window->get_evicted_bytes();
+        window_statistics.evictions = window->get_eviction_count();
+        window_statistics.restored_bytes = window->get_restored_bytes();
+        statistics.resident_bytes += window_statistics.resident_bytes;
+        statistics.restored_bytes += window_statistics.restored_bytes;
+        statistics.windows.push_back(window_statistics);
+    }
+    return statistics;
+}
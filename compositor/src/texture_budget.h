@@ -0,0 +1,49 @@
+#ifndef REVYV_TEXTUREBUDGET_H
+#define REVYV_TEXTUREBUDGET_H
+
+#include "window.h"
+#include <memory>
+#include <vector>
+
+namespace revyv {
+
+typedef struct
+{
+    uint32_t window_id;
+    uint64_t resident_bytes;
+    uint64_t evicted_bytes;
+    uint32_t evictions;
+    uint64_t restored_bytes;
+} WindowTextureStatistics;
+
+typedef struct
+{
+    uint64_t budget;
+    uint64_t resident_bytes;
+    uint64_t evictions;
+    uint64_t restored_bytes;
+    std::vector<WindowTextureStatistics> windows;
+} TextureStatistics;
+
+/*
+ * Keeps the textures of all windows under a global memory budget. When the
+ * budget is exceeded, windows that are not going to be drawn (hidden or fully
+ * covered) are evicted, least recently drawn first. Evicted windows
+ * keep a compressed copy of their pixels and upload it again when drawn.
+ */
+class TextureBudget {
+public:
+    explicit TextureBudget(uint64_t budget);
+
+    void enforce(const std::vector<std::shared_ptr<Window>>& windows);
+
+    [[nodiscard]] TextureStatistics get_statistics(const std::vector<std::shared_ptr<Window>>& windows) const;
+
+private:
+    uint64_t _budget;
+    uint64_t _evictions = 0;
+};
+
+}
+
+#endif
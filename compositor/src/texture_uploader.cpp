@@ -0,0 +1,205 @@
+#include "texture_uploader.h"
+#include <compositor/latency_histogram.h>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using namespace revyv;
+
+TextureUploader::TextureUploader(SDL_Renderer* renderer, const std::shared_ptr<WorkPool>& work_pool, double upload_budget)
+    : _renderer(renderer)
+    , _work_pool(work_pool)
+    , _budget(upload_budget)
+{
+    SDL_RendererInfo info;
+    if (_renderer == nullptr || SDL_GetRendererInfo(_renderer, &info) != 0 || std::strcmp(info.name, "opengl") != 0) {
+        std::cout << "Uploading textures synchronously" << std::endl;
+        return;
+    }
+    if (!load_functions()) {
+        std::cout << "Uploading textures synchronously, pixel buffers are not supported" << std::endl;
+        return;
+    }
+    _buffers.resize(PIXEL_BUFFER_COUNT);
+    for (auto& buffer : _buffers) {
+        buffer = {};
+        _gl_gen_buffers(1, &buffer.id);
+    }
+    _enabled = true;
+    std::cout << "Uploading textures through " << PIXEL_BUFFER_COUNT << " pixel buffers" << std::endl;
+}
+
+bool TextureUploader::load_functions()
+{
+    _gl_gen_buffers = (PFNGLGENBUFFERSPROC)SDL_GL_GetProcAddress("glGenBuffers");
+    _gl_delete_buffers = (PFNGLDELETEBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteBuffers");
+    _gl_bind_buffer = (PFNGLBINDBUFFERPROC)SDL_GL_GetProcAddress("glBindBuffer");
+    _gl_buffer_data = (PFNGLBUFFERDATAPROC)SDL_GL_GetProcAddress("glBufferData");
+    _gl_map_buffer_range = (PFNGLMAPBUFFERRANGEPROC)SDL_GL_GetProcAddress("glMapBufferRange");
+    _gl_unmap_buffer = (PFNGLUNMAPBUFFERPROC)SDL_GL_GetProcAddress("glUnmapBuffer");
+    _gl_fence_sync = (PFNGLFENCESYNCPROC)SDL_GL_GetProcAddress("glFenceSync");
+    _gl_client_wait_sync = (PFNGLCLIENTWAITSYNCPROC)SDL_GL_GetProcAddress("glClientWaitSync");
+    _gl_delete_sync = (PFNGLDELETESYNCPROC)SDL_GL_GetProcAddress("glDeleteSync");
+    _gl_pixel_storei = (PixelStoreiProc)SDL_GL_GetProcAddress("glPixelStorei");
+    _gl_tex_sub_image_2d = (TexSubImage2DProc)SDL_GL_GetProcAddress("glTexSubImage2D");
+    return _gl_gen_buffers != nullptr && _gl_delete_buffers != nullptr && _gl_bind_buffer != nullptr
+        && _gl_buffer_data != nullptr && _gl_map_buffer_range != nullptr && _gl_unmap_buffer != nullptr
+        && _gl_fence_sync != nullptr && _gl_client_wait_sync != nullptr && _gl_delete_sync != nullptr
+        && _gl_pixel_storei != nullptr && _gl_tex_sub_image_2d != nullptr;
+}
+
+bool TextureUploader::is_async(Uint32 pixel_format) const
+{
+    /* The formats the SDL OpenGL renderer stores as GL_RGBA8. */
+    return _enabled && (pixel_format == SDL_PIXELFORMAT_ARGB8888 || pixel_format == SDL_PIXELFORMAT_ABGR8888);
+}
+
+std::shared_ptr<TextureUpload> TextureUploader::begin_upload(const std::shared_ptr<unsigned char[]>& pixels, size_t size, bool urgent)
+{
+    if (!_budget.has_time()) {
+        _budget.defer();
+        return nullptr;
+    }
+    PixelBuffer* buffer = nullptr;
+    size_t index = 0;
+    auto buffer_count = urgent ? _buffers.size() : _buffers.size() - RESERVED_BUFFER_COUNT;
+    for (; index < buffer_count; index++) {
+        if (_buffers[index].state == PixelBufferFree) {
+            buffer = &_buffers[index];
+            break;
+        }
+    }
+    if (buffer == nullptr || size == 0) {
+        _budget.defer();
+        return nullptr;
+    }
+    _gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, buffer->id);
+    if (buffer->capacity < size) {
+        _gl_buffer_data(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+        buffer->capacity = size;
+    }
+    auto destination = (unsigned char*)_gl_map_buffer_range(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    _gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (destination == nullptr) {
+        return nullptr;
+    }
+    auto upload = std::make_shared<TextureUpload>();
+    upload->buffer = index;
+    upload->size = size;
+    upload->copied.store(false, std::memory_order_relaxed);
+    buffer->state = PixelBufferCopying;
+    buffer->upload = upload;
+    auto copy = [upload, pixels, destination]() {
+        std::memcpy(destination, pixels.get(), upload->size);
+        upload->copied.store(true, std::memory_order_release);
+    };
+    if (urgent) {
+        _work_pool->submit_urgent(std::move(copy));
+    } else {
+        _work_pool->submit(std::move(copy));
+    }
+    return upload;
+}
+
+bool TextureUploader::finish_upload(const std::shared_ptr<TextureUpload>& upload, SDL_Texture* texture, Uint32 pixel_format, const std::vector<Rect>& rects)
+{
+    if (!upload->copied.load(std::memory_order_acquire)) {
+        _budget.defer();
+        return false;
+    }
+    auto start = get_monotonic_time_ns();
+    auto& buffer = _buffers[upload->buffer];
+    /* Draws batched by SDL have to reach the texture before it changes. */
+    SDL_RenderFlush(_renderer);
+    unmap(buffer);
+    float texture_width = 0;
+    float texture_height = 0;
+    SDL_GL_BindTexture(texture, &texture_width, &texture_height);
+    /* SDL binds rectangle textures, whose coordinates are in pixels, when it can. */
+    auto target = texture_width > 1.5f ? GL_TEXTURE_RECTANGLE : GL_TEXTURE_2D;
+    auto format = pixel_format == SDL_PIXELFORMAT_ABGR8888 ? GL_RGBA : GL_BGRA;
+    _gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+    size_t offset = 0;
+    for (auto& r : rects) {
+        _gl_pixel_storei(GL_UNPACK_ROW_LENGTH, (GLint)r.size.width);
+        _gl_tex_sub_image_2d(target, 0, (GLint)r.location.x, (GLint)r.location.y, (GLsizei)r.size.width, (GLsizei)r.size.height,
+            format, GL_UNSIGNED_INT_8_8_8_8_REV, (const void*)offset);
+        offset += (size_t)(4 * r.size.width * r.size.height);
+    }
+    _gl_pixel_storei(GL_UNPACK_ROW_LENGTH, 0);
+    _gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    SDL_GL_UnbindTexture(texture);
+    buffer.fence = _gl_fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer.state = PixelBufferTransferring;
+    buffer.upload = nullptr;
+    _budget.charge(get_monotonic_time_ns() - start);
+    return true;
+}
+
+void TextureUploader::cancel_upload(const std::shared_ptr<TextureUpload>& upload)
+{
+    auto& buffer = _buffers[upload->buffer];
+    if (buffer.state == PixelBufferCopying && buffer.upload == upload) {
+        buffer.state = PixelBufferCancelled;
+    }
+}
+
+void TextureUploader::begin_frame()
+{
+    _budget.begin_frame();
+    if (!_enabled) {
+        return;
+    }
+    for (auto& buffer : _buffers) {
+        if (buffer.state == PixelBufferCancelled && buffer.upload->copied.load(std::memory_order_acquire)) {
+            unmap(buffer);
+            buffer.upload = nullptr;
+            buffer.state = PixelBufferFree;
+        } else if (buffer.state == PixelBufferTransferring) {
+            auto result = _gl_client_wait_sync(buffer.fence, 0, 0);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+                _gl_delete_sync(buffer.fence);
+                buffer.fence = nullptr;
+                buffer.state = PixelBufferFree;
+            }
+        }
+    }
+}
+
+void TextureUploader::end_frame()
+{
+    _budget.end_frame();
+}
+
+UploadBudget& TextureUploader::get_budget()
+{
+    return _budget;
+}
+
+void TextureUploader::unmap(PixelBuffer& buffer)
+{
+    _gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+    _gl_unmap_buffer(GL_PIXEL_UNPACK_BUFFER);
+    _gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureUploader::~TextureUploader()
+{
+    if (!_enabled) {
+        return;
+    }
+    for (auto& buffer : _buffers) {
+        /* A worker may still be writing into the mapping. */
+        while ((buffer.state == PixelBufferCopying || buffer.state == PixelBufferCancelled)
+            && !buffer.upload->copied.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        if (buffer.state == PixelBufferCopying || buffer.state == PixelBufferCancelled) {
+            unmap(buffer);
+        }
+        if (buffer.fence != nullptr) {
+            _gl_delete_sync(buffer.fence);
+        }
+        _gl_delete_buffers(1, &buffer.id);
+    }
+}
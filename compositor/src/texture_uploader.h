@@ -0,0 +1,117 @@
+#ifndef REVYV_TEXTUREUPLOADER_H
+#define REVYV_TEXTUREUPLOADER_H
+
+#include "geometry.h"
+#include "upload_budget.h"
+#include "work_pool.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace revyv {
+
+typedef struct
+{
+    /* Index of the pixel buffer the pixels are copied into. */
+    size_t buffer;
+    size_t size;
+    std::atomic<bool> copied;
+} TextureUpload;
+
+/*
+ * Uploads window pixels without stalling the frame, on the OpenGL renderer.
+ * The pixels are copied into a mapped pixel buffer on the work pool, and the
+ * transfer into the texture is queued on a later frame once the copy is
+ * done, so the GPU pulls the pixels by DMA while the window keeps showing its
+ * previous contents. A fence per buffer tells when it can be reused. With
+ * any other renderer, or formats it can't take, is_async() is false and the
+ * caller uses SDL_UpdateTexture().
+ */
+class TextureUploader {
+public:
+    /* upload_budget is in milliseconds per frame, 0 means no limit. */
+    TextureUploader(SDL_Renderer* renderer, const std::shared_ptr<WorkPool>& work_pool, double upload_budget);
+
+    ~TextureUploader();
+
+    TextureUploader(const TextureUploader&) = delete;
+
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+    [[nodiscard]] bool is_async(Uint32 pixel_format) const;
+
+    /*
+     * Starts copying the pixels, nullptr while every pixel buffer is in use.
+     * The last RESERVED_BUFFER_COUNT buffers are kept for urgent uploads, so
+     * background windows can't hold up the focused one.
+     */
+    [[nodiscard]] std::shared_ptr<TextureUpload> begin_upload(const std::shared_ptr<unsigned char[]>& pixels, size_t size, bool urgent);
+
+    /*
+     * Queues the transfer of the rects, packed one after the other, once the
+     * copy is done. Returns false while it is still copying.
+     */
+    bool finish_upload(const std::shared_ptr<TextureUpload>& upload, SDL_Texture* texture, Uint32 pixel_format, const std::vector<Rect>& rects);
+
+    /* Gives up on an upload that was begun but not finished. */
+    void cancel_upload(const std::shared_ptr<TextureUpload>& upload);
+
+    /* Recycles the pixel buffers the GPU is done with and renews the budget. */
+    void begin_frame();
+
+    void end_frame();
+
+    /* Shared by every window's uploads, synchronous ones included. */
+    [[nodiscard]] UploadBudget& get_budget();
+
+private:
+    typedef enum : uint8_t {
+        PixelBufferFree = 0,
+        PixelBufferCopying = 1,
+        PixelBufferCancelled = 2,
+        PixelBufferTransferring = 3,
+    } PixelBufferState;
+
+    typedef struct
+    {
+        GLuint id;
+        size_t capacity;
+        PixelBufferState state;
+        GLsync fence;
+        std::shared_ptr<TextureUpload> upload;
+    } PixelBuffer;
+
+    typedef void(APIENTRY* PixelStoreiProc)(GLenum name, GLint value);
+    typedef void(APIENTRY* TexSubImage2DProc)(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+
+    static constexpr size_t PIXEL_BUFFER_COUNT = 8;
+    static constexpr size_t RESERVED_BUFFER_COUNT = 2;
+
+    bool load_functions();
+
+    void unmap(PixelBuffer& buffer);
+
+private:
+    SDL_Renderer* _renderer;
+    std::shared_ptr<WorkPool> _work_pool;
+    UploadBudget _budget;
+    bool _enabled = false;
+    std::vector<PixelBuffer> _buffers;
+    PFNGLGENBUFFERSPROC _gl_gen_buffers = nullptr;
+    PFNGLDELETEBUFFERSPROC _gl_delete_buffers = nullptr;
+    PFNGLBINDBUFFERPROC _gl_bind_buffer = nullptr;
+    PFNGLBUFFERDATAPROC _gl_buffer_data = nullptr;
+    PFNGLMAPBUFFERRANGEPROC _gl_map_buffer_range = nullptr;
+    PFNGLUNMAPBUFFERPROC _gl_unmap_buffer = nullptr;
+    PFNGLFENCESYNCPROC _gl_fence_sync = nullptr;
+    PFNGLCLIENTWAITSYNCPROC _gl_client_wait_sync = nullptr;
+    PFNGLDELETESYNCPROC _gl_delete_sync = nullptr;
+    PixelStoreiProc _gl_pixel_storei = nullptr;
+    TexSubImage2DProc _gl_tex_sub_image_2d = nullptr;
+};
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "upload_budget.h"
+
+using namespace revyv;
+
+UploadBudget::UploadBudget(double budget)
+    : _budget((uint64_t)(budget * 1e6))
+{
+    _statistics.budget = _budget;
+}
+
+void UploadBudget::begin_frame()
+{
+    _spent = 0;
+    _deferred = false;
+}
+
+void UploadBudget::end_frame()
+{
+    if (_deferred) {
+        _statistics.catch_up_frames++;
+    }
+}
+
+bool UploadBudget::has_time() const
+{
+    return _budget == 0 || _spent < _budget;
+}
+
+void UploadBudget::charge(uint64_t ns)
+{
+    _spent += ns;
+}
+
+void UploadBudget::defer()
+{
+    _deferred = true;
+}
+
+void UploadBudget::complete_update(uint32_t frames)
+{
+    _statistics.updates++;
+    if (frames > 1) {
+        _statistics.tiled_updates++;
+    }
+    if (frames > _statistics.max_update_frames) {
+        _statistics.max_update_frames = frames;
+    }
+}
+
+UploadStatistics UploadBudget::get_statistics() const
+{
+    return _statistics;
+}
+
+void UploadBudget::reset_statistics()
+{
+    _statistics = {};
+    _statistics.budget = _budget;
+}
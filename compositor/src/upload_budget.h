@@ -0,0 +1,58 @@
+#ifndef REVYV_UPLOADBUDGET_H
+#define REVYV_UPLOADBUDGET_H
+
+#include <cstdint>
+
+namespace revyv {
+
+typedef struct
+{
+    /* Upload time allowed per frame in nanoseconds, 0 when unlimited. */
+    uint64_t budget;
+    uint64_t updates;
+    /* Updates that took more than one frame to upload. */
+    uint64_t tiled_updates;
+    /* Frames that ended with uploads left for later. */
+    uint64_t catch_up_frames;
+    /* Most frames one update took. */
+    uint32_t max_update_frames;
+} UploadStatistics;
+
+/*
+ * Caps the time spent uploading pixels per frame. Large updates are uploaded
+ * in tiles, a tile at a time while there is time left, so a 4K resize or a
+ * full repaint is spread over several frames instead of missing vsync. The
+ * first tile of a frame always goes, so uploads make progress even when a
+ * single tile takes longer than the budget.
+ */
+class UploadBudget {
+public:
+    /* Milliseconds per frame, 0 means no limit. */
+    explicit UploadBudget(double budget);
+
+    void begin_frame();
+
+    void end_frame();
+
+    [[nodiscard]] bool has_time() const;
+
+    void charge(uint64_t ns);
+
+    /* An upload waits for a later frame. */
+    void defer();
+
+    void complete_update(uint32_t frames);
+
+    [[nodiscard]] UploadStatistics get_statistics() const;
+
+    void reset_statistics();
+
+private:
+    uint64_t _budget;
+    uint64_t _spent = 0;
+    bool _deferred = false;
+    UploadStatistics _statistics {};
+};
+}
+
+#endif
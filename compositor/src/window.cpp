@@ -1,8 +1,32 @@
 #include "window.h"
+#include <algorithm>
+#include <compositor/trace.h>
+#include <cstring>
 #include <sys/shm.h>
 
 using namespace revyv;
 
+bool revyv::are_pixels_opaque(const unsigned char* pixels, size_t size, WindowRasterType raster_type)
+{
+    /* Pixels are native endian 32 bit words, alpha is their high or low byte. */
+    auto alpha_mask = raster_type == WindowRasterRGBA || raster_type == WindowRasterBGRA ? (uint32_t)0x000000ff : (uint32_t)0xff000000;
+    /* Pixels are and-ed together a chunk at a time without branching, so the inner loop vectorizes. */
+    const size_t chunk_size = 4096;
+    for (size_t offset = 0; offset < size; offset += chunk_size) {
+        auto end = std::min(size, offset + chunk_size);
+        uint32_t all = 0xffffffff;
+        for (auto i = offset; i + 4 <= end; i += 4) {
+            uint32_t pixel;
+            std::memcpy(&pixel, pixels + i, 4);
+            all &= pixel;
+        }
+        if ((all & alpha_mask) != alpha_mask) {
+            return false;
+        }
+    }
+    return true;
+}
+
 uint32_t Window::_id_counter = 0;
 
 Window::Window(pid_t pid, uint32_t id, WindowRasterType raster_type)
@@ -43,12 +67,96 @@ Rect Window::get_frame() const
 
 void Window::set_frame(const Rect& frame)
 {
+    auto old_frame = _frame;
     _frame = frame;
+    if (_frame_observer) {
+        _frame_observer(this, old_frame);
+    }
 }
 
 void Window::set_location(const Point& location)
 {
+    auto old_frame = _frame;
     _frame.location = location;
+    if (_frame_observer) {
+        _frame_observer(this, old_frame);
+    }
+}
+
+void Window::set_frame_observer(const std::function<void(Window*, const Rect&)>& observer)
+{
+    _frame_observer = observer;
+}
+
+Size Window::get_buffer_size() const
+{
+    return _buffer_size;
+}
+
+void Window::set_buffer_size(const Size& buffer_size)
+{
+    _buffer_size = buffer_size;
+}
+
+double Window::get_render_scale() const
+{
+    return _render_scale;
+}
+
+void Window::set_render_scale(double render_scale)
+{
+    _render_scale = render_scale;
+}
+
+uint64_t Window::take_uploaded_bytes()
+{
+    auto bytes = _uploaded_bytes;
+    _uploaded_bytes = 0;
+    return bytes;
+}
+
+void Window::add_uploaded_bytes(uint64_t bytes)
+{
+    _uploaded_bytes += bytes;
+    _activity.uploaded_bytes += bytes;
+}
+
+WindowActivity Window::take_activity()
+{
+    auto activity = _activity;
+    activity.decode_time = _decode_time.exchange(0, std::memory_order_relaxed);
+    _activity = {};
+    return activity;
+}
+
+void Window::add_decode_time(uint64_t ns)
+{
+    _decode_time.fetch_add(ns, std::memory_order_relaxed);
+}
+
+std::vector<UpdateStamp> Window::take_completed_updates()
+{
+    std::vector<UpdateStamp> updates;
+    updates.swap(_completed_updates);
+    return updates;
+}
+
+void Window::complete_update(const UpdateStamp& stamp)
+{
+    if (stamp.acknowledge || (stamp.id != 0 && Tracer::get().is_enabled())) {
+        _completed_updates.push_back(stamp);
+    }
+}
+
+void Window::count_updates(uint64_t updates, uint64_t dropped_updates)
+{
+    _activity.updates += updates;
+    _activity.dropped_updates += dropped_updates;
+}
+
+void Window::add_upload_time(uint64_t ns)
+{
+    _activity.upload_time += ns;
 }
 
 bool Window::is_visible() const
@@ -59,6 +167,59 @@ bool Window::is_visible() const
 void Window::set_visible(bool visible)
 {
     _visible = visible;
+    if (_frame_observer) {
+        _frame_observer(this, _frame);
+    }
+}
+
+bool Window::is_occluded() const
+{
+    return _occluded;
+}
+
+void Window::set_occluded(bool occluded)
+{
+    _occluded = occluded;
+}
+
+bool Window::is_opaque() const
+{
+    return _opaque;
+}
+
+void Window::set_opaque(bool opaque)
+{
+    _opaque = opaque;
+}
+
+uint64_t Window::get_last_drawn_frame() const
+{
+    return _last_drawn_frame;
+}
+
+void Window::set_last_drawn_frame(uint64_t frame)
+{
+    _last_drawn_frame = frame;
+}
+
+uint32_t Window::get_eviction_count() const
+{
+    return _eviction_count;
+}
+
+void Window::increment_eviction_count()
+{
+    _eviction_count++;
+}
+
+uint64_t Window::get_restored_bytes() const
+{
+    return _restored_bytes;
+}
+
+void Window::add_restored_bytes(uint64_t bytes)
+{
+    _restored_bytes += bytes;
 }
 
 int Window::get_raster_type() const
@@ -95,3 +256,33 @@ pid_t Window::get_pid() const
 {
     return _pid;
 }
+
+UpdatePriority Window::get_update_priority() const
+{
+    return _update_priority.load(std::memory_order_relaxed);
+}
+
+void Window::set_update_priority(UpdatePriority priority)
+{
+    _update_priority.store(priority, std::memory_order_relaxed);
+}
+
+bool Window::are_updates_deferred() const
+{
+    return _updates_deferred;
+}
+
+void Window::set_updates_deferred(bool deferred)
+{
+    _updates_deferred = deferred;
+}
+
+uint64_t Window::get_updates_released_at() const
+{
+    return _updates_released_at;
+}
+
+void Window::set_updates_released_at(uint64_t time)
+{
+    _updates_released_at = time;
+}
@@ -2,14 +2,37 @@
 #define REVYV_WINDOW_H
 
 #include "geometry.h"
+#include <atomic>
 #include <compositor/types.h>
+#include <functional>
 #include <memory>
+#include <vector>
 
 namespace revyv {
 class App;
 
 class Compositor;
 
+typedef enum : uint8_t {
+    UpdatePriorityBackground = 0,
+    /* The top most window and the one under the pointer. */
+    UpdatePriorityForeground = 1,
+} UpdatePriority;
+
+typedef struct
+{
+    /* Pixel updates applied, and the ones merged into a later update instead. */
+    uint64_t updates;
+    uint64_t dropped_updates;
+    uint64_t uploaded_bytes;
+    /* Nanoseconds spent applying tasks on the render thread and decoding on the pool. */
+    uint64_t upload_time;
+    uint64_t decode_time;
+} WindowActivity;
+
+/* Whether every pixel is fully opaque, scanned before the pixels reach the render thread. */
+bool are_pixels_opaque(const unsigned char* pixels, size_t size, WindowRasterType raster_type);
+
 class Window {
 public:
     Window(pid_t pid, uint32_t id, WindowRasterType raster_type);
@@ -26,19 +49,92 @@ public:
 
     void set_location(const Point& location);
 
+    /* Called with the previous frame whenever the frame or the visibility changes. */
+    void set_frame_observer(const std::function<void(Window*, const Rect&)>& observer);
+
+    [[nodiscard]] Size get_buffer_size() const;
+
+    void set_buffer_size(const Size& buffer_size);
+
+    [[nodiscard]] double get_render_scale() const;
+
+    void set_render_scale(double render_scale);
+
+    [[nodiscard]] uint64_t take_uploaded_bytes();
+
+    /* The activity since the last call, for the profiler. */
+    [[nodiscard]] WindowActivity take_activity();
+
+    /* Safe to call from any thread. */
+    void add_decode_time(uint64_t ns);
+
+    /* Updates applied since the last call whose clients asked to be told once they are presented. */
+    [[nodiscard]] std::vector<UpdateStamp> take_completed_updates();
+
     [[nodiscard]] bool is_visible() const;
 
     void set_visible(bool visible);
 
-    virtual void perform_operations_and_draw() = 0;
+    [[nodiscard]] bool is_occluded() const;
+
+    void set_occluded(bool occluded);
+
+    /* Whether every pixel is fully opaque, only such windows hide the ones below them. */
+    [[nodiscard]] bool is_opaque() const;
+
+    void set_opaque(bool opaque);
+
+    [[nodiscard]] uint64_t get_last_drawn_frame() const;
+
+    void set_last_drawn_frame(uint64_t frame);
+
+    [[nodiscard]] uint32_t get_eviction_count() const;
+
+    /* Bytes uploaded again from the compressed copy after evictions. */
+    [[nodiscard]] uint64_t get_restored_bytes() const;
+
+    /* Set by the render thread, read by the threads decoding the window's updates. */
+    [[nodiscard]] UpdatePriority get_update_priority() const;
+
+    void set_update_priority(UpdatePriority priority);
+
+    /* Whether pending pixel updates wait for a later frame. */
+    [[nodiscard]] bool are_updates_deferred() const;
+
+    void set_updates_deferred(bool deferred);
+
+    [[nodiscard]] uint64_t get_updates_released_at() const;
+
+    void set_updates_released_at(uint64_t time);
+
+    [[nodiscard]] virtual bool is_texture_resident() const = 0;
+
+    [[nodiscard]] virtual uint64_t get_texture_bytes() const = 0;
+
+    [[nodiscard]] virtual uint64_t get_evicted_bytes() const = 0;
+
+    virtual void evict_texture() = 0;
+
+    /* Applies pending updates, as far as the frame's upload budget allows. */
+    virtual void perform_operations() = 0;
+
+    virtual void draw() = 0;
+
+    [[nodiscard]] virtual size_t get_pending_task_count() const = 0;
 
     virtual void move(Point point) = 0;
 
-    virtual void create(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect) = 0;
+    /* opaque is are_pixels_opaque() of the pixels, so the render thread never scans them. */
+    virtual void create(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& rect, bool opaque) = 0;
+
+    virtual void resize(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque) = 0;
+
+    virtual void resize_buffer(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size, bool opaque) = 0;
 
-    virtual void resize(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Size& size) = 0;
+    virtual void update_pixels(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& dirty_rect, const UpdateStamp& stamp, bool opaque) = 0;
 
-    virtual void update_pixels(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const Rect& dirty_rect) = 0;
+    /* pixels holds the rows of each dirty rect packed one rect after the other. */
+    virtual void update_rects(std::shared_ptr<unsigned char[]> pixels, size_t bytes, const std::vector<Rect>& dirty_rects, const UpdateStamp& stamp, bool opaque) = 0;
 
     [[nodiscard]] pid_t get_pid() const;
 
@@ -56,11 +152,40 @@ public:
 
     void set_shared_memory_address(unsigned char* shared_memory_address);
 
+protected:
+    void add_uploaded_bytes(uint64_t bytes);
+
+    void count_updates(uint64_t updates, uint64_t dropped_updates);
+
+    void add_upload_time(uint64_t ns);
+
+    /* Keeps the stamp of an applied update for take_completed_updates(), if its client asked. */
+    void complete_update(const UpdateStamp& stamp);
+
+    void increment_eviction_count();
+
+    void add_restored_bytes(uint64_t bytes);
+
 private:
     pid_t _pid;
     uint32_t _id;
     Rect _frame;
+    Size _buffer_size {};
+    double _render_scale = 1.0;
+    uint64_t _uploaded_bytes = 0;
+    WindowActivity _activity {};
+    std::atomic<uint64_t> _decode_time = 0;
+    std::vector<UpdateStamp> _completed_updates;
     bool _visible;
+    std::function<void(Window*, const Rect&)> _frame_observer;
+    bool _occluded = false;
+    bool _opaque = false;
+    uint64_t _last_drawn_frame = 0;
+    uint32_t _eviction_count = 0;
+    uint64_t _restored_bytes = 0;
+    std::atomic<UpdatePriority> _update_priority = UpdatePriorityForeground;
+    bool _updates_deferred = false;
+    uint64_t _updates_released_at = 0;
     static uint32_t _id_counter;
     WindowRasterType _raster_type;
     int _shared_memory_id = -1;
@@ -1,154 +1,209 @@
 #include "window_manager.h"
-#include "server.h"
 #include "window.h"
 
 using namespace revyv;
 
-WindowManager::WindowManager() = default;
+/* Upper bound of the pointer history kept per client and frame. */
+static const size_t MOUSE_HISTORY_MAX = 256;
 
-bool WindowManager::send_event(const std::shared_ptr<Event>& event)
+WindowManager::WindowManager(const std::shared_ptr<Compositor>& compositor, const PublisherLookup& publisher_lookup)
+    : _compositor(compositor)
+    , _publisher_lookup(publisher_lookup)
 {
-    auto event_type = event->get_type();
-    if (event_type == EventTypeKey) {
-        auto keyEvent = std::dynamic_pointer_cast<KeyEvent>(event);
-        return this->send_key_event(keyEvent);
-    } else if (event_type == EventTypeText) {
-        auto textEvent = std::dynamic_pointer_cast<TextEvent>(event);
-        return this->send_text_event(textEvent);
-    } else if (event_type == EventTypeMouseScroll) {
-        auto mouseScrollEvent = std::dynamic_pointer_cast<MouseScrollEvent>(event);
-        return this->send_mouse_scroll_event(mouseScrollEvent);
-    } else if (event_type == EventTypeMouseButton) {
-        auto mouseButtonEvent = std::dynamic_pointer_cast<MouseButtonEvent>(event);
-        return this->send_mouse_button_event(mouseButtonEvent);
-    } else if (event_type == EventTypeMouseMove) {
-        auto mouseMoveEvent = std::dynamic_pointer_cast<MouseMoveEvent>(event);
-        return this->send_mouse_move_event(mouseMoveEvent);
-    }
-    return false;
 }
 
-bool WindowManager::send_mouse_move_event(
-    const std::shared_ptr<MouseMoveEvent>& event)
+bool WindowManager::send_event(const Event& event)
 {
-    std::weak_ptr<Window> window;
-    if (!_active_window.expired() && _active_window.lock() != nullptr) {
-        window = _active_window;
-    } else {
-        window = Server::get_shared_instance()->get_compositor()->find_window_in_location(make_point(event->get_x(), event->get_y()));
+    if (event.type != EventTypeMouseMove) {
+        /* Keep the order, mouse moves that came first are delivered first. */
+        flush_mouse_move_events();
     }
-    if (window.expired() || window.lock() == nullptr) {
+    auto routed = event;
+    auto* route = resolve_route(routed);
+    if (route == nullptr) {
         return false;
     }
-    auto point = window.lock()->get_location_in_window(make_point(event->get_x(), event->get_y()));
-    event->set_window_x(point.x);
-    event->set_window_y(point.y);
-    auto publisher = Server::get_shared_instance()->get_publisher(window.lock()->get_pid());
-    if (publisher.expired() || publisher.lock() == nullptr) {
+    if (routed.stage_times.received != 0) {
+        routed.stage_times.routed = get_monotonic_time_ns();
+        _route_latency.record(routed.stage_times.routed - routed.stage_times.received);
+    }
+    if (routed.type == EventTypeMouseMove) {
+        coalesce_mouse_move_event(route->pid, routed);
+        return true;
+    }
+    if (route->publisher == nullptr) {
         return false;
     }
-    publisher.lock()->send_mouse_move_event(event);
+    publish_event(*route->publisher, routed);
     return true;
 }
 
-bool WindowManager::send_mouse_button_event(
-    const std::shared_ptr<MouseButtonEvent>& event)
+pid_t WindowManager::route_event(Event& event)
 {
-    auto compositor = Server::get_shared_instance()->get_compositor();
-    if (event->get_state() == MouseButtonStatePressed) {
-        auto window = compositor->find_window_in_location(
-            make_point(event->get_x(), event->get_y()));
-        if (window.expired() || window.lock() == nullptr) {
-            return false;
-        }
-        _active_window = window;
-        auto top_most_window = compositor->get_top_most_window();
-        if (!top_most_window.expired() && top_most_window.lock() != nullptr && top_most_window.lock()->get_id() == window.lock()->get_id()) {
-            auto point = window.lock()->get_location_in_window(make_point(event->get_x(), event->get_y()));
-            event->set_window_x(point.x);
-            event->set_window_y(point.y);
-            auto publisher = Server::get_shared_instance()->get_publisher(window.lock()->get_pid());
-            if (publisher.expired() || publisher.lock() == nullptr) {
-                return false;
+    auto* route = resolve_route(event);
+    return route != nullptr ? route->pid : 0;
+}
+
+LatencySummary WindowManager::get_route_latency() const
+{
+    return _route_latency.get_summary();
+}
+
+LatencySummary WindowManager::get_dispatch_latency() const
+{
+    return _dispatch_latency.get_summary();
+}
+
+void WindowManager::reset_latency()
+{
+    _route_latency.reset();
+    _dispatch_latency.reset();
+}
+
+void WindowManager::invalidate_routes()
+{
+    _routes_invalidated.store(true, std::memory_order_release);
+}
+
+const WindowManager::Route* WindowManager::resolve_route(Event& event)
+{
+    validate_routes();
+    Window* window = nullptr;
+    if (event.type == EventTypeMouseMove) {
+        _compositor->set_pointer_location(make_point(event.mouse.x, event.mouse.y));
+    }
+    switch (event.type) {
+    case EventTypeMouseMove:
+    case EventTypeMouseScroll:
+        window = find_pointer_window(event);
+        break;
+    case EventTypeMouseButton:
+        if (event.mouse.state == MouseButtonStatePressed) {
+            window = _compositor->get_window_in_location(make_point(event.mouse.x, event.mouse.y));
+            if (window == nullptr) {
+                return nullptr;
             }
-            publisher.lock()->send_mouse_button_event(event);
-            return true;
-        } else {
-            compositor->window_bring_to_front(window.lock());
-            return true;
-        }
-    } else if (event->get_state() == MouseButtonStateReleased) {
-        std::weak_ptr<Window> window;
-        if (!_active_window.expired() && _active_window.lock() != nullptr) {
-            window = _active_window;
-            _active_window = {};
-        } else {
-            window = compositor->find_window_in_location(
-                make_point(event->get_x(), event->get_y()));
-        }
-        if (window.expired() || window.lock() == nullptr) {
-            return false;
-        }
-        auto point = window.lock()->get_location_in_window(make_point(event->get_x(), event->get_y()));
-        event->set_window_x(point.x);
-        event->set_window_y(point.y);
-        auto publisher = Server::get_shared_instance()->get_publisher(window.lock()->get_pid());
-        if (publisher.expired() || publisher.lock() == nullptr) {
-            return false;
+            _active_window = window;
+            _active_window_id = window->get_id();
+            auto top_most_window = _compositor->get_top_most_window().lock();
+            if (top_most_window == nullptr || top_most_window.get() != window) {
+                /* The first click only raises the window. */
+                _compositor->window_bring_to_front(_compositor->find_window(window->get_id()).lock());
+                return nullptr;
+            }
+        } else if (event.mouse.state == MouseButtonStateReleased) {
+            window = find_pointer_window(event);
+            _active_window = nullptr;
+            _active_window_id = 0;
         }
-        publisher.lock()->send_mouse_button_event(event);
-        return true;
+        break;
+    case EventTypeKey:
+    case EventTypeText:
+        window = _compositor->get_top_most_window().lock().get();
+        break;
+    default:
+        break;
+    }
+    if (window == nullptr) {
+        return nullptr;
+    }
+    auto* route = find_route(window);
+    if (event.type == EventTypeMouseMove || event.type == EventTypeMouseButton || event.type == EventTypeMouseScroll) {
+        event.mouse.window_x = event.mouse.x - route->origin.x;
+        event.mouse.window_y = event.mouse.y - route->origin.y;
     }
-    return false;
+    event.window_id = route->window_id;
+    return route;
 }
 
-bool WindowManager::send_mouse_scroll_event(
-    const std::shared_ptr<MouseScrollEvent>& event)
+const WindowManager::Route* WindowManager::find_route(Window* window)
 {
-    std::weak_ptr<Window> window;
-    if (!_active_window.expired() && _active_window.lock() != nullptr) {
-        window = _active_window;
-    } else {
-        window = Server::get_shared_instance()->get_compositor()->find_window_in_location(make_point(event->get_x(), event->get_y()));
+    if (window == _last_route_window) {
+        return _last_route;
     }
-    if (window.expired() || window.lock() == nullptr) {
-        return false;
+    auto it = _routes.find(window);
+    if (it == _routes.end()) {
+        auto pid = window->get_pid();
+        it = _routes.insert({ window, { pid, window->get_id(), window->get_frame().location, _publisher_lookup(pid).lock() } }).first;
     }
-    auto point = window.lock()->get_location_in_window(make_point(event->get_x(), event->get_y()));
-    event->set_window_x(point.x);
-    event->set_window_y(point.y);
-    auto publisher = Server::get_shared_instance()->get_publisher(window.lock()->get_pid());
-    if (publisher.expired() || publisher.lock() == nullptr) {
-        return false;
+    _last_route_window = window;
+    _last_route = &it->second;
+    return _last_route;
+}
+
+void WindowManager::validate_routes()
+{
+    auto generation = _compositor->get_generation();
+    if (generation == _routes_generation && !_routes_invalidated.load(std::memory_order_acquire)) {
+        return;
+    }
+    _routes_invalidated.store(false, std::memory_order_relaxed);
+    _routes_generation = generation;
+    _routes.clear();
+    _last_route_window = nullptr;
+    _last_route = nullptr;
+    /* The active window may have been destroyed, it is looked up again by id. */
+    if (_active_window_id != 0) {
+        _active_window = _compositor->find_window(_active_window_id).lock().get();
     }
-    publisher.lock()->send_mouse_scroll_event(event);
-    return true;
 }
 
-bool WindowManager::send_text_event(const std::shared_ptr<TextEvent>& event)
+void WindowManager::flush_mouse_move_events()
 {
-    auto window = Server::get_shared_instance()->get_compositor()->get_top_most_window();
-    if (window.expired() || window.lock() == nullptr) {
-        return false;
+    for (auto& it : _pending_mouse_moves) {
+        flush_mouse_move_event(it.first, it.second);
     }
-    auto publisher = Server::get_shared_instance()->get_publisher(window.lock()->get_pid());
-    if (publisher.expired() || publisher.lock() == nullptr) {
-        return false;
+}
+
+void WindowManager::flush_mouse_move_event(pid_t pid, PendingMouseMove& pending)
+{
+    if (!pending.pending) {
+        return;
     }
-    publisher.lock()->send_text_event(event);
-    return true;
+    auto publisher = _publisher_lookup(pid);
+    if (!publisher.expired() && publisher.lock() != nullptr) {
+        if (!pending.history.empty() && publisher.lock()->is_pointer_history_enabled()) {
+            auto history = make_event(EventTypeMouseHistory);
+            history.window_id = pending.latest.window_id;
+            history.timestamp = pending.history.front().timestamp;
+            history.history.sample_count = (uint32_t)pending.history.size();
+            publisher.lock()->send_mouse_history_event(history, pending.history);
+        }
+        publish_event(*publisher.lock(), pending.latest);
+    }
+    pending.pending = false;
+    pending.history.clear();
 }
 
-bool WindowManager::send_key_event(const std::shared_ptr<KeyEvent>& event)
+Window* WindowManager::find_pointer_window(const Event& event)
 {
-    auto window = Server::get_shared_instance()->get_compositor()->get_top_most_window();
-    if (window.expired() || window.lock() == nullptr) {
-        return false;
+    if (_active_window != nullptr) {
+        return _active_window;
     }
-    auto publisher = Server::get_shared_instance()->get_publisher(window.lock()->get_pid());
-    if (publisher.expired() || publisher.lock() == nullptr) {
-        return false;
+    return _compositor->get_window_in_location(make_point(event.mouse.x, event.mouse.y));
+}
+
+void WindowManager::coalesce_mouse_move_event(pid_t pid, const Event& event)
+{
+    /* Only the latest position per client is sent, the ones before it become history. */
+    auto& pending = _pending_mouse_moves[pid];
+    /* Samples are in the coordinates of their window, a batch never spans two windows. */
+    if (pending.pending && pending.latest.window_id != event.window_id) {
+        flush_mouse_move_event(pid, pending);
     }
-    publisher.lock()->send_key_event(event);
-    return true;
+    if (pending.pending && pending.history.size() < MOUSE_HISTORY_MAX) {
+        auto& latest = pending.latest.mouse;
+        pending.history.push_back({ latest.window_x, latest.window_y, latest.x, latest.y, pending.latest.timestamp });
+    }
+    pending.latest = event;
+    pending.pending = true;
+}
+
+void WindowManager::publish_event(Publisher& publisher, Event& event)
+{
+    if (event.stage_times.routed != 0) {
+        event.stage_times.published = get_monotonic_time_ns();
+        _dispatch_latency.record(event.stage_times.published - event.stage_times.routed);
+    }
+    publisher.send_event(event);
 }
@@ -1,32 +1,95 @@
 #ifndef REVYV_WINDOWMANAGER_H
 #define REVYV_WINDOWMANAGER_H
 
+#include "compositor.h"
+#include "publisher.h"
 #include "window.h"
+#include <atomic>
+#include <compositor/latency_histogram.h>
 #include <compositor/types.h>
+#include <functional>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 namespace revyv {
 class Window;
 
+typedef std::function<std::weak_ptr<Publisher>(pid_t)> PublisherLookup;
+
 class WindowManager {
 public:
-    WindowManager();
+    WindowManager(const std::shared_ptr<Compositor>& compositor, const PublisherLookup& publisher_lookup);
+
+    bool send_event(const Event& event);
+
+    /* Sends the mouse moves coalesced since the last flush, called once per frame. */
+    void flush_mouse_move_events();
+
+    /*
+     * Finds the client an event goes to and fills in the window it hits,
+     * returns 0 when the event is not delivered.
+     */
+    pid_t route_event(Event& event);
+
+    /* Drops the cached routes when clients come and go, safe to call from any thread. */
+    void invalidate_routes();
+
+    /* From receiving an input event to routing it. */
+    [[nodiscard]] LatencySummary get_route_latency() const;
 
-    bool send_event(const std::shared_ptr<Event>& event);
+    /* From routing an input event to handing it to the client's publisher,
+     * includes the time mouse moves wait to be coalesced. */
+    [[nodiscard]] LatencySummary get_dispatch_latency() const;
+
+    void reset_latency();
 
 private:
-    bool send_mouse_move_event(const std::shared_ptr<MouseMoveEvent>& event);
+    /* Where events for a window go, valid until the window or its client changes. */
+    typedef struct
+    {
+        pid_t pid;
+        uint32_t window_id;
+        Point origin;
+        std::shared_ptr<Publisher> publisher;
+    } Route;
+
+    typedef struct
+    {
+        bool pending;
+        Event latest;
+        std::vector<MouseMoveSample> history;
+    } PendingMouseMove;
+
+    const Route* resolve_route(Event& event);
+
+    const Route* find_route(Window* window);
+
+    void validate_routes();
 
-    bool send_mouse_button_event(const std::shared_ptr<MouseButtonEvent>& event);
+    Window* find_pointer_window(const Event& event);
 
-    bool send_mouse_scroll_event(const std::shared_ptr<MouseScrollEvent>& event);
+    void coalesce_mouse_move_event(pid_t pid, const Event& event);
 
-    bool send_text_event(const std::shared_ptr<TextEvent>& event);
+    void flush_mouse_move_event(pid_t pid, PendingMouseMove& pending);
 
-    bool send_key_event(const std::shared_ptr<KeyEvent>& event);
+    void publish_event(Publisher& publisher, Event& event);
 
 private:
-    std::weak_ptr<Window> _active_window;
+    std::shared_ptr<Compositor> _compositor;
+    PublisherLookup _publisher_lookup;
+    /* The window a button was pressed in, gets the pointer until release. */
+    Window* _active_window = nullptr;
+    uint32_t _active_window_id = 0;
+    std::unordered_map<const Window*, Route> _routes;
+    const Window* _last_route_window = nullptr;
+    const Route* _last_route = nullptr;
+    uint64_t _routes_generation = 0;
+    std::atomic<bool> _routes_invalidated = false;
+    LatencyHistogram _route_latency;
+    LatencyHistogram _dispatch_latency;
+    /* Entries are kept between frames so their history keeps its capacity. */
+    std::unordered_map<pid_t, PendingMouseMove> _pending_mouse_moves;
 };
 }
 
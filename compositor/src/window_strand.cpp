@@ -0,0 +1,70 @@
+#include "window_strand.h"
+#include <compositor/latency_histogram.h>
+
+using namespace revyv;
+
+WindowStrand::WindowStrand(const std::shared_ptr<Window>& window, const std::shared_ptr<Compositor>& compositor, const std::shared_ptr<WorkPool>& work_pool)
+    : _window(window)
+    , _compositor(compositor)
+    , _work_pool(work_pool)
+{
+}
+
+WindowStrand::~WindowStrand()
+{
+    _compositor->post_command([window = std::move(_window)](Compositor&) { });
+}
+
+void WindowStrand::submit(std::function<WindowCommand()> job)
+{
+    auto sequence = _next_sequence++;
+    auto task = [strand = shared_from_this(), sequence, job = std::move(job)]() {
+        WindowCommand command;
+        auto start = get_monotonic_time_ns();
+        try {
+            command = job();
+        } catch (std::exception& e) {
+            std::cout << __func__ << ": " << e.what() << std::endl;
+        }
+        strand->_window->add_decode_time(get_monotonic_time_ns() - start);
+        /* Completes even when the job failed, the commands after it would wait forever otherwise. */
+        strand->complete(sequence, std::move(command));
+    };
+    /* The focused window's updates are decoded ahead of the background ones. */
+    if (_window->get_update_priority() == UpdatePriorityForeground) {
+        _work_pool->submit_urgent(std::move(task));
+    } else {
+        _work_pool->submit(std::move(task));
+    }
+}
+
+void WindowStrand::post(WindowCommand command)
+{
+    complete(_next_sequence++, std::move(command));
+}
+
+const std::shared_ptr<Window>& WindowStrand::get_window() const
+{
+    return _window;
+}
+
+void WindowStrand::complete(uint64_t sequence, WindowCommand command)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (sequence != _next_delivery) {
+        _completed[sequence] = std::move(command);
+        return;
+    }
+    while (true) {
+        if (command != nullptr) {
+            _compositor->post_command([window = _window, command = std::move(command)](Compositor& compositor) { command(compositor, window); });
+        }
+        _next_delivery++;
+        auto it = _completed.find(_next_delivery);
+        if (it == _completed.end()) {
+            return;
+        }
+        command = std::move(it->second);
+        _completed.erase(it);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef REVYV_WINDOWSTRAND_H
+#define REVYV_WINDOWSTRAND_H
+
+#include "compositor.h"
+#include "window.h"
+#include "work_pool.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace revyv {
+
+/* Runs on the render thread with the strand's window. */
+typedef std::function<void(Compositor&, const std::shared_ptr<Window>&)> WindowCommand;
+
+/*
+ * Orders the work for one window. Jobs run on the pool in parallel, also
+ * several of the same window, but the commands they produce are posted to
+ * the compositor in the order the jobs were submitted, so a window's
+ * updates are applied in order while its decoding scales with the cores.
+ */
+class WindowStrand : public std::enable_shared_from_this<WindowStrand> {
+public:
+    WindowStrand(const std::shared_ptr<Window>& window, const std::shared_ptr<Compositor>& compositor, const std::shared_ptr<WorkPool>& work_pool);
+
+    /* The window is let go on the render thread. */
+    ~WindowStrand();
+
+    /* Runs job on the pool, the command it returns (if any) is posted in order. */
+    void submit(std::function<WindowCommand()> job);
+
+    /* Posts command in order, after the commands of the jobs submitted before. */
+    void post(WindowCommand command);
+
+    [[nodiscard]] const std::shared_ptr<Window>& get_window() const;
+
+private:
+    void complete(uint64_t sequence, WindowCommand command);
+
+private:
+    std::shared_ptr<Window> _window;
+    std::shared_ptr<Compositor> _compositor;
+    std::shared_ptr<WorkPool> _work_pool;
+    std::atomic<uint64_t> _next_sequence = 0;
+    std::mutex _mutex;
+    uint64_t _next_delivery = 0;
+    /* Commands of jobs that finished before an earlier one. */
+    std::map<uint64_t, WindowCommand> _completed;
+};
+}
+
+#endif
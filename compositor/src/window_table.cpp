@@ -0,0 +1,202 @@
+#include "window_table.h"
+
+using namespace revyv;
+
+WindowHandle WindowTable::insert(const std::shared_ptr<Window>& window)
+{
+    uint32_t slot;
+    if (!_free_slots.empty()) {
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+    } else {
+        slot = (uint32_t)_windows.size();
+        _generations.push_back(0);
+        _windows.emplace_back();
+        _ids.push_back(0);
+        _pids.push_back(0);
+        _frames.push_back(make_rect(0, 0, 0, 0));
+        _visible.push_back(0);
+        _above.push_back(NO_SLOT);
+        _below.push_back(NO_SLOT);
+        _next_of_pid.push_back(NO_SLOT);
+        _previous_of_pid.push_back(NO_SLOT);
+    }
+    _windows[slot] = window;
+    _ids[slot] = window->get_id();
+    _pids[slot] = window->get_pid();
+    _frames[slot] = window->get_frame();
+    _visible[slot] = window->is_visible() ? 1 : 0;
+    link_on_top(slot);
+    link_to_pid(slot);
+    _size++;
+
+    WindowHandle handle { slot, _generations[slot] };
+    _handles_by_id[window->get_id()] = handle;
+    return handle;
+}
+
+void WindowTable::remove(WindowHandle handle)
+{
+    if (!is_valid(handle)) {
+        return;
+    }
+    auto slot = handle.index;
+    unlink_from_stack(slot);
+    unlink_from_pid(slot);
+    _handles_by_id.erase(_ids[slot]);
+    _windows[slot] = nullptr;
+    _generations[slot]++;
+    _free_slots.push_back(slot);
+    _size--;
+}
+
+std::vector<std::shared_ptr<Window>> WindowTable::remove_by_pid(pid_t pid)
+{
+    std::vector<std::shared_ptr<Window>> removed;
+    auto it = _first_slot_of_pid.find(pid);
+    if (it == _first_slot_of_pid.end()) {
+        return removed;
+    }
+    for (auto slot = it->second; slot != NO_SLOT;) {
+        auto next = _next_of_pid[slot];
+        removed.push_back(_windows[slot]);
+        remove({ slot, _generations[slot] });
+        slot = next;
+    }
+    return removed;
+}
+
+bool WindowTable::is_valid(WindowHandle handle) const
+{
+    return handle.index < _generations.size() && _generations[handle.index] == handle.generation && _windows[handle.index] != nullptr;
+}
+
+WindowHandle WindowTable::find(uint32_t id) const
+{
+    auto it = _handles_by_id.find(id);
+    if (it == _handles_by_id.end()) {
+        return INVALID_WINDOW_HANDLE;
+    }
+    return it->second;
+}
+
+std::shared_ptr<Window> WindowTable::get_window(WindowHandle handle) const
+{
+    if (!is_valid(handle)) {
+        return nullptr;
+    }
+    return _windows[handle.index];
+}
+
+void WindowTable::raise(WindowHandle handle)
+{
+    if (!is_valid(handle) || handle.index == _top) {
+        return;
+    }
+    unlink_from_stack(handle.index);
+    link_on_top(handle.index);
+}
+
+void WindowTable::set_frame(WindowHandle handle, const Rect& frame)
+{
+    if (is_valid(handle)) {
+        _frames[handle.index] = frame;
+    }
+}
+
+void WindowTable::set_visible(WindowHandle handle, bool visible)
+{
+    if (is_valid(handle)) {
+        _visible[handle.index] = visible ? 1 : 0;
+    }
+}
+
+WindowHandle WindowTable::get_top() const
+{
+    if (_top == NO_SLOT) {
+        return INVALID_WINDOW_HANDLE;
+    }
+    return { _top, _generations[_top] };
+}
+
+size_t WindowTable::size() const
+{
+    return _size;
+}
+
+void WindowTable::update_occlusion()
+{
+    _covers.clear();
+    for (auto slot = _top; slot != NO_SLOT; slot = _below[slot]) {
+        auto& frame = _frames[slot];
+        bool occluded = false;
+        for (auto& cover : _covers) {
+            if (cover.location.x <= frame.location.x && cover.location.y <= frame.location.y
+                && cover.location.x + cover.size.width >= frame.location.x + frame.size.width
+                && cover.location.y + cover.size.height >= frame.location.y + frame.size.height) {
+                occluded = true;
+                break;
+            }
+        }
+        _windows[slot]->set_occluded(occluded);
+        /* Windows below a translucent one show through it. */
+        if (_visible[slot] && _windows[slot]->is_opaque()) {
+            _covers.push_back(frame);
+        }
+    }
+}
+
+void WindowTable::link_on_top(uint32_t slot)
+{
+    _below[slot] = _top;
+    _above[slot] = NO_SLOT;
+    if (_top != NO_SLOT) {
+        _above[_top] = slot;
+    } else {
+        _bottom = slot;
+    }
+    _top = slot;
+}
+
+void WindowTable::unlink_from_stack(uint32_t slot)
+{
+    if (_above[slot] != NO_SLOT) {
+        _below[_above[slot]] = _below[slot];
+    } else {
+        _top = _below[slot];
+    }
+    if (_below[slot] != NO_SLOT) {
+        _above[_below[slot]] = _above[slot];
+    } else {
+        _bottom = _above[slot];
+    }
+    _above[slot] = NO_SLOT;
+    _below[slot] = NO_SLOT;
+}
+
+void WindowTable::link_to_pid(uint32_t slot)
+{
+    auto it = _first_slot_of_pid.find(_pids[slot]);
+    _previous_of_pid[slot] = NO_SLOT;
+    _next_of_pid[slot] = it != _first_slot_of_pid.end() ? it->second : NO_SLOT;
+    if (_next_of_pid[slot] != NO_SLOT) {
+        _previous_of_pid[_next_of_pid[slot]] = slot;
+    }
+    _first_slot_of_pid[_pids[slot]] = slot;
+}
+
+void WindowTable::unlink_from_pid(uint32_t slot)
+{
+    if (_previous_of_pid[slot] != NO_SLOT) {
+        _next_of_pid[_previous_of_pid[slot]] = _next_of_pid[slot];
+    } else if (_next_of_pid[slot] != NO_SLOT) {
+        _first_slot_of_pid[_pids[slot]] = _next_of_pid[slot];
+    } else {
+        _first_slot_of_pid.erase(_pids[slot]);
+    }
+    if (_next_of_pid[slot] != NO_SLOT) {
+        _previous_of_pid[_next_of_pid[slot]] = _previous_of_pid[slot];
+    }
+    _next_of_pid[slot] = NO_SLOT;
+    _previous_of_pid[slot] = NO_SLOT;
+}
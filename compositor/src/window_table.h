@@ -0,0 +1,108 @@
+#ifndef REVYV_WINDOWTABLE_H
+#define REVYV_WINDOWTABLE_H
+
+#include "geometry.h"
+#include "window.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace revyv {
+
+typedef struct
+{
+    uint32_t index;
+    uint32_t generation;
+} WindowHandle;
+
+const WindowHandle INVALID_WINDOW_HANDLE = { UINT32_MAX, 0 };
+
+/*
+ * Slot map of the windows known to the compositor. Slots are reused, a handle
+ * stays valid until its window is removed because removing bumps the
+ * generation of the slot. Geometry and visibility are kept in parallel arrays
+ * indexed by slot. The stacking order and the windows of each pid are
+ * intrusive lists through the slots, so restacking and removal are O(1).
+ */
+class WindowTable {
+public:
+    /* The window is stacked on top. */
+    WindowHandle insert(const std::shared_ptr<Window>& window);
+
+    void remove(WindowHandle handle);
+
+    std::vector<std::shared_ptr<Window>> remove_by_pid(pid_t pid);
+
+    [[nodiscard]] bool is_valid(WindowHandle handle) const;
+
+    [[nodiscard]] WindowHandle find(uint32_t id) const;
+
+    [[nodiscard]] std::shared_ptr<Window> get_window(WindowHandle handle) const;
+
+    void raise(WindowHandle handle);
+
+    void set_frame(WindowHandle handle, const Rect& frame);
+
+    void set_visible(WindowHandle handle, bool visible);
+
+    [[nodiscard]] WindowHandle get_top() const;
+
+    [[nodiscard]] size_t size() const;
+
+    /* Marks every window fully covered by a single visible, opaque window above it as occluded. */
+    void update_occlusion();
+
+    template <typename F>
+    void for_each_bottom_to_top(F&& callback) const
+    {
+        for (auto slot = _bottom; slot != NO_SLOT; slot = _above[slot]) {
+            callback(_windows[slot]);
+        }
+    }
+
+    /* Stops as soon as the callback returns false. */
+    template <typename F>
+    void for_each_top_to_bottom(F&& callback) const
+    {
+        for (auto slot = _top; slot != NO_SLOT; slot = _below[slot]) {
+            if (!callback(_windows[slot], _frames[slot], _visible[slot] != 0)) {
+                break;
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    void link_on_top(uint32_t slot);
+
+    void unlink_from_stack(uint32_t slot);
+
+    void link_to_pid(uint32_t slot);
+
+    void unlink_from_pid(uint32_t slot);
+
+private:
+    std::vector<uint32_t> _generations;
+    std::vector<std::shared_ptr<Window>> _windows;
+    std::vector<uint32_t> _ids;
+    std::vector<pid_t> _pids;
+    std::vector<Rect> _frames;
+    std::vector<uint8_t> _visible;
+    std::vector<uint32_t> _above;
+    std::vector<uint32_t> _below;
+    std::vector<uint32_t> _next_of_pid;
+    std::vector<uint32_t> _previous_of_pid;
+    std::vector<uint32_t> _free_slots;
+    uint32_t _top = NO_SLOT;
+    uint32_t _bottom = NO_SLOT;
+    size_t _size = 0;
+    std::unordered_map<uint32_t, WindowHandle> _handles_by_id;
+    std::unordered_map<pid_t, uint32_t> _first_slot_of_pid;
+    std::vector<Rect> _covers;
+};
+
+}
+
+#endif
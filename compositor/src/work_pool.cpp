@@ -0,0 +1,145 @@
+#include "work_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace revyv;
+
+/* Buffers below this are copied by the caller alone. */
+static const size_t PARALLEL_COPY_MIN = 2 * 1024 * 1024;
+static const size_t PARALLEL_COPY_CHUNK_MIN = 512 * 1024;
+
+/* The pool and worker index of the current thread, when it is a worker. */
+static thread_local WorkPool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+WorkPool::WorkPool(size_t thread_count)
+{
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        _workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        _threads.emplace_back(WorkPool::worker_thread, this, i);
+    }
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+        _stopping = true;
+    }
+    _idle.notify_all();
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+void WorkPool::submit(Job job)
+{
+    auto index = current_pool == this ? current_worker : _next_worker++ % _workers.size();
+    /* Counted before it can be taken, or the worker's decrement could wrap. */
+    _pending++;
+    {
+        std::lock_guard<std::mutex> lock(_workers[index]->mutex);
+        _workers[index]->jobs.push_back(std::move(job));
+    }
+    {
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+    }
+    _idle.notify_one();
+}
+
+void WorkPool::submit_urgent(Job job)
+{
+    _pending++;
+    {
+        std::lock_guard<std::mutex> lock(_urgent_mutex);
+        _urgent_jobs.push_back(std::move(job));
+    }
+    {
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+    }
+    _idle.notify_one();
+}
+
+void WorkPool::copy(unsigned char* destination, const unsigned char* source, size_t size)
+{
+    auto chunk_count = std::min(_workers.size(), size / PARALLEL_COPY_CHUNK_MIN);
+    if (size < PARALLEL_COPY_MIN || chunk_count < 2 || current_pool == this) {
+        std::memcpy(destination, source, size);
+        return;
+    }
+    auto chunk_size = (size + chunk_count - 1) / chunk_count;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining = chunk_count - 1;
+    for (size_t i = 1; i < chunk_count; i++) {
+        auto offset = i * chunk_size;
+        auto length = std::min(chunk_size, size - offset);
+        submit([&, offset, length]() {
+            std::memcpy(destination + offset, source + offset, length);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+    std::memcpy(destination, source, chunk_size);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return remaining == 0; });
+}
+
+size_t WorkPool::get_thread_count() const
+{
+    return _threads.size();
+}
+
+void WorkPool::worker_thread(WorkPool* pool, size_t index)
+{
+    current_pool = pool;
+    current_worker = index;
+    while (true) {
+        Job job;
+        if (pool->take_job(index, job)) {
+            pool->_pending--;
+            try {
+                job();
+            } catch (std::exception& e) {
+                std::cout << __func__ << ": " << e.what() << std::endl;
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(pool->_idle_mutex);
+        pool->_idle.wait(lock, [pool]() { return pool->_pending > 0 || pool->_stopping; });
+        if (pool->_stopping && pool->_pending == 0) {
+            return;
+        }
+    }
+}
+
+bool WorkPool::take_job(size_t index, Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_urgent_mutex);
+        if (!_urgent_jobs.empty()) {
+            job = std::move(_urgent_jobs.front());
+            _urgent_jobs.pop_front();
+            return true;
+        }
+    }
+    /* Own queue first, then steal the oldest job of the others. */
+    for (size_t i = 0; i < _workers.size(); i++) {
+        auto& worker = *_workers[(index + i) % _workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.jobs.empty()) {
+            job = std::move(worker.jobs.front());
+            worker.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef REVYV_WORKPOOL_H
+#define REVYV_WORKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace revyv {
+
+/*
+ * Shared pool of worker threads for pixel work, sized to the core count.
+ * Every worker has its own job queue, jobs submitted from outside are spread
+ * over them and idle workers steal from the others, so one busy client
+ * spreads over all cores and many small ones do not oversubscribe them.
+ */
+class WorkPool {
+public:
+    typedef std::function<void()> Job;
+
+    /* 0 threads means one per core. */
+    explicit WorkPool(size_t thread_count);
+
+    ~WorkPool();
+
+    void submit(Job job);
+
+    /* Runs before every job submitted with submit() that has not started yet. */
+    void submit_urgent(Job job);
+
+    /* memcpy that splits large buffers over the workers and returns once all of it is copied. */
+    void copy(unsigned char* destination, const unsigned char* source, size_t size);
+
+    [[nodiscard]] size_t get_thread_count() const;
+
+private:
+    typedef struct
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    } Worker;
+
+    static void worker_thread(WorkPool* pool, size_t index);
+
+    bool take_job(size_t index, Job& job);
+
+private:
+    std::mutex _urgent_mutex;
+    std::deque<Job> _urgent_jobs;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _next_worker = 0;
+    std::atomic<size_t> _pending = 0;
+    std::mutex _idle_mutex;
+    std::condition_variable _idle;
+    bool _stopping = false;
+};
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "sdl_compositor.h"
+#include "sdl_window.h"
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+using namespace revyv;
+
+/* ctest counts this exit code as skipped. */
+static const int SKIPPED = 77;
+
+static const Size SCREEN_SIZE = make_size(128, 128);
+static const Size WINDOW_SIZE = make_size(64, 64);
+
+static const uint32_t WINDOW_COLOR = 0xffffffff;
+static const uint32_t UPDATE_COLOR = 0xff204060;
+
+static std::shared_ptr<unsigned char[]> make_pixels(size_t pixel_count, uint32_t color)
+{
+    auto pixels = std::shared_ptr<unsigned char[]>(new unsigned char[pixel_count * 4]);
+    for (size_t i = 0; i < pixel_count; i++) {
+        std::memcpy(pixels.get() + i * 4, &color, 4);
+    }
+    return pixels;
+}
+
+static uint32_t read_screen_pixel(SDL_Renderer* renderer, int x, int y)
+{
+    SDL_Rect rect = { x, y, 1, 1 };
+    uint32_t pixel = 0;
+    SDL_RenderReadPixels(renderer, &rect, SDL_PIXELFORMAT_ARGB8888, &pixel, 4);
+    return pixel;
+}
+
+static bool check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+    }
+    return condition;
+}
+
+/*
+ * A rect that reaches past the buffer of an evicted window, as one sent
+ * before a resize does, must only change the part inside it. Run under
+ * AddressSanitizer to catch writes past the compressed copy's buffer.
+ */
+int main()
+{
+    auto work_pool = std::make_shared<WorkPool>(1);
+    auto compositor = std::make_shared<SDLCompositor>(SCREEN_SIZE, 0, 0, work_pool, true);
+    auto renderer = compositor->get_renderer();
+    if (renderer == nullptr) {
+        std::cout << "Skipping, no renderer: " << SDL_GetError() << std::endl;
+        return SKIPPED;
+    }
+
+    compositor->set_background_update_interval(0);
+
+    auto window_pixel_count = (size_t)(WINDOW_SIZE.width * WINDOW_SIZE.height);
+    auto window = std::make_shared<SDLWindow>(getpid(), 1, WindowRasterARGB, renderer, compositor->get_texture_uploader());
+    window->create(make_pixels(window_pixel_count, WINDOW_COLOR), window_pixel_count * 4, make_rect(0, 0, WINDOW_SIZE.width, WINDOW_SIZE.height), true);
+    compositor->add_window(window);
+    for (int frame = 0; frame < 10 && window->get_pending_task_count() > 0; frame++) {
+        compositor->compose();
+    }
+
+    window->evict_texture();
+    if (!check(!window->is_texture_resident(), "texture evicted")) {
+        return 1;
+    }
+
+    /* Half inside the buffer, and entirely outside of it. */
+    std::vector<Rect> rects = { make_rect(48, 48, 32, 32), make_rect(1000, 1000, 16, 16) };
+    size_t update_pixel_count = 32 * 32 + 16 * 16;
+    window->update_rects(make_pixels(update_pixel_count, UPDATE_COLOR), update_pixel_count * 4, rects, UpdateStamp {}, true);
+    compositor->compose();
+
+    auto passed = check(window->is_texture_resident(), "texture restored when drawn");
+    passed &= check(read_screen_pixel(renderer, 60, 60) == UPDATE_COLOR, "clipped rect applied inside the buffer");
+    passed &= check(read_screen_pixel(renderer, 40, 40) == WINDOW_COLOR, "pixels outside the rects kept");
+    passed &= check(read_screen_pixel(renderer, 70, 70) != UPDATE_COLOR, "nothing drawn past the window");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "process_monitor.h"
+#include <chrono>
+#include <csignal>
+#include <future>
+#include <iostream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace revyv;
+
+static const auto EXIT_TIMEOUT = std::chrono::seconds(5);
+
+static bool check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+    }
+    return condition;
+}
+
+/*
+ * Waits for the exit of a child watched after the wait started, the way
+ * the server's monitor thread does. Without pidfds it has to be woken to
+ * start polling, or it blocks for ever.
+ */
+static bool test_exit_reported(bool use_pidfds)
+{
+    ProcessMonitor monitor(use_pidfds);
+    auto child = fork();
+    if (child == 0) {
+        pause();
+        _exit(0);
+    }
+
+    auto waiter = std::async(std::launch::async, [&monitor, child]() {
+        auto deadline = std::chrono::steady_clock::now() + EXIT_TIMEOUT;
+        std::vector<pid_t> pids;
+        while (std::chrono::steady_clock::now() < deadline) {
+            monitor.wait_for_exits(pids, -1);
+            for (auto pid : pids) {
+                if (pid == child) {
+                    return true;
+                }
+            }
+            pids.clear();
+        }
+        return false;
+    });
+
+    /* Let the waiter block before anything is watched. */
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto passed = check(monitor.watch(child), "child watched");
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+
+    if (!check(waiter.wait_for(EXIT_TIMEOUT) == std::future_status::ready, "exit reported in time")) {
+        /* The waiter is stuck in the monitor, it cannot be joined. */
+        std::cout.flush();
+        _exit(1);
+    }
+    return check(waiter.get(), "exited child reported") && passed;
+}
+
+int main()
+{
+    auto passed = test_exit_reported(true);
+    passed &= test_exit_reported(false);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include "pixel_converter.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace revyv;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+} Resolution;
+
+typedef struct {
+    WindowRasterType from;
+    WindowRasterType to;
+    PixelAlphaOperation alpha_operation;
+} Conversion;
+
+static double measure(const PixelConverter& converter, const std::vector<unsigned char>& source, std::vector<unsigned char>& destination, int iterations)
+{
+    auto pixel_count = source.size() / 4;
+    converter.convert(source.data(), destination.data(), pixel_count);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        converter.convert(source.data(), destination.data(), pixel_count);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    /* Megapixels per second. */
+    return (double)pixel_count * iterations / elapsed / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+
+    std::vector<Resolution> resolutions { { 640, 480 }, { 1920, 1080 }, { 3840, 2160 } };
+    std::vector<Conversion> conversions {
+        { WindowRasterARGB, WindowRasterRGBA, PixelAlphaKeep },
+        { WindowRasterARGB, WindowRasterBGRA, PixelAlphaKeep },
+        { WindowRasterRGBA, WindowRasterABGR, PixelAlphaKeep },
+        { WindowRasterARGB, WindowRasterRGBA, PixelAlphaPremultiply },
+        { WindowRasterARGB, WindowRasterRGBA, PixelAlphaUnpremultiply },
+    };
+    std::vector<PixelConverterPath> paths { PixelConverterPathScalar, PixelConverterPathSSE4, PixelConverterPathAVX2, PixelConverterPathNEON };
+
+    auto best = PixelConverter::get_best_path();
+    std::cout << "Dispatched path: " << PixelConverter::get_path_name(best) << std::endl;
+
+    for (auto& r : resolutions) {
+        std::vector<unsigned char> source((size_t)r.width * r.height * 4);
+        std::vector<unsigned char> destination(source.size());
+        for (size_t i = 0; i < source.size(); i++) {
+            source[i] = (unsigned char)std::rand();
+        }
+
+        for (auto& c : conversions) {
+            std::cout << r.width << "x" << r.height << " "
+                      << PixelConverter::get_raster_type_name(c.from) << " -> "
+                      << PixelConverter::get_raster_type_name(c.to)
+                      << (c.alpha_operation == PixelAlphaPremultiply ? " premultiply" : c.alpha_operation == PixelAlphaUnpremultiply ? " unpremultiply" : "")
+                      << std::endl;
+            for (auto path : paths) {
+                if (!PixelConverter::is_path_supported(path)) {
+                    continue;
+                }
+                PixelConverter converter(c.from, c.to, c.alpha_operation, path);
+                auto throughput = measure(converter, source, destination, iterations);
+                std::cout << "    " << std::setw(8) << std::left << PixelConverter::get_path_name(path)
+                          << std::fixed << std::setprecision(1) << std::setw(10) << std::right << throughput << " Mpx/s"
+                          << (path == best ? "  *" : "") << std::endl;
+            }
+        }
+    }
+
+    return 0;
+}
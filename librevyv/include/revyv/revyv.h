@@ -11,8 +11,16 @@
 typedef enum : uint8_t {
     RevyvWindowRasterRGBA = 1,
     RevyvWindowRasterARGB = 2,
+    RevyvWindowRasterABGR = 3,
+    RevyvWindowRasterBGRA = 4,
 } RevyvWindowRasterType;
 
+typedef enum : uint8_t {
+    RevyvPixelAlphaKeep = 0,
+    RevyvPixelAlphaPremultiply = 1,
+    RevyvPixelAlphaUnpremultiply = 2,
+} RevyvPixelAlphaOperation;
+
 typedef enum : uint8_t {
     RevyvEventTypeUndefined = 0,
     RevyvEventTypeMouseMove = 1,
@@ -21,6 +29,9 @@ typedef enum : uint8_t {
     RevyvEventTypeKey = 4,
     RevyvEventTypeText = 5,
     RevyvEventTypeQuit = 6,
+    RevyvEventTypeWindowScale = 7,
+    RevyvEventTypeMouseHistory = 9,
+    RevyvEventTypeFramePresented = 10,
 } RevyvEventType;
 
 typedef enum {
@@ -66,12 +77,63 @@ typedef struct
     bool repeat;
 } RevyvKeyEvent;
 
+/* text points into the context, see revyv_event_poll(). */
 typedef struct
 {
     char* text;
     size_t text_size;
 } RevyvTextEvent;
 
+/*
+ * Sent when the compositor wants the window rendered at a different scale,
+ * the client should answer with revyv_window_resize_buffer().
+ */
+typedef struct
+{
+    double scale;
+} RevyvWindowScaleEvent;
+
+typedef struct
+{
+    double x;
+    double y;
+    double abs_x;
+    double abs_y;
+    uint32_t timestamp;
+} RevyvMouseSample;
+
+/*
+ * Pointer positions coalesced into the mouse move that follows, oldest first.
+ * Only sent after revyv_context_set_pointer_history(), samples stay valid
+ * until the next revyv_event_poll() or revyv_event_wait().
+ */
+typedef struct
+{
+    const RevyvMouseSample* samples;
+    size_t sample_count;
+} RevyvMouseHistoryEvent;
+
+/*
+ * Only sent after revyv_context_set_frame_acknowledgements(), once a frame
+ * showing the update was presented. Updates the compositor merged into a
+ * later one of the same window are not acknowledged. Times are monotonic
+ * nanoseconds, the same clock in the client and the compositor.
+ */
+typedef struct
+{
+    uint64_t update_id;
+    uint64_t submitted_ns;
+    uint64_t presented_ns;
+} RevyvFramePresentedEvent;
+
+typedef struct
+{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+} RevyvRect;
+
 typedef struct
 {
     uint32_t window_id;
@@ -79,18 +141,121 @@ typedef struct
     RevyvKeyEvent key_event;
     RevyvTextEvent text_event;
     RevyvMouseEvent mouse_event;
+    RevyvWindowScaleEvent scale_event;
+    RevyvMouseHistoryEvent history_event;
+    RevyvFramePresentedEvent frame_event;
 } RevyvEvent;
 
+/* Durations in nanoseconds. */
+typedef struct
+{
+    uint64_t count;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} RevyvLatencySummary;
+
+/*
+ * Latency of the input events received, by stage: route is from the
+ * compositor receiving an event to routing it, dispatch from routing to
+ * publishing (mouse moves wait here to be coalesced), transport from
+ * publishing to the client dequeuing it and total end to end.
+ */
+typedef struct
+{
+    RevyvLatencySummary route;
+    RevyvLatencySummary dispatch;
+    RevyvLatencySummary transport;
+    RevyvLatencySummary total;
+} RevyvInputLatency;
+
 EXPORT void* revyv_context_create();
 
 EXPORT void revyv_context_destroy(void* context);
 
+/*
+ * Raster type the compositor uploads without converting, pixels in any other
+ * raster type are converted by librevyv before they are sent. Unless events
+ * were received already, the first call waits briefly for the compositor to
+ * tell it, and ARGB is assumed when it doesn't.
+ */
+EXPORT uint8_t revyv_context_get_native_raster_type(void* context);
+
+/*
+ * A file descriptor that becomes readable when events arrive, to add to an
+ * existing poll, epoll or kqueue loop. It is edge triggered: once it fires,
+ * call revyv_event_poll() with a zero timeout until it returns fewer events
+ * than asked for.
+ */
+EXPORT int revyv_context_get_fd(void* context);
+
+EXPORT RevyvInputLatency revyv_context_get_input_latency(void* context);
+
+EXPORT void revyv_context_reset_input_latency(void* context);
+
+/*
+ * Mouse moves are coalesced to one per frame, with history enabled the
+ * positions in between are delivered as RevyvEventTypeMouseHistory.
+ */
+EXPORT void revyv_context_set_pointer_history(void* context, bool enabled);
+
+/*
+ * Numbers every window update sent from now on and asks the compositor for a
+ * RevyvEventTypeFramePresented once it is on screen.
+ */
+EXPORT void revyv_context_set_frame_acknowledgements(void* context, bool enabled);
+
+/* From submitting a window update to the compositor presenting it, acknowledged updates only. */
+EXPORT RevyvLatencySummary revyv_context_get_frame_latency(void* context);
+
+EXPORT void revyv_context_reset_frame_latency(void* context);
+
+/*
+ * Called once librevyv no longer reads the buffer of a pixel update, on
+ * librevyv's submission thread when submission is asynchronous.
+ */
+typedef void (*RevyvBufferRelease)(void* user_data, const unsigned char* buffer);
+
+/*
+ * Window calls return at once and a librevyv thread converts, compresses and
+ * sends them in the order they were made. revyv_window_update() and
+ * revyv_window_update_rects() copy what they send first, the _async variants
+ * read the buffer in place until they release it. Calls that return something
+ * or read a buffer of their own, like revyv_window_create() and
+ * revyv_window_resize(), wait for the calls before them. Disabling it sends
+ * what is still queued first.
+ */
+EXPORT void revyv_context_set_async_submission(void* context, bool enabled);
+
+/* Waits until every window call made so far has been sent. */
+EXPORT void revyv_context_flush(void* context);
+
+EXPORT void revyv_pixels_convert(const unsigned char* source, unsigned char* destination, size_t pixel_count, uint8_t from_raster_type, uint8_t to_raster_type, uint8_t alpha_operation);
+
 EXPORT uint32_t revyv_window_create(void* context, unsigned char* data, size_t data_size, double x, double y, double width, double height, uint8_t raster_type);
 
 EXPORT void revyv_window_update(void* context, uint32_t window_id, unsigned char* data, size_t data_size, double x, double y, double width, double height);
 
+/*
+ * Sends the dirty rects of a full frame, rows are copied straight from the
+ * buffer into shared memory. stride is the size of a buffer row in bytes.
+ */
+EXPORT void revyv_window_update_rects(void* context, uint32_t window_id, const unsigned char* buffer, size_t stride, const RevyvRect* rects, size_t rect_count);
+
+/*
+ * Like revyv_window_update() and revyv_window_update_rects(), without a copy:
+ * the buffer must stay as it is until release is called, which happens
+ * once even when sending fails. A NULL release copies like the calls
+ * without the suffix.
+ */
+EXPORT void revyv_window_update_async(void* context, uint32_t window_id, unsigned char* data, size_t data_size, double x, double y, double width, double height, RevyvBufferRelease release, void* user_data);
+
+EXPORT void revyv_window_update_rects_async(void* context, uint32_t window_id, const unsigned char* buffer, size_t stride, const RevyvRect* rects, size_t rect_count, RevyvBufferRelease release, void* user_data);
+
 EXPORT void revyv_window_resize(void* context, uint32_t window_id, void* data, uint64_t data_size, double width, double height);
 
+EXPORT void revyv_window_resize_buffer(void* context, uint32_t window_id, unsigned char* data, size_t data_size, double width, double height);
+
 EXPORT void revyv_window_change_visibility(void* context, uint32_t window_id, bool visible);
 
 EXPORT void revyv_window_bring_to_front(void* context, uint32_t window_id);
@@ -100,6 +265,14 @@ EXPORT void revyv_window_move(void* context, uint32_t window_id, double x, doubl
 EXPORT void revyv_window_destroy(void* context, uint32_t window_id);
 
 EXPORT RevyvEvent revyv_event_wait(void* context);
+
+/*
+ * Writes up to max pending events and returns how many were written. Waits at
+ * most timeout_ms for the first event, 0 returns at once and -1 waits forever.
+ * Pointers inside the events stay valid until the next revyv_event_poll() or
+ * revyv_event_wait().
+ */
+EXPORT size_t revyv_event_poll(void* context, RevyvEvent* events, size_t max, int timeout_ms);
 }
 
 #endif
@@ -5,6 +5,75 @@
 
 using namespace revyv;
 
+static RevyvEvent to_revyv_event(Connector* connector, size_t index)
+{
+    RevyvEvent result {};
+
+    const Event& event = connector->get_event(index);
+
+    result.type = event.type;
+    result.window_id = event.window_id;
+
+    switch (event.type) {
+    case EventTypeMouseButton:
+        result.mouse_event.button_state = event.mouse.state;
+        result.mouse_event.button = event.mouse.button;
+        result.mouse_event.clicks = event.mouse.clicks;
+        result.mouse_event.x = event.mouse.window_x;
+        result.mouse_event.y = event.mouse.window_y;
+        result.mouse_event.abs_x = event.mouse.x;
+        result.mouse_event.abs_y = event.mouse.y;
+        break;
+    case EventTypeMouseMove:
+        result.mouse_event.x = event.mouse.window_x;
+        result.mouse_event.y = event.mouse.window_y;
+        result.mouse_event.abs_x = event.mouse.x;
+        result.mouse_event.abs_y = event.mouse.y;
+        break;
+    case EventTypeMouseScroll:
+        result.mouse_event.x = event.mouse.window_x;
+        result.mouse_event.y = event.mouse.window_y;
+        result.mouse_event.abs_x = event.mouse.x;
+        result.mouse_event.abs_y = event.mouse.y;
+        result.mouse_event.scroll_x = event.mouse.scroll_x;
+        result.mouse_event.scroll_y = event.mouse.scroll_y;
+        break;
+    case EventTypeKey:
+        result.key_event.keycode = event.key.keycode;
+        result.key_event.keymod = event.key.keymod;
+        result.key_event.scancode = event.key.scancode;
+        result.key_event.repeat = event.key.repeat;
+        result.key_event.state = event.key.state;
+        break;
+    case EventTypeText:
+        /* Points into the connector, valid until the next revyv_event_wait() or revyv_event_poll(). */
+        result.text_event.text = (char*)event.text.text;
+        result.text_event.text_size = get_event_text_size(event);
+        break;
+    case EventTypeMouseHistory:
+        result.history_event.samples = (const RevyvMouseSample*)connector->get_history_samples(index);
+        result.history_event.sample_count = event.history.sample_count;
+        break;
+    case EventTypeWindowScale:
+        result.scale_event.scale = event.scale.scale;
+        break;
+    case EventTypeFramePresented:
+        result.frame_event.update_id = event.frame.update.id;
+        result.frame_event.submitted_ns = event.frame.update.submitted;
+        result.frame_event.presented_ns = event.frame.presented;
+        break;
+    default:
+        break;
+    }
+
+    return result;
+}
+
+static RevyvLatencySummary to_revyv_latency_summary(const LatencySummary& summary)
+{
+    return { summary.count, summary.p50, summary.p99, summary.max };
+}
+
 extern "C" {
 
 void* revyv_context_create()
@@ -19,6 +88,78 @@ void revyv_context_destroy(void* ctx)
     delete connector;
 }
 
+uint8_t revyv_context_get_native_raster_type(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    return connector->get_native_raster_type();
+}
+
+int revyv_context_get_fd(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    return connector->get_fd();
+}
+
+RevyvInputLatency revyv_context_get_input_latency(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    auto latency = connector->get_input_latency();
+    RevyvInputLatency result {};
+    result.route = to_revyv_latency_summary(latency.route);
+    result.dispatch = to_revyv_latency_summary(latency.dispatch);
+    result.transport = to_revyv_latency_summary(latency.transport);
+    result.total = to_revyv_latency_summary(latency.total);
+    return result;
+}
+
+void revyv_context_reset_input_latency(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    connector->reset_input_latency();
+}
+
+void revyv_context_set_pointer_history(void* ctx, bool enabled)
+{
+    auto* connector = (Connector*)ctx;
+    connector->set_pointer_history(enabled);
+}
+
+void revyv_context_set_frame_acknowledgements(void* ctx, bool enabled)
+{
+    auto* connector = (Connector*)ctx;
+    connector->set_frame_acknowledgements(enabled);
+}
+
+RevyvLatencySummary revyv_context_get_frame_latency(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    return to_revyv_latency_summary(connector->get_frame_latency());
+}
+
+void revyv_context_reset_frame_latency(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    connector->reset_frame_latency();
+}
+
+void revyv_context_set_async_submission(void* ctx, bool enabled)
+{
+    auto* connector = (Connector*)ctx;
+    connector->set_async_submission(enabled);
+}
+
+void revyv_context_flush(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    connector->flush();
+}
+
+void revyv_pixels_convert(const unsigned char* source, unsigned char* destination, size_t pixel_count, uint8_t from_raster_type, uint8_t to_raster_type, uint8_t alpha_operation)
+{
+    PixelConverter converter((WindowRasterType)from_raster_type, (WindowRasterType)to_raster_type, (PixelAlphaOperation)alpha_operation);
+    converter.convert(source, destination, pixel_count);
+}
+
 uint32_t revyv_window_create(void* ctx, unsigned char* data, size_t data_size, double x, double y, double width, double height, uint8_t raster_type)
 {
     auto* connector = (Connector*)ctx;
@@ -32,12 +173,57 @@ void revyv_window_update(void* ctx, uint32_t window_id, unsigned char* data, siz
     connector->window_update_pixels(window_id, data, data_size, x, y, width, height);
 }
 
+static std::vector<WindowUpdateRect> to_window_update_rects(const RevyvRect* rects, size_t rect_count)
+{
+    std::vector<WindowUpdateRect> update_rects;
+    update_rects.reserve(rect_count);
+    for (size_t i = 0; i < rect_count; i++) {
+        if (rects[i].x < 0 || rects[i].y < 0 || rects[i].width <= 0 || rects[i].height <= 0) {
+            continue;
+        }
+        update_rects.push_back({ (uint32_t)rects[i].x, (uint32_t)rects[i].y, (uint32_t)rects[i].width, (uint32_t)rects[i].height });
+    }
+    return update_rects;
+}
+
+static BufferRelease to_buffer_release(RevyvBufferRelease release, void* user_data, const unsigned char* buffer)
+{
+    if (release == nullptr) {
+        return nullptr;
+    }
+    return [release, user_data, buffer]() { release(user_data, buffer); };
+}
+
+void revyv_window_update_rects(void* ctx, uint32_t window_id, const unsigned char* buffer, size_t stride, const RevyvRect* rects, size_t rect_count)
+{
+    auto* connector = (Connector*)ctx;
+    connector->window_update_rects(window_id, buffer, stride, to_window_update_rects(rects, rect_count));
+}
+
+void revyv_window_update_async(void* ctx, uint32_t window_id, unsigned char* data, size_t data_size, double x, double y, double width, double height, RevyvBufferRelease release, void* user_data)
+{
+    auto* connector = (Connector*)ctx;
+    connector->window_update_pixels(window_id, data, data_size, x, y, width, height, to_buffer_release(release, user_data, data));
+}
+
+void revyv_window_update_rects_async(void* ctx, uint32_t window_id, const unsigned char* buffer, size_t stride, const RevyvRect* rects, size_t rect_count, RevyvBufferRelease release, void* user_data)
+{
+    auto* connector = (Connector*)ctx;
+    connector->window_update_rects(window_id, buffer, stride, to_window_update_rects(rects, rect_count), to_buffer_release(release, user_data, buffer));
+}
+
 void revyv_window_resize(void* ctx, uint32_t window_id, void* data, uint64_t data_size, double width, double height)
 {
     auto* connector = (Connector*)ctx;
     connector->window_resize(window_id, static_cast<unsigned char*>(data), data_size, width, height);
 }
 
+void revyv_window_resize_buffer(void* ctx, uint32_t window_id, unsigned char* data, size_t data_size, double width, double height)
+{
+    auto* connector = (Connector*)ctx;
+    connector->window_resize_buffer(window_id, data, data_size, width, height);
+}
+
 void revyv_window_change_visibility(void* ctx, uint32_t window_id, bool visible)
 {
     auto* connector = (Connector*)ctx;
@@ -62,54 +248,26 @@ void revyv_window_destroy(void* ctx, uint32_t window_id)
     connector->window_destroy(window_id);
 }
 
-RevyvEvent revyv_event_wait(void* ctx)
+static_assert(sizeof(RevyvMouseSample) == sizeof(MouseMoveSample), "RevyvMouseSample must match MouseMoveSample");
+static_assert(offsetof(RevyvMouseSample, x) == offsetof(MouseMoveSample, window_x), "RevyvMouseSample must match MouseMoveSample");
+static_assert(offsetof(RevyvMouseSample, abs_x) == offsetof(MouseMoveSample, x), "RevyvMouseSample must match MouseMoveSample");
+static_assert(offsetof(RevyvMouseSample, timestamp) == offsetof(MouseMoveSample, timestamp), "RevyvMouseSample must match MouseMoveSample");
+
+size_t revyv_event_poll(void* ctx, RevyvEvent* events, size_t max, int timeout_ms)
 {
     auto* connector = (Connector*)ctx;
-
-    RevyvEvent result {};
-
-    std::shared_ptr<Event> event = connector->event_wait();
-
-    result.type = event->get_type();
-
-    if (event->get_type() == EventTypeMouseButton) {
-        auto mouse_button_event = std::dynamic_pointer_cast<MouseButtonEvent>(event);
-        result.mouse_event.button_state = mouse_button_event->get_state();
-        result.mouse_event.button = mouse_button_event->get_button();
-        result.mouse_event.clicks = mouse_button_event->get_clicks();
-        result.mouse_event.x = mouse_button_event->get_window_x();
-        result.mouse_event.y = mouse_button_event->get_window_y();
-        result.mouse_event.abs_x = mouse_button_event->get_x();
-        result.mouse_event.abs_y = mouse_button_event->get_y();
-    } else if (event->get_type() == EventTypeMouseMove) {
-        auto mouse_move_event = std::dynamic_pointer_cast<MouseMoveEvent>(event);
-        result.mouse_event.x = mouse_move_event->get_window_x();
-        result.mouse_event.y = mouse_move_event->get_window_y();
-        result.mouse_event.abs_x = mouse_move_event->get_x();
-        result.mouse_event.abs_y = mouse_move_event->get_y();
-    } else if (event->get_type() == EventTypeMouseScroll) {
-        auto mouse_scroll_event = std::dynamic_pointer_cast<MouseScrollEvent>(event);
-        result.mouse_event.x = mouse_scroll_event->get_window_x();
-        result.mouse_event.y = mouse_scroll_event->get_window_y();
-        result.mouse_event.abs_x = mouse_scroll_event->get_x();
-        result.mouse_event.abs_y = mouse_scroll_event->get_y();
-        result.mouse_event.scroll_x = mouse_scroll_event->get_scroll_x();
-        result.mouse_event.scroll_y = mouse_scroll_event->get_scroll_y();
-    } else if (event->get_type() == EventTypeKey) {
-        auto key_event = std::dynamic_pointer_cast<KeyEvent>(event);
-        result.key_event.keycode = key_event->get_keycode();
-        result.key_event.keymod = key_event->get_keymod();
-        result.key_event.scancode = key_event->get_scancode();
-        result.key_event.repeat = key_event->get_repeat();
-        result.key_event.state = key_event->get_state();
-    } else if (event->get_type() == EventTypeText) {
-        auto text_event = std::dynamic_pointer_cast<TextEvent>(event);
-        result.text_event.text = new char[text_event->get_text().size() + 1];
-        strcpy(result.text_event.text, text_event->get_text().c_str());
-        result.text_event.text_size = text_event->get_text().size();
+    auto count = connector->event_poll(max, timeout_ms);
+    for (size_t i = 0; i < count; i++) {
+        events[i] = to_revyv_event(connector, i);
     }
+    return count;
+}
 
-    return result;
+RevyvEvent revyv_event_wait(void* ctx)
+{
+    auto* connector = (Connector*)ctx;
+    connector->event_wait();
+    return to_revyv_event(connector, 0);
 }
 
 } // extern "C"
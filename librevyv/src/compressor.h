@@ -2,7 +2,9 @@
 #define REVYV_COMPRESSOR_H
 
 #include <lzo/lzo1x.h>
+#include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <unistd.h>
 
 class FailedToCompressDataError : public std::runtime_error {
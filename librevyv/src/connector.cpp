@@ -1,6 +1,9 @@
 #include "connector.h"
 #include "compressor.h"
 #include "socket.h"
+#include <algorithm>
+#include <chrono>
+#include <compositor/trace.h>
 #include <lzo/lzo1x.h>
 #include <sstream>
 #include <sys/ipc.h>
@@ -12,6 +15,21 @@
 
 using namespace revyv;
 
+/* An older compositor never sends its info, a current one sends it as soon as the client registers. */
+static const long COMPOSITOR_INFO_TIMEOUT_MS = 100;
+
+/* Hands the buffer back when it goes out of scope, also when sending it throws. */
+struct ReleaseGuard {
+    const BufferRelease& release;
+
+    ~ReleaseGuard()
+    {
+        if (release != nullptr) {
+            release();
+        }
+    }
+};
+
 Connector::Connector()
 {
     if (lzo_init() != LZO_E_OK) {
@@ -42,79 +60,456 @@ Connector::Connector()
 Connector::~Connector() = default;
 
 uint32_t Connector::window_create(unsigned char* data, size_t size, double x, double y, double width, double height, WindowRasterType raster_type)
+{
+    wait_for_compositor_info();
+    uint32_t window_id = 0;
+    submit_and_wait([&]() { window_id = send_window_create(data, size, x, y, width, height, raster_type); });
+    return window_id;
+}
+
+uint32_t Connector::send_window_create(unsigned char* data, size_t size, double x, double y, double width, double height, WindowRasterType raster_type)
 {
     Window w {};
     w.id = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count() + getpid();
-    w.shared_memory_id = shmget(IPC_PRIVATE, size, IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    /* Leave room for the rect table of window_update_rects() in front of a full frame. */
+    w.shared_memory_size = size + WINDOW_UPDATE_RECTS_MAX * sizeof(WindowUpdateRect);
+    w.shared_memory_id = shmget(IPC_PRIVATE, w.shared_memory_size, IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
     w.shared_memory = (unsigned char*)shmat(w.shared_memory_id, 0, 0);
+    w.converter = std::make_shared<PixelConverter>(raster_type, _native_raster_type, PixelAlphaKeep);
     _windows[w.id] = w;
+    if (!w.converter->is_identity()) {
+        std::cout << "Window " << w.id << " uploads " << PixelConverter::get_raster_type_name(raster_type)
+                  << " as " << PixelConverter::get_raster_type_name(_native_raster_type) << " using the "
+                  << PixelConverter::get_path_name(w.converter->get_path()) << " path" << std::endl;
+    }
 
-    std::memcpy(w.shared_memory, data, size);
-    _listener->send_listener_payload(WindowCreatePayload(w.id, x, y, width, height, raster_type, size, w.shared_memory_id).get_payload());
+    w.converter->convert(data, w.shared_memory, size / 4);
+    _listener->send_listener_payload(WindowCreatePayload(w.id, x, y, width, height, _native_raster_type, size, w.shared_memory_id).get_payload());
 
     return w.id;
 }
 
-void Connector::window_update_pixels(uint32_t window_id, unsigned char* data, size_t size, double x, double y, double width, double height)
+void Connector::window_update_pixels(uint32_t window_id, unsigned char* data, size_t size, double x, double y, double width, double height, BufferRelease release)
+{
+    TraceSpan span("client update_pixels");
+    auto stamp = make_update_stamp();
+    auto flow_id = get_update_flow_id(getpid(), stamp.id);
+    span.add_flow(TraceFlowStart, flow_id);
+    if (_submitter == nullptr) {
+        ReleaseGuard guard { release };
+        send_update_pixels(window_id, data, size, x, y, width, height, stamp);
+        return;
+    }
+    /* Without a release the caller may reuse the buffer as soon as this returns. */
+    std::shared_ptr<unsigned char[]> copy;
+    if (release == nullptr) {
+        TraceSpan copy_span("copy buffer");
+        copy = std::shared_ptr<unsigned char[]>(new unsigned char[size]);
+        std::memcpy(copy.get(), data, size);
+        data = copy.get();
+    }
+    _submitter->post_update([this, window_id, data, size, x, y, width, height, stamp, flow_id, copy, release = std::move(release)]() {
+        TraceSpan submit_span("client submit update_pixels");
+        submit_span.add_flow(TraceFlowStep, flow_id);
+        ReleaseGuard guard { release };
+        send_update_pixels(window_id, data, size, x, y, width, height, stamp);
+    });
+}
+
+void Connector::send_update_pixels(uint32_t window_id, unsigned char* data, size_t size, double x, double y, double width, double height, const UpdateStamp& stamp)
 {
     auto w = _windows[window_id];
+    {
+        TraceSpan convert_span("convert");
+        data = convert_pixels(w, data, size);
+    }
     try {
+        TraceSpan compress_span("compress");
         Compressor compressor(data, size);
-        std::memcpy(w.shared_memory, compressor.getData().get(), compressor.getSize());
-        _listener->send_listener_payload(WindowUpdatePixelsPayload(window_id, x, y, width, height, size, true, compressor.getSize(), w.shared_memory_id).get_payload());
+        compress_span.end();
+        {
+            TraceSpan copy_span("copy");
+            std::memcpy(w.shared_memory, compressor.getData().get(), compressor.getSize());
+        }
+        TraceSpan send_span("send");
+        auto payload = WindowUpdatePixelsPayload(window_id, x, y, width, height, size, true, compressor.getSize(), w.shared_memory_id);
+        payload.set_update_stamp(stamp);
+        _listener->send_listener_payload(payload.get_payload());
     } catch (FailedToCompressDataError& e) {
         /* We failed to compress data, send it uncompressed. */
-        std::memcpy(w.shared_memory, data, size);
-        _listener->send_listener_payload(WindowUpdatePixelsPayload(window_id, x, y, width, height, size, false, size, w.shared_memory_id).get_payload());
+        {
+            TraceSpan copy_span("copy");
+            std::memcpy(w.shared_memory, data, size);
+        }
+        TraceSpan send_span("send");
+        auto payload = WindowUpdatePixelsPayload(window_id, x, y, width, height, size, false, size, w.shared_memory_id);
+        payload.set_update_stamp(stamp);
+        _listener->send_listener_payload(payload.get_payload());
     }
 }
 
-void Connector::window_resize(uint32_t window_id, unsigned char* data, uint64_t size, double width, double height)
+void Connector::window_update_rects(uint32_t window_id, const unsigned char* buffer, size_t stride, std::vector<WindowUpdateRect> rects, BufferRelease release)
+{
+    if (rects.empty()) {
+        if (release != nullptr) {
+            release();
+        }
+        return;
+    }
+    TraceSpan span("client update_rects");
+    auto stamp = make_update_stamp();
+    auto flow_id = get_update_flow_id(getpid(), stamp.id);
+    span.add_flow(TraceFlowStart, flow_id);
+    if (_submitter == nullptr) {
+        ReleaseGuard guard { release };
+        send_update_rects(window_id, buffer, stride, 0, 0, rects, stamp);
+        return;
+    }
+    /* Without a release only the rows under the rects are copied, from their bounding rect. */
+    uint32_t buffer_x = 0, buffer_y = 0;
+    std::shared_ptr<unsigned char[]> copy;
+    if (release == nullptr) {
+        TraceSpan copy_span("copy buffer");
+        auto left = rects[0].x, top = rects[0].y, right = rects[0].x + rects[0].width, bottom = rects[0].y + rects[0].height;
+        for (auto& r : rects) {
+            left = std::min(left, r.x);
+            top = std::min(top, r.y);
+            right = std::max(right, r.x + r.width);
+            bottom = std::max(bottom, r.y + r.height);
+        }
+        auto row_size = (size_t)(right - left) * 4;
+        copy = std::shared_ptr<unsigned char[]>(new unsigned char[row_size * (bottom - top)]);
+        for (uint32_t row = top; row < bottom; row++) {
+            std::memcpy(copy.get() + (row - top) * row_size, buffer + (size_t)row * stride + (size_t)left * 4, row_size);
+        }
+        buffer = copy.get();
+        stride = row_size;
+        buffer_x = left;
+        buffer_y = top;
+    }
+    _submitter->post_update([this, window_id, buffer, stride, buffer_x, buffer_y, rects = std::move(rects), stamp, flow_id, copy, release = std::move(release)]() {
+        TraceSpan submit_span("client submit update_rects");
+        submit_span.add_flow(TraceFlowStep, flow_id);
+        ReleaseGuard guard { release };
+        send_update_rects(window_id, buffer, stride, buffer_x, buffer_y, rects, stamp);
+    });
+}
+
+void Connector::send_update_rects(uint32_t window_id, const unsigned char* buffer, size_t stride, uint32_t buffer_x, uint32_t buffer_y, std::vector<WindowUpdateRect> rects, const UpdateStamp& stamp)
 {
     auto w = _windows[window_id];
-    _listener->send_listener_payload(WindowResizePayload(w.id, width, height, size, w.shared_memory_id).get_payload());
-    _listener->send_data(data, size);
+
+    size_t pixels_size = 0;
+    for (auto& r : rects) {
+        pixels_size += (size_t)r.width * r.height * 4;
+    }
+    if (rects.size() > WINDOW_UPDATE_RECTS_MAX || rects.size() * sizeof(WindowUpdateRect) + pixels_size > w.shared_memory_size) {
+        /* Too many or too large overlapping rects, send their bounding rect instead. */
+        auto left = rects[0].x, top = rects[0].y, right = rects[0].x + rects[0].width, bottom = rects[0].y + rects[0].height;
+        for (auto& r : rects) {
+            left = std::min(left, r.x);
+            top = std::min(top, r.y);
+            right = std::max(right, r.x + r.width);
+            bottom = std::max(bottom, r.y + r.height);
+        }
+        rects = { { left, top, right - left, bottom - top } };
+        pixels_size = (size_t)(right - left) * (bottom - top) * 4;
+    }
+
+    auto table_size = rects.size() * sizeof(WindowUpdateRect);
+    if (table_size + pixels_size > w.shared_memory_size) {
+        std::cout << __func__ << ": update of " << pixels_size << " bytes does not fit in shared memory" << std::endl;
+        return;
+    }
+
+    TraceSpan copy_span("copy");
+    std::memcpy(w.shared_memory, rects.data(), table_size);
+    auto destination = w.shared_memory + table_size;
+    for (auto& r : rects) {
+        auto row_size = (size_t)r.width * 4;
+        auto source = buffer + (size_t)(r.y - buffer_y) * stride + (size_t)(r.x - buffer_x) * 4;
+        for (uint32_t row = 0; row < r.height; row++) {
+            w.converter->convert(source, destination, r.width);
+            source += stride;
+            destination += row_size;
+        }
+    }
+    copy_span.end();
+    TraceSpan send_span("send");
+    auto payload = WindowUpdateRectsPayload(window_id, rects.size(), table_size + pixels_size, w.shared_memory_id);
+    payload.set_update_stamp(stamp);
+    _listener->send_listener_payload(payload.get_payload());
+}
+
+void Connector::window_resize(uint32_t window_id, unsigned char* data, uint64_t size, double width, double height)
+{
+    submit_and_wait([&]() {
+        auto w = _windows[window_id];
+        auto pixels = convert_pixels(w, data, size);
+        _listener->send_listener_payload(WindowResizePayload(w.id, width, height, size, w.shared_memory_id).get_payload());
+        _listener->send_data(pixels, size);
+    });
+}
+
+void Connector::window_resize_buffer(uint32_t window_id, unsigned char* data, size_t size, double width, double height)
+{
+    submit_and_wait([&]() {
+        auto w = _windows[window_id];
+        if (size > w.shared_memory_size) {
+            std::cout << "window_resize_buffer: buffer of " << size << " bytes does not fit in shared memory" << std::endl;
+            return;
+        }
+        w.converter->convert(data, w.shared_memory, size / 4);
+        _listener->send_listener_payload(WindowResizeBufferPayload(w.id, width, height, size, w.shared_memory_id).get_payload());
+    });
 }
 
 void Connector::window_change_visiblity(uint32_t window_id, bool visible)
 {
-    _listener->send_listener_payload(WindowSetVisibilityPayload(window_id, visible).get_payload());
+    submit([this, window_id, visible]() {
+        _listener->send_listener_payload(WindowSetVisibilityPayload(window_id, visible).get_payload());
+    });
 }
 
 void Connector::window_bring_to_front(uint32_t window_id)
 {
-    _listener->send_listener_payload(WindowBringToFrontPayload(window_id).get_payload());
+    submit([this, window_id]() {
+        _listener->send_listener_payload(WindowBringToFrontPayload(window_id).get_payload());
+    });
 }
 
 void Connector::window_move(uint32_t window_id, double x, double y)
 {
-    _listener->send_listener_payload(WindowMovePayload(window_id, x, y).get_payload());
+    submit([this, window_id, x, y]() {
+        _listener->send_listener_payload(WindowMovePayload(window_id, x, y).get_payload());
+    });
 }
 
 void Connector::window_destroy(uint32_t window_id)
 {
-    auto w = _windows[window_id];
-    _listener->send_listener_payload(WindowDestroyPayload(w.id).get_payload());
-    shmdt(w.shared_memory);
-    _windows.erase(_windows.find(w.id));
-}
-
-std::shared_ptr<Event> Connector::event_wait()
-{
-    auto p = _publisher->recv_publisher_payload();
-    if (p.type == EventTypeMouseMove) {
-        return std::make_shared<MouseMoveEvent>(p);
-    } else if (p.type == EventTypeMouseButton) {
-        return std::make_shared<MouseButtonEvent>(p);
-    } else if (p.type == EventTypeMouseScroll) {
-        return std::make_shared<MouseScrollEvent>(p);
-    } else if (p.type == EventTypeKey) {
-        return std::make_shared<KeyEvent>(p);
-    } else if (p.type == EventTypeText) {
-        auto text = _publisher->recv_rext((size_t)p.field0);
-        auto event = std::make_shared<TextEvent>(p);
-        event->set_text(text.get());
-        return event;
-    }
-    return nullptr;
+    submit([this, window_id]() {
+        auto w = _windows[window_id];
+        _listener->send_listener_payload(WindowDestroyPayload(w.id).get_payload());
+        shmdt(w.shared_memory);
+        _windows.erase(_windows.find(w.id));
+    });
+}
+
+const Event& Connector::event_wait()
+{
+    event_poll(1, -1);
+    return _events[0];
+}
+
+size_t Connector::event_poll(size_t max, int timeout_ms)
+{
+    _events.clear();
+    _history_offsets.clear();
+    _history_samples.clear();
+    if (_early_payload.has_value() && max > 0) {
+        receive_event(*_early_payload);
+        _early_payload.reset();
+    }
+    PublisherPayload p {};
+    while (_events.size() < max) {
+        if (_publisher->try_recv_publisher_payload(p)) {
+            receive_event(p);
+        } else if (!_events.empty() || !_publisher->poll(timeout_ms)) {
+            break;
+        }
+    }
+    return _events.size();
+}
+
+void Connector::receive_event(const PublisherPayload& p)
+{
+    if (take_compositor_info(p)) {
+        return;
+    }
+    auto& event = _events.emplace_back(event_from_payload(p));
+    _history_offsets.push_back(_history_samples.size());
+    record_input_latency(event);
+    if (event.type == EventTypeFramePresented && event.frame.presented > event.frame.update.submitted) {
+        _frame_latency.record(event.frame.presented - event.frame.update.submitted);
+    }
+    /* Text and samples are further parts of the same message, already queued. */
+    if (event.type == EventTypeText) {
+        auto size = _publisher->recv_data(event.text.text, EVENT_TEXT_SIZE - 1);
+        event.text.text[std::min(size, EVENT_TEXT_SIZE - 1)] = 0;
+    } else if (event.type == EventTypeMouseHistory) {
+        auto offset = _history_samples.size();
+        _history_samples.resize(offset + event.history.sample_count);
+        _publisher->recv_data(_history_samples.data() + offset, event.history.sample_count * sizeof(MouseMoveSample));
+    }
+}
+
+const Event& Connector::get_event(size_t index) const
+{
+    return _events[index];
+}
+
+const MouseMoveSample* Connector::get_history_samples(size_t index) const
+{
+    return _history_samples.data() + _history_offsets[index];
+}
+
+void Connector::record_input_latency(Event& event)
+{
+    auto& times = event.stage_times;
+    if (times.received == 0 || times.routed == 0 || times.published == 0) {
+        return;
+    }
+    times.dequeued = get_monotonic_time_ns();
+    _route_latency.record(times.routed - times.received);
+    _dispatch_latency.record(times.published - times.routed);
+    _transport_latency.record(times.dequeued - times.published);
+    _total_latency.record(times.dequeued - times.received);
+}
+
+InputLatency Connector::get_input_latency() const
+{
+    return { _route_latency.get_summary(), _dispatch_latency.get_summary(), _transport_latency.get_summary(), _total_latency.get_summary() };
+}
+
+void Connector::reset_input_latency()
+{
+    _route_latency.reset();
+    _dispatch_latency.reset();
+    _transport_latency.reset();
+    _total_latency.reset();
+}
+
+int Connector::get_fd() const
+{
+    return _publisher->get_fd();
+}
+
+unsigned char* Connector::convert_pixels(const Window& w, unsigned char* data, size_t size)
+{
+    if (w.converter == nullptr || w.converter->is_identity()) {
+        return data;
+    }
+    _converted_pixels.resize(size);
+    w.converter->convert(data, _converted_pixels.data(), size / 4);
+    return _converted_pixels.data();
+}
+
+void Connector::set_pointer_history(bool enabled)
+{
+    submit([this, enabled]() {
+        _listener->send_listener_payload(ClientSetPointerHistoryPayload(getpid(), enabled).get_payload());
+    });
+}
+
+void Connector::set_async_submission(bool enabled)
+{
+    if (!enabled) {
+        /* Sends what is still queued before the caller's thread takes over again. */
+        _submitter = nullptr;
+    } else if (_submitter == nullptr) {
+        _submitter = std::make_unique<Submitter>();
+    }
+}
+
+void Connector::flush()
+{
+    if (_submitter != nullptr) {
+        _submitter->wait();
+    }
+}
+
+void Connector::submit(std::function<void()> job)
+{
+    if (_submitter == nullptr) {
+        job();
+    } else {
+        _submitter->post(std::move(job));
+    }
+}
+
+void Connector::submit_and_wait(const std::function<void()>& job)
+{
+    if (_submitter == nullptr) {
+        job();
+        return;
+    }
+    std::exception_ptr error;
+    _submitter->post([&job, &error]() {
+        try {
+            job();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    });
+    _submitter->wait();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void Connector::set_frame_acknowledgements(bool enabled)
+{
+    _frame_acknowledgements = enabled;
+}
+
+UpdateStamp Connector::make_update_stamp()
+{
+    if (!_frame_acknowledgements && !Tracer::get().is_enabled()) {
+        return {};
+    }
+    return { ++_update_id, get_monotonic_time_ns(), _frame_acknowledgements };
+}
+
+LatencySummary Connector::get_frame_latency() const
+{
+    return _frame_latency.get_summary();
+}
+
+void Connector::reset_frame_latency()
+{
+    _frame_latency.reset();
+}
+
+WindowRasterType Connector::get_native_raster_type()
+{
+    wait_for_compositor_info();
+    return _native_raster_type;
+}
+
+void Connector::wait_for_compositor_info()
+{
+    if (_compositor_info_received) {
+        return;
+    }
+    PublisherPayload p {};
+    auto received = _publisher->try_recv_publisher_payload(p);
+    if (!received && _publisher->poll(COMPOSITOR_INFO_TIMEOUT_MS)) {
+        received = _publisher->try_recv_publisher_payload(p);
+    }
+    if (!received) {
+        std::cout << "No compositor info within " << COMPOSITOR_INFO_TIMEOUT_MS << " ms, falling back to the "
+                  << PixelConverter::get_raster_type_name(_native_raster_type) << " raster type" << std::endl;
+        _compositor_info_received = true;
+        return;
+    }
+    /* Anything else came from a compositor without the info, it is handed out by the next event_poll(). */
+    if (!take_compositor_info(p)) {
+        _early_payload = p;
+    }
+}
+
+bool Connector::take_compositor_info(const PublisherPayload& p)
+{
+    if (p.type == EventTypeCompositorInfo) {
+        _native_raster_type = event_from_payload(p).info.native_raster_type;
+        _compositor_info_received = true;
+        std::cout << "Compositor native raster type is " << PixelConverter::get_raster_type_name(_native_raster_type) << std::endl;
+        return true;
+    }
+    if (!_compositor_info_received) {
+        std::cout << "Compositor sent no info, falling back to the " << PixelConverter::get_raster_type_name(_native_raster_type)
+                  << " raster type" << std::endl;
+        _compositor_info_received = true;
+    }
+    return false;
 }
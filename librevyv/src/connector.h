@@ -1,13 +1,18 @@
 #ifndef REVYV_CONNECTOR_H
 #define REVYV_CONNECTOR_H
 
+#include "pixel_converter.h"
 #include "socket.h"
+#include "submitter.h"
 #include <cerrno>
 #include <cstddef>
 #include <compositor/types.h>
+#include <compositor/latency_histogram.h>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unistd.h>
 #include <unordered_map>
@@ -21,8 +26,22 @@ typedef struct
     uint32_t id;
     int shared_memory_id;
     unsigned char* shared_memory;
+    size_t shared_memory_size;
+    std::shared_ptr<PixelConverter> converter;
 } Window;
 
+/* Per stage latency of the input events received, see EventStageTimes. */
+typedef struct
+{
+    LatencySummary route;
+    LatencySummary dispatch;
+    LatencySummary transport;
+    LatencySummary total;
+} InputLatency;
+
+/* Called once librevyv no longer reads the buffer of a pixel update. */
+typedef std::function<void()> BufferRelease;
+
 class Connector {
 public:
     Connector();
@@ -31,10 +50,19 @@ public:
 
     uint32_t window_create(unsigned char* data, size_t size, double x, double y, double width, double height, WindowRasterType raster_type);
 
-    void window_update_pixels(uint32_t window_id, unsigned char* data, size_t size, double x, double y, double width, double height);
+    /*
+     * With asynchronous submission and a release, the buffer is read on the
+     * submission thread until release is called there. Without a release
+     * what is sent is copied first.
+     */
+    void window_update_pixels(uint32_t window_id, unsigned char* data, size_t size, double x, double y, double width, double height, BufferRelease release = nullptr);
+
+    void window_update_rects(uint32_t window_id, const unsigned char* buffer, size_t stride, std::vector<WindowUpdateRect> rects, BufferRelease release = nullptr);
 
     void window_resize(uint32_t window_id, unsigned char* data, uint64_t size, double width, double height);
 
+    void window_resize_buffer(uint32_t window_id, unsigned char* data, size_t size, double width, double height);
+
     void window_change_visiblity(uint32_t window_id, bool visible);
 
     void window_bring_to_front(uint32_t window_id);
@@ -43,13 +71,100 @@ public:
 
     void window_destroy(uint32_t window_id);
 
-    std::shared_ptr<Event> event_wait();
+    /* The event stays valid until the next call. */
+    const Event& event_wait();
+
+    /*
+     * Receives up to max events, waiting at most timeout_ms for the first one,
+     * -1 waits forever. The events stay valid until the next call.
+     */
+    size_t event_poll(size_t max, int timeout_ms);
+
+    [[nodiscard]] const Event& get_event(size_t index) const;
+
+    /* Samples of the EventTypeMouseHistory event at index. */
+    [[nodiscard]] const MouseMoveSample* get_history_samples(size_t index) const;
+
+    [[nodiscard]] int get_fd() const;
+
+    [[nodiscard]] InputLatency get_input_latency() const;
+
+    void reset_input_latency();
+
+    void set_pointer_history(bool enabled);
+
+    /* Asks for an EventTypeFramePresented for every pixel update sent from now on. */
+    void set_frame_acknowledgements(bool enabled);
+
+    /* From submitting a pixel update to the compositor presenting it, for acknowledged updates. */
+    [[nodiscard]] LatencySummary get_frame_latency() const;
+
+    void reset_frame_latency();
+
+    /* Waits briefly for the compositor to tell it, the first time. */
+    [[nodiscard]] WindowRasterType get_native_raster_type();
+
+    /*
+     * Window calls return at once and are sent in order by a thread of
+     * their own. Calls returning something or reading a buffer without a
+     * release, like window_create() and window_resize(), wait for the ones
+     * before them. Events are still received on the caller's thread.
+     */
+    void set_async_submission(bool enabled);
+
+    /* Until every window call made so far has been sent. */
+    void flush();
+
+private:
+    /* Runs job in order with the queued window calls, right away without asynchronous submission. */
+    void submit(std::function<void()> job);
+
+    /* Same, and waits for it to run. */
+    void submit_and_wait(const std::function<void()>& job);
+
+    uint32_t send_window_create(unsigned char* data, size_t size, double x, double y, double width, double height, WindowRasterType raster_type);
+
+    void send_update_pixels(uint32_t window_id, unsigned char* data, size_t size, double x, double y, double width, double height, const UpdateStamp& stamp);
+
+    /* buffer holds the window's pixels from buffer_x, buffer_y on. */
+    void send_update_rects(uint32_t window_id, const unsigned char* buffer, size_t stride, uint32_t buffer_x, uint32_t buffer_y, std::vector<WindowUpdateRect> rects, const UpdateStamp& stamp);
+
+    unsigned char* convert_pixels(const Window& w, unsigned char* data, size_t size);
+
+    void receive_event(const PublisherPayload& p);
+
+    /* The compositor's info is the first event it sends, taken on first use rather than when connecting. */
+    void wait_for_compositor_info();
+
+    /* Returns false for any other event. The first event settles the native raster type either way. */
+    bool take_compositor_info(const PublisherPayload& p);
+
+    void record_input_latency(Event& event);
+
+    [[nodiscard]] UpdateStamp make_update_stamp();
 
 private:
     std::shared_ptr<Socket> _compositor;
     std::shared_ptr<Socket> _listener;
     std::shared_ptr<Socket> _publisher;
     std::unordered_map<uint32_t, Window> _windows;
+    WindowRasterType _native_raster_type = WindowRasterARGB;
+    bool _compositor_info_received = false;
+    std::optional<PublisherPayload> _early_payload;
+    std::vector<unsigned char> _converted_pixels;
+    /* Reused by every event_poll(), the C API hands out pointers into them. */
+    std::vector<Event> _events;
+    std::vector<size_t> _history_offsets;
+    std::vector<MouseMoveSample> _history_samples;
+    LatencyHistogram _route_latency;
+    LatencyHistogram _dispatch_latency;
+    LatencyHistogram _transport_latency;
+    LatencyHistogram _total_latency;
+    bool _frame_acknowledgements = false;
+    uint64_t _update_id = 0;
+    LatencyHistogram _frame_latency;
+    /* Last, so it sends what is queued before the sockets and windows go. */
+    std::unique_ptr<Submitter> _submitter;
 };
 }
 
@@ -0,0 +1,384 @@
+#include "pixel_converter.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REVYV_PIXEL_CONVERTER_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define REVYV_PIXEL_CONVERTER_NEON
+#endif
+
+using namespace revyv;
+
+typedef enum {
+    ChannelRed = 0,
+    ChannelGreen = 1,
+    ChannelBlue = 2,
+    ChannelAlpha = 3,
+} Channel;
+
+/* Raster types are named after the packed 32-bit value, most significant channel first. */
+static uint8_t get_channel_byte(WindowRasterType raster_type, Channel channel)
+{
+    static const Channel orders[][4] = {
+        { ChannelRed, ChannelGreen, ChannelBlue, ChannelAlpha },
+        { ChannelAlpha, ChannelRed, ChannelGreen, ChannelBlue },
+        { ChannelAlpha, ChannelBlue, ChannelGreen, ChannelRed },
+        { ChannelBlue, ChannelGreen, ChannelRed, ChannelAlpha },
+    };
+    int index = 1;
+    if (raster_type == WindowRasterRGBA) {
+        index = 0;
+    } else if (raster_type == WindowRasterABGR) {
+        index = 2;
+    } else if (raster_type == WindowRasterBGRA) {
+        index = 3;
+    }
+    for (uint8_t position = 0; position < 4; position++) {
+        if (orders[index][position] == channel) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return position;
+#else
+            return 3 - position;
+#endif
+        }
+    }
+    return 0;
+}
+
+static inline uint8_t premultiply(uint32_t color, uint32_t alpha)
+{
+    uint32_t t = color * alpha + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+/*
+ * The SIMD kernels compute the same quotient in single precision: numerator
+ * and alpha are exact, and a correctly rounded division never crosses an
+ * integer at these magnitudes, so truncating it gives the integer division.
+ */
+static inline uint8_t unpremultiply(uint32_t color, uint32_t alpha)
+{
+    if (alpha == 0) {
+        return 0;
+    }
+    return (uint8_t)std::min<uint32_t>(255, (color * 255 + alpha / 2) / alpha);
+}
+
+static void convert_scalar(const unsigned char* source, unsigned char* destination, size_t pixel_count, const uint8_t* shuffle, uint8_t alpha_index, PixelAlphaOperation alpha_operation)
+{
+    for (size_t i = 0; i < pixel_count; i++) {
+        const unsigned char* s = source + i * 4;
+        unsigned char* d = destination + i * 4;
+        uint8_t pixel[4] = { s[shuffle[0]], s[shuffle[1]], s[shuffle[2]], s[shuffle[3]] };
+        if (alpha_operation != PixelAlphaKeep) {
+            uint8_t alpha = pixel[alpha_index];
+            for (uint8_t c = 0; c < 4; c++) {
+                if (c != alpha_index) {
+                    pixel[c] = alpha_operation == PixelAlphaPremultiply ? premultiply(pixel[c], alpha) : unpremultiply(pixel[c], alpha);
+                }
+            }
+        }
+        d[0] = pixel[0];
+        d[1] = pixel[1];
+        d[2] = pixel[2];
+        d[3] = pixel[3];
+    }
+}
+
+#ifdef REVYV_PIXEL_CONVERTER_X86
+
+__attribute__((target("sse4.1"))) static void convert_sse4(const unsigned char* source, unsigned char* destination, size_t pixel_count, const uint8_t* shuffle, uint8_t alpha_index, PixelAlphaOperation alpha_operation)
+{
+    alignas(16) uint8_t shuffle_mask[16];
+    alignas(16) uint8_t alpha_mask[16];
+    alignas(16) uint8_t alpha_lanes[16];
+    alignas(16) uint8_t alpha_float_mask[16];
+    alignas(16) int32_t alpha_float_lanes[4];
+    for (int i = 0; i < 16; i++) {
+        shuffle_mask[i] = (uint8_t)((i & ~3) + shuffle[i & 3]);
+        alpha_mask[i] = (uint8_t)((i & ~3) + alpha_index);
+        alpha_lanes[i] = (i & 3) == alpha_index ? 0xff : 0;
+        alpha_float_mask[i] = (uint8_t)(alpha_index * 4 + (i & 3));
+    }
+    for (int i = 0; i < 4; i++) {
+        alpha_float_lanes[i] = i == alpha_index ? -1 : 0;
+    }
+    const __m128i shuffle_vector = _mm_load_si128((const __m128i*)shuffle_mask);
+    const __m128i alpha_vector = _mm_load_si128((const __m128i*)alpha_mask);
+    const __m128i alpha_lane_vector = _mm_load_si128((const __m128i*)alpha_lanes);
+    const __m128i alpha_float_vector = _mm_load_si128((const __m128i*)alpha_float_mask);
+    const __m128 alpha_float_lane_vector = _mm_castsi128_ps(_mm_load_si128((const __m128i*)alpha_float_lanes));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+
+    size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + i * 4)), shuffle_vector);
+        if (alpha_operation == PixelAlphaPremultiply) {
+            __m128i alpha = _mm_shuffle_epi8(pixels, alpha_vector);
+            __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi8(alpha, zero)), half);
+            __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi8(alpha, zero)), half);
+            low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+            high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+            pixels = _mm_blendv_epi8(_mm_packus_epi16(low, high), pixels, alpha_lane_vector);
+        } else if (alpha_operation == PixelAlphaUnpremultiply) {
+            const __m128 values[4] = {
+                _mm_cvtepi32_ps(_mm_cvtepu8_epi32(pixels)),
+                _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, 4))),
+                _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, 8))),
+                _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, 12))),
+            };
+            __m128i results[4];
+            for (int p = 0; p < 4; p++) {
+                __m128 alpha = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(values[p]), alpha_float_vector));
+                __m128 numerator = _mm_add_ps(_mm_mul_ps(values[p], _mm_set1_ps(255.0f)), _mm_floor_ps(_mm_mul_ps(alpha, _mm_set1_ps(0.5f))));
+                __m128 result = _mm_min_ps(_mm_div_ps(numerator, alpha), _mm_set1_ps(255.0f));
+                result = _mm_andnot_ps(_mm_cmpeq_ps(alpha, _mm_setzero_ps()), result);
+                result = _mm_blendv_ps(result, values[p], alpha_float_lane_vector);
+                results[p] = _mm_cvttps_epi32(result);
+            }
+            pixels = _mm_packus_epi16(_mm_packus_epi32(results[0], results[1]), _mm_packus_epi32(results[2], results[3]));
+        }
+        _mm_storeu_si128((__m128i*)(destination + i * 4), pixels);
+    }
+    convert_scalar(source + i * 4, destination + i * 4, pixel_count - i, shuffle, alpha_index, alpha_operation);
+}
+
+__attribute__((target("avx2"))) static void convert_avx2(const unsigned char* source, unsigned char* destination, size_t pixel_count, const uint8_t* shuffle, uint8_t alpha_index, PixelAlphaOperation alpha_operation)
+{
+    alignas(32) uint8_t shuffle_mask[32];
+    alignas(32) uint8_t alpha_mask[32];
+    alignas(32) uint8_t alpha_lanes[32];
+    alignas(32) uint8_t alpha_float_mask[32];
+    alignas(32) int32_t alpha_float_lanes[8];
+    for (int i = 0; i < 32; i++) {
+        shuffle_mask[i] = (uint8_t)((i & 15 & ~3) + shuffle[i & 3]);
+        alpha_mask[i] = (uint8_t)((i & 15 & ~3) + alpha_index);
+        alpha_lanes[i] = (i & 3) == alpha_index ? 0xff : 0;
+        alpha_float_mask[i] = (uint8_t)(alpha_index * 4 + (i & 3));
+    }
+    for (int i = 0; i < 8; i++) {
+        alpha_float_lanes[i] = (i & 3) == alpha_index ? -1 : 0;
+    }
+    const __m256i shuffle_vector = _mm256_load_si256((const __m256i*)shuffle_mask);
+    const __m256i alpha_vector = _mm256_load_si256((const __m256i*)alpha_mask);
+    const __m256i alpha_lane_vector = _mm256_load_si256((const __m256i*)alpha_lanes);
+    const __m256i alpha_float_vector = _mm256_load_si256((const __m256i*)alpha_float_mask);
+    const __m256 alpha_float_lane_vector = _mm256_castsi256_ps(_mm256_load_si256((const __m256i*)alpha_float_lanes));
+    const __m256i pixel_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+
+    size_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8) {
+        __m256i pixels = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(source + i * 4)), shuffle_vector);
+        if (alpha_operation == PixelAlphaPremultiply) {
+            __m256i alpha = _mm256_shuffle_epi8(pixels, alpha_vector);
+            __m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), _mm256_unpacklo_epi8(alpha, zero)), half);
+            __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), _mm256_unpackhi_epi8(alpha, zero)), half);
+            low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+            high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+            pixels = _mm256_blendv_epi8(_mm256_packus_epi16(low, high), pixels, alpha_lane_vector);
+        } else if (alpha_operation == PixelAlphaUnpremultiply) {
+            alignas(32) uint8_t bytes[32];
+            _mm256_store_si256((__m256i*)bytes, pixels);
+            __m256i results[4];
+            for (int p = 0; p < 4; p++) {
+                /* Two pixels per iteration, one in each 128-bit lane. */
+                __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(bytes + p * 8))));
+                __m256 alpha = _mm256_castsi256_ps(_mm256_shuffle_epi8(_mm256_castps_si256(values), alpha_float_vector));
+                __m256 numerator = _mm256_add_ps(_mm256_mul_ps(values, _mm256_set1_ps(255.0f)), _mm256_floor_ps(_mm256_mul_ps(alpha, _mm256_set1_ps(0.5f))));
+                __m256 result = _mm256_min_ps(_mm256_div_ps(numerator, alpha), _mm256_set1_ps(255.0f));
+                result = _mm256_andnot_ps(_mm256_cmp_ps(alpha, _mm256_setzero_ps(), _CMP_EQ_OQ), result);
+                result = _mm256_blendv_ps(result, values, alpha_float_lane_vector);
+                results[p] = _mm256_cvttps_epi32(result);
+            }
+            /* Packing works within lanes, which interleaves the pixels of both lanes. */
+            pixels = _mm256_packus_epi16(_mm256_packus_epi32(results[0], results[1]), _mm256_packus_epi32(results[2], results[3]));
+            pixels = _mm256_permutevar8x32_epi32(pixels, pixel_order);
+        }
+        _mm256_storeu_si256((__m256i*)(destination + i * 4), pixels);
+    }
+    convert_sse4(source + i * 4, destination + i * 4, pixel_count - i, shuffle, alpha_index, alpha_operation);
+}
+
+#endif
+
+#ifdef REVYV_PIXEL_CONVERTER_NEON
+
+static inline uint8x16_t premultiply_neon(uint8x16_t color, uint8x16_t alpha)
+{
+    const uint16x8_t half = vdupq_n_u16(128);
+    uint16x8_t low = vaddq_u16(vmull_u8(vget_low_u8(color), vget_low_u8(alpha)), half);
+    uint16x8_t high = vaddq_u16(vmull_high_u8(color, alpha), half);
+    return vcombine_u8(vshrn_n_u16(vaddq_u16(low, vshrq_n_u16(low, 8)), 8), vshrn_n_u16(vaddq_u16(high, vshrq_n_u16(high, 8)), 8));
+}
+
+static inline uint32x4_t unpremultiply_neon_quarter(uint16x4_t color, uint16x4_t alpha)
+{
+    float32x4_t alpha_values = vcvtq_f32_u32(vmovl_u16(alpha));
+    float32x4_t numerator = vaddq_f32(vmulq_f32(vcvtq_f32_u32(vmovl_u16(color)), vdupq_n_f32(255.0f)), vrndmq_f32(vmulq_f32(alpha_values, vdupq_n_f32(0.5f))));
+    float32x4_t result = vminq_f32(vdivq_f32(numerator, alpha_values), vdupq_n_f32(255.0f));
+    uint32x4_t zero_alpha = vceqq_f32(alpha_values, vdupq_n_f32(0));
+    return vbicq_u32(vcvtq_u32_f32(result), zero_alpha);
+}
+
+static inline uint8x16_t unpremultiply_neon(uint8x16_t color, uint8x16_t alpha)
+{
+    uint16x8_t color_low = vmovl_u8(vget_low_u8(color));
+    uint16x8_t color_high = vmovl_high_u8(color);
+    uint16x8_t alpha_low = vmovl_u8(vget_low_u8(alpha));
+    uint16x8_t alpha_high = vmovl_high_u8(alpha);
+    uint16x8_t low = vcombine_u16(
+        vmovn_u32(unpremultiply_neon_quarter(vget_low_u16(color_low), vget_low_u16(alpha_low))),
+        vmovn_u32(unpremultiply_neon_quarter(vget_high_u16(color_low), vget_high_u16(alpha_low))));
+    uint16x8_t high = vcombine_u16(
+        vmovn_u32(unpremultiply_neon_quarter(vget_low_u16(color_high), vget_low_u16(alpha_high))),
+        vmovn_u32(unpremultiply_neon_quarter(vget_high_u16(color_high), vget_high_u16(alpha_high))));
+    return vcombine_u8(vmovn_u16(low), vmovn_u16(high));
+}
+
+static void convert_neon(const unsigned char* source, unsigned char* destination, size_t pixel_count, const uint8_t* shuffle, uint8_t alpha_index, PixelAlphaOperation alpha_operation)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        /* De-interleaving makes the shuffle a plain register permutation. */
+        uint8x16x4_t input = vld4q_u8(source + i * 4);
+        uint8x16x4_t output;
+        output.val[0] = input.val[shuffle[0]];
+        output.val[1] = input.val[shuffle[1]];
+        output.val[2] = input.val[shuffle[2]];
+        output.val[3] = input.val[shuffle[3]];
+        if (alpha_operation != PixelAlphaKeep) {
+            uint8x16_t alpha = output.val[alpha_index];
+            for (int c = 0; c < 4; c++) {
+                if (c != alpha_index) {
+                    output.val[c] = alpha_operation == PixelAlphaPremultiply ? premultiply_neon(output.val[c], alpha) : unpremultiply_neon(output.val[c], alpha);
+                }
+            }
+        }
+        vst4q_u8(destination + i * 4, output);
+    }
+    convert_scalar(source + i * 4, destination + i * 4, pixel_count - i, shuffle, alpha_index, alpha_operation);
+}
+
+#endif
+
+PixelConverter::PixelConverter(WindowRasterType from, WindowRasterType to, PixelAlphaOperation alpha_operation)
+    : PixelConverter(from, to, alpha_operation, get_best_path())
+{
+}
+
+PixelConverter::PixelConverter(WindowRasterType from, WindowRasterType to, PixelAlphaOperation alpha_operation, PixelConverterPath path)
+    : _alpha_operation(alpha_operation)
+    , _path(is_path_supported(path) ? path : PixelConverterPathScalar)
+{
+    for (auto channel : { ChannelRed, ChannelGreen, ChannelBlue, ChannelAlpha }) {
+        _shuffle[get_channel_byte(to, channel)] = get_channel_byte(from, channel);
+    }
+    _alpha_index = get_channel_byte(to, ChannelAlpha);
+    if (is_identity()) {
+        _path = PixelConverterPathNone;
+    }
+}
+
+void PixelConverter::convert(const unsigned char* source, unsigned char* destination, size_t pixel_count) const
+{
+    switch (_path) {
+#ifdef REVYV_PIXEL_CONVERTER_X86
+    case PixelConverterPathAVX2:
+        convert_avx2(source, destination, pixel_count, _shuffle, _alpha_index, _alpha_operation);
+        break;
+    case PixelConverterPathSSE4:
+        convert_sse4(source, destination, pixel_count, _shuffle, _alpha_index, _alpha_operation);
+        break;
+#endif
+#ifdef REVYV_PIXEL_CONVERTER_NEON
+    case PixelConverterPathNEON:
+        convert_neon(source, destination, pixel_count, _shuffle, _alpha_index, _alpha_operation);
+        break;
+#endif
+    case PixelConverterPathNone:
+        if (source != destination) {
+            std::copy(source, source + pixel_count * 4, destination);
+        }
+        break;
+    default:
+        convert_scalar(source, destination, pixel_count, _shuffle, _alpha_index, _alpha_operation);
+        break;
+    }
+}
+
+bool PixelConverter::is_identity() const
+{
+    return _alpha_operation == PixelAlphaKeep && _shuffle[0] == 0 && _shuffle[1] == 1 && _shuffle[2] == 2 && _shuffle[3] == 3;
+}
+
+PixelConverterPath PixelConverter::get_path() const
+{
+    return _path;
+}
+
+PixelConverterPath PixelConverter::get_best_path()
+{
+    for (auto path : { PixelConverterPathAVX2, PixelConverterPathNEON, PixelConverterPathSSE4 }) {
+        if (is_path_supported(path)) {
+            return path;
+        }
+    }
+    return PixelConverterPathScalar;
+}
+
+bool PixelConverter::is_path_supported(PixelConverterPath path)
+{
+    switch (path) {
+#ifdef REVYV_PIXEL_CONVERTER_X86
+    case PixelConverterPathAVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.1");
+    case PixelConverterPathSSE4:
+        return __builtin_cpu_supports("sse4.1");
+#endif
+#ifdef REVYV_PIXEL_CONVERTER_NEON
+    case PixelConverterPathNEON:
+        return true;
+#endif
+    case PixelConverterPathScalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char* PixelConverter::get_path_name(PixelConverterPath path)
+{
+    switch (path) {
+    case PixelConverterPathNone:
+        return "none";
+    case PixelConverterPathScalar:
+        return "scalar";
+    case PixelConverterPathSSE4:
+        return "sse4";
+    case PixelConverterPathAVX2:
+        return "avx2";
+    case PixelConverterPathNEON:
+        return "neon";
+    }
+    return "unknown";
+}
+
+const char* PixelConverter::get_raster_type_name(WindowRasterType raster_type)
+{
+    switch (raster_type) {
+    case WindowRasterRGBA:
+        return "RGBA";
+    case WindowRasterARGB:
+        return "ARGB";
+    case WindowRasterABGR:
+        return "ABGR";
+    case WindowRasterBGRA:
+        return "BGRA";
+    }
+    return "unknown";
+}
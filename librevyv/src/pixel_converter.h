@@ -0,0 +1,59 @@
+#ifndef REVYV_PIXELCONVERTER_H
+#define REVYV_PIXELCONVERTER_H
+
+#include <compositor/types.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace revyv {
+
+typedef enum : uint8_t {
+    PixelAlphaKeep = 0,
+    PixelAlphaPremultiply = 1,
+    PixelAlphaUnpremultiply = 2,
+} PixelAlphaOperation;
+
+typedef enum : uint8_t {
+    PixelConverterPathNone = 0,
+    PixelConverterPathScalar = 1,
+    PixelConverterPathSSE4 = 2,
+    PixelConverterPathAVX2 = 3,
+    PixelConverterPathNEON = 4,
+} PixelConverterPath;
+
+/*
+ * Converts 32-bit pixels between raster types, optionally premultiplying or
+ * unpremultiplying alpha on the way. The fastest kernel supported by the CPU
+ * is picked at runtime. Source and destination may be the same buffer.
+ */
+class PixelConverter {
+public:
+    PixelConverter(WindowRasterType from, WindowRasterType to, PixelAlphaOperation alpha_operation);
+
+    PixelConverter(WindowRasterType from, WindowRasterType to, PixelAlphaOperation alpha_operation, PixelConverterPath path);
+
+    void convert(const unsigned char* source, unsigned char* destination, size_t pixel_count) const;
+
+    /* Whether convert() changes anything at all. */
+    [[nodiscard]] bool is_identity() const;
+
+    [[nodiscard]] PixelConverterPath get_path() const;
+
+    [[nodiscard]] static PixelConverterPath get_best_path();
+
+    [[nodiscard]] static bool is_path_supported(PixelConverterPath path);
+
+    [[nodiscard]] static const char* get_path_name(PixelConverterPath path);
+
+    [[nodiscard]] static const char* get_raster_type_name(WindowRasterType raster_type);
+
+private:
+    uint8_t _shuffle[4] {};
+    uint8_t _alpha_index = 0;
+    PixelAlphaOperation _alpha_operation;
+    PixelConverterPath _path;
+};
+
+}
+
+#endif
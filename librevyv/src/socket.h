@@ -65,6 +65,13 @@ public:
         }
     }
 
+    bool poll(long timeout)
+    {
+        zmq::pollitem_t items[] = { { static_cast<void*>(*_socket), 0, ZMQ_POLLIN, 0 } };
+        zmq::poll(items, 1, std::chrono::milliseconds(timeout));
+        return items[0].revents & ZMQ_POLLIN;
+    }
+
     PublisherPayload recv_publisher_payload()
     {
         PublisherPayload p {};
@@ -75,17 +82,26 @@ public:
         return p;
     }
 
-    std::shared_ptr<char[]> recv_rext(size_t length)
+    /* Like recv_publisher_payload() but returns false instead of waiting when nothing is queued. */
+    bool try_recv_publisher_payload(PublisherPayload& p)
+    {
+        auto result = _socket->recv(zmq::mutable_buffer(&p, sizeof(PublisherPayload)), zmq::recv_flags::dontwait);
+        return result.has_value();
+    }
+
+    /* Receives one message into data, returns how many bytes were written. */
+    size_t recv_data(void* data, size_t size)
     {
-        std::shared_ptr<char[]> text(new char[length]);
-        auto result = _socket->recv(zmq::mutable_buffer(text.get(), (size_t)(length - 1)), zmq::recv_flags::none);
+        auto result = _socket->recv(zmq::mutable_buffer(data, size), zmq::recv_flags::none);
         if (!result.has_value()) {
-            return nullptr;
+            throw FailedToReceiveDataError();
         }
-        text[(int)(length - 1)] = 0;
-        return text;
+        return result->size;
     }
 
+    /* The zmq notification fd, edge triggered: readable means the socket must be drained. */
+    [[nodiscard]] int get_fd() const { return _socket->get(zmq::sockopt::fd); }
+
     [[nodiscard]] const std::string& get_url() const { return _url; }
 
 private:
@@ -0,0 +1,74 @@
+#include "submitter.h"
+#include <iostream>
+
+using namespace revyv;
+
+Submitter::Submitter()
+    : _thread([this]() { run(); })
+{
+}
+
+Submitter::~Submitter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _changed.notify_all();
+    _thread.join();
+}
+
+void Submitter::post(std::function<void()> job)
+{
+    enqueue(std::move(job), false);
+}
+
+void Submitter::post_update(std::function<void()> job)
+{
+    enqueue(std::move(job), true);
+}
+
+void Submitter::enqueue(std::function<void()> job, bool update)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (update) {
+            _changed.wait(lock, [this]() { return _pending_updates < MAX_PENDING_UPDATES; });
+            _pending_updates++;
+        }
+        _jobs.push_back({ std::move(job), update });
+    }
+    _changed.notify_all();
+}
+
+void Submitter::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _changed.wait(lock, [this]() { return _jobs.empty() && !_running_job; });
+}
+
+void Submitter::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _changed.wait(lock, [this]() { return !_jobs.empty() || _stopping; });
+        if (_jobs.empty()) {
+            return;
+        }
+        auto job = std::move(_jobs.front());
+        _jobs.pop_front();
+        _running_job = true;
+        lock.unlock();
+        try {
+            job.run();
+        } catch (std::exception& e) {
+            std::cout << __func__ << ": " << e.what() << std::endl;
+        }
+        lock.lock();
+        _running_job = false;
+        if (job.update) {
+            _pending_updates--;
+        }
+        _changed.notify_all();
+    }
+}
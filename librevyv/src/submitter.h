@@ -0,0 +1,61 @@
+#ifndef REVYV_SUBMITTER_H
+#define REVYV_SUBMITTER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace revyv {
+
+/*
+ * Runs a connector's window calls on a thread of its own, in the order they
+ * were made, so the caller returns before its updates are converted,
+ * compressed and sent. At most MAX_PENDING_UPDATES pixel updates wait in the
+ * queue, a caller getting ahead of the compositor waits for the oldest one
+ * rather than piling up frames that would only be presented late.
+ */
+class Submitter {
+public:
+    Submitter();
+
+    /* Runs what is still queued first. */
+    ~Submitter();
+
+    Submitter(const Submitter&) = delete;
+
+    Submitter& operator=(const Submitter&) = delete;
+
+    void post(std::function<void()> job);
+
+    void post_update(std::function<void()> job);
+
+    /* Until every job posted so far has run. */
+    void wait();
+
+private:
+    static constexpr size_t MAX_PENDING_UPDATES = 3;
+
+    typedef struct
+    {
+        std::function<void()> run;
+        bool update;
+    } Job;
+
+    void enqueue(std::function<void()> job, bool update);
+
+    void run();
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::deque<Job> _jobs;
+    size_t _pending_updates = 0;
+    bool _running_job = false;
+    bool _stopping = false;
+    std::thread _thread;
+};
+}
+
+#endif
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Sweeps load-client parameters against a headless compositor and reports what it sustains.
+
+Every combination of resolution, frame rate, damage pattern and windows per
+client is run with a growing number of concurrent clients, until the
+compositor stops presenting what they send or the latency goes over budget.
+
+  load_sweep.py --build-dir=build --resolutions=1920x1080 --fps=60 --damage=full,rect,scroll,noise \\
+      --windows=1 --clients=1,2,4,8,16 --duration=10 --report=report.md --json=results.json
+"""
+
+import argparse
+import itertools
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+# Presented frames below this share of the ones sent mean the compositor fell behind.
+SUSTAINED_RATIO = 0.95
+
+
+def parse_list(value, convert=str):
+    return [convert(item) for item in value.split(',') if item]
+
+
+def parse_resolution(value):
+    width, height = value.lower().split('x')
+    return int(width), int(height)
+
+
+def start_compositor(args):
+    command = [args.compositor, '--headless', '--width=%d' % args.screen[0], '--height=%d' % args.screen[1],
+               '--refresh-rate=%g' % args.refresh_rate, '--background-update-rate=%g' % args.background_update_rate,
+               '--latency-log-interval=0']
+    log = open(os.path.join(args.work_dir, 'compositor.log'), 'w')
+    compositor = subprocess.Popen(command, stdout=log, stderr=subprocess.STDOUT)
+    time.sleep(args.startup_delay)
+    if compositor.poll() is not None:
+        sys.exit('compositor exited at startup, see %s' % log.name)
+    return compositor
+
+
+def run_clients(args, width, height, fps, damage, windows, clients):
+    """Runs the clients side by side and returns their reports."""
+    processes = []
+    for index in range(clients):
+        out = os.path.join(args.work_dir, 'client-%d.json' % index)
+        if os.path.exists(out):
+            os.remove(out)
+        command = [args.load_client, '--width=%d' % width, '--height=%d' % height, '--fps=%g' % fps,
+                   '--damage=%s' % damage, '--windows=%d' % windows, '--duration=%g' % args.duration,
+                   '--warmup=%g' % args.warmup, '--out=%s' % out] + (['--async'] if args.async_submission else [])
+        processes.append((subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL), out))
+    reports = []
+    for process, out in processes:
+        process.wait(timeout=args.warmup + args.duration + 60)
+        if os.path.exists(out):
+            with open(out) as stream:
+                reports.append(json.load(stream))
+    return reports
+
+
+def summarize(args, width, height, fps, damage, windows, clients, reports):
+    expected = fps * windows * clients * args.duration
+    presented = sum(report['presented'] for report in reports)
+    p99 = max((report['latency']['p99_ms'] for report in reports), default=0)
+    sustained = len(reports) == clients and presented >= expected * SUSTAINED_RATIO and p99 <= args.latency_budget
+    return {
+        'width': width,
+        'height': height,
+        'fps': fps,
+        'damage': damage,
+        'windows': windows,
+        'clients': clients,
+        'finished_clients': len(reports),
+        'updates_per_second': sum(report['updates_per_second'] for report in reports),
+        'presented_per_second': sum(report['presented_per_second'] for report in reports),
+        'megabytes_per_second': sum(report['bytes_per_second'] for report in reports) / 1e6,
+        'late_frames': sum(report['late_frames'] for report in reports),
+        'p50_ms': statistics.median([report['latency']['p50_ms'] for report in reports]) if reports else 0,
+        'p99_ms': p99,
+        'max_ms': max((report['latency']['max_ms'] for report in reports), default=0),
+        'sustained': sustained,
+    }
+
+
+def write_report(stream, args, results):
+    stream.write('# Load sweep\n\n')
+    stream.write('Headless compositor at %dx%d, %g Hz. A run is sustained when at least %d%% of the frames sent are '
+                 'presented and the p99 submit to present latency is at most %g ms.\n\n'
+                 % (args.screen[0], args.screen[1], args.refresh_rate, SUSTAINED_RATIO * 100, args.latency_budget))
+    stream.write('## Capacity\n\n| Resolution | fps | Damage | Windows per client | Clients sustained |\n|---|---|---|---|---|\n')
+    for key, runs in itertools.groupby(results, lambda r: (r['width'], r['height'], r['fps'], r['damage'], r['windows'])):
+        sustained = [run['clients'] for run in runs if run['sustained']]
+        stream.write('| %dx%d | %g | %s | %d | %s |\n' % (key[0], key[1], key[2], key[3], key[4], max(sustained) if sustained else 'none'))
+    stream.write('\n## Runs\n\n| Resolution | fps | Damage | Windows | Clients | Sent/s | Presented/s | MB/s | Late | p50 ms | p99 ms | max ms | Sustained |\n'
+                 '|---|---|---|---|---|---|---|---|---|---|---|---|---|\n')
+    for r in results:
+        stream.write('| %dx%d | %g | %s | %d | %d | %.1f | %.1f | %.1f | %d | %.2f | %.2f | %.2f | %s |\n'
+                     % (r['width'], r['height'], r['fps'], r['damage'], r['windows'], r['clients'], r['updates_per_second'],
+                        r['presented_per_second'], r['megabytes_per_second'], r['late_frames'], r['p50_ms'], r['p99_ms'],
+                        r['max_ms'], 'yes' if r['sustained'] else 'no'))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--build-dir', default='build')
+    parser.add_argument('--compositor', help='defaults to <build-dir>/compositor/compositor')
+    parser.add_argument('--load-client', help='defaults to <build-dir>/librevyv/test/load-client')
+    parser.add_argument('--screen', type=parse_resolution, default=(1920, 1080))
+    parser.add_argument('--refresh-rate', type=float, default=60)
+    # Only the top window is in the foreground, the others would be throttled to this rate.
+    parser.add_argument('--background-update-rate', type=float, default=0)
+    parser.add_argument('--resolutions', type=lambda v: parse_list(v, parse_resolution), default=[(1920, 1080)])
+    parser.add_argument('--fps', type=lambda v: parse_list(v, float), default=[60])
+    parser.add_argument('--damage', type=parse_list, default=['full', 'rect', 'scroll', 'noise'])
+    parser.add_argument('--windows', type=lambda v: parse_list(v, int), default=[1])
+    parser.add_argument('--clients', type=lambda v: parse_list(v, int), default=[1, 2, 4, 8])
+    parser.add_argument('--duration', type=float, default=10)
+    parser.add_argument('--warmup', type=float, default=2)
+    parser.add_argument('--latency-budget', type=float, default=50, help='p99 submit to present milliseconds')
+    parser.add_argument('--startup-delay', type=float, default=1)
+    parser.add_argument('--async', dest='async_submission', action='store_true', help='clients send from a librevyv thread')
+    parser.add_argument('--report', default='load-report.md')
+    parser.add_argument('--json', default='load-results.json')
+    args = parser.parse_args()
+    args.compositor = args.compositor or os.path.join(args.build_dir, 'compositor', 'compositor')
+    args.load_client = args.load_client or os.path.join(args.build_dir, 'librevyv', 'test', 'load-client')
+    args.work_dir = tempfile.mkdtemp(prefix='revyv-load-')
+
+    compositor = start_compositor(args)
+    results = []
+    try:
+        for (width, height), fps, damage, windows in itertools.product(args.resolutions, args.fps, args.damage, args.windows):
+            for clients in sorted(args.clients):
+                reports = run_clients(args, width, height, fps, damage, windows, clients)
+                result = summarize(args, width, height, fps, damage, windows, clients, reports)
+                results.append(result)
+                print('%dx%d %g fps %s, %d windows x %d clients: %.1f presented/s, p99 %.2f ms, %s'
+                      % (width, height, fps, damage, windows, clients, result['presented_per_second'], result['p99_ms'],
+                         'sustained' if result['sustained'] else 'not sustained'), flush=True)
+                if not result['sustained']:
+                    # More clients won't do better.
+                    break
+    finally:
+        compositor.terminate()
+        compositor.wait()
+
+    with open(args.json, 'w') as stream:
+        json.dump(results, stream, indent=2)
+    with open(args.report, 'w') as stream:
+        write_report(stream, args, results)
+    print('Wrote %s and %s' % (args.report, args.json))
+
+
+if __name__ == '__main__':
+    main()
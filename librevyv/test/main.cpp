@@ -1,105 +1,291 @@
-#include <cairo/cairo.h>
+#include <algorithm>
+#include <argh.h>
 #include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <revyv/revyv.h>
-#include <thread>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
-#define SCREEN_WIDTH 1920.0
-#define SCREEN_HEIGHT 1080.0
-#define WINDOW_WIDTH 800.0
-#define WINDOW_HEIGHT 600.0
+/*
+ * Synthetic load client: opens windows, repaints them at a target rate with
+ * one damage pattern and reports what it achieved as JSON.
+ *
+ * load-client [--width=1920] [--height=1080] [--fps=60] [--damage=full|rect|scroll|noise]
+ *             [--windows=1] [--duration=<seconds measured>] [--warmup=<seconds before measuring>]
+ *             [--out=<JSON report file>] [--async]
+ */
 
-uint32_t create_window(void* revyv_ctx)
+typedef enum : uint8_t {
+    /* The whole window repainted with flat content, compresses well. */
+    DamageFull = 0,
+    /* A small square moving around, only its rect is sent. */
+    DamageRect = 1,
+    /* Lines of text scrolling up, the whole window is sent. */
+    DamageScroll = 2,
+    /* The whole window repainted with noise, which doesn't compress. */
+    DamageNoise = 3,
+} Damage;
+
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    double fps;
+    Damage damage;
+    uint32_t window_count;
+    double duration;
+    double warmup;
+    std::string out_path;
+    /* Sends from librevyv's submission thread, see revyv_context_set_async_submission(). */
+    bool async_submission;
+} LoadOptions;
+
+typedef struct
+{
+    uint32_t id;
+    std::vector<unsigned char> pixels;
+    /* The rect of DamageRect, packed. */
+    std::vector<unsigned char> rect_pixels;
+    uint64_t frame;
+    uint32_t random;
+} LoadWindow;
+
+typedef struct
+{
+    uint64_t updates_sent;
+    uint64_t bytes_sent;
+    uint64_t presented;
+    /* Frames the client itself could not paint in time. */
+    uint64_t late_frames;
+} LoadCounters;
+
+static const uint32_t RECT_SIZE = 64;
+static const uint32_t SCROLL_ROWS = 8;
+static const uint32_t LINE_HEIGHT = 20;
+
+static const char* get_damage_name(Damage damage)
+{
+    switch (damage) {
+    case DamageFull:
+        return "full";
+    case DamageRect:
+        return "rect";
+    case DamageScroll:
+        return "scroll";
+    case DamageNoise:
+        return "noise";
+    default:
+        return "unknown";
+    }
+}
+
+static Damage parse_damage(const std::string& name)
+{
+    for (auto damage : { DamageFull, DamageRect, DamageScroll, DamageNoise }) {
+        if (name == get_damage_name(damage)) {
+            return damage;
+        }
+    }
+    throw std::runtime_error("unknown damage pattern " + name + ", expected full, rect, scroll or noise");
+}
+
+static uint64_t get_time_ns()
 {
-    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, WINDOW_WIDTH, WINDOW_HEIGHT);
-    cairo_t* context = cairo_create(surface);
-    cairo_set_source_rgb(context, 0.80, 0.80, 0.80);
-    cairo_paint(context);
-    cairo_surface_flush(surface);
-
-    unsigned long data_size = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, cairo_image_surface_get_width(surface)) * cairo_image_surface_get_height(surface);
-    double new_x = SCREEN_WIDTH / 2 - WINDOW_WIDTH / 2;
-    double new_y = SCREEN_HEIGHT / 2 - WINDOW_HEIGHT / 2;
-    return revyv_window_create(revyv_ctx, cairo_image_surface_get_data(surface), data_size, new_x, new_y, WINDOW_WIDTH, WINDOW_HEIGHT, RevyvWindowRasterARGB);
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void fill_row(unsigned char* row, uint32_t width, uint32_t value)
+{
+    for (uint32_t x = 0; x < width; x++) {
+        std::memcpy(row + (size_t)x * 4, &value, 4);
+    }
 }
 
-void paint(void* revyv_ctx, uint32_t window_id, double x, double y)
+/* A line of dark glyph runs on a light background, different for every line number. */
+static void paint_text_row(unsigned char* row, uint32_t width, uint64_t line, uint32_t row_in_line)
 {
-    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, WINDOW_WIDTH, WINDOW_HEIGHT);
-    cairo_t* cairoCtx = cairo_create(surface);
+    fill_row(row, width, 0xfff4f4f4);
+    if (row_in_line < 5 || row_in_line > 15) {
+        return;
+    }
+    for (uint32_t x = 0; x < width; x++) {
+        auto glyph = (uint32_t)((x / 7 + line * 13) % 11);
+        if (glyph != 0 && ((x * 7 + row_in_line * 3 + line) % 5) < 2) {
+            uint32_t value = 0xff303030;
+            std::memcpy(row + (size_t)x * 4, &value, 4);
+        }
+    }
+}
 
-    cairo_set_source_rgb(cairoCtx, 0.80, 0.80, 0.80);
-    cairo_paint(cairoCtx);
+/* Repaints the window for the next frame and sends the damage. Returns the bytes sent. */
+static size_t paint(void* revyv_ctx, LoadWindow& window, const LoadOptions& options)
+{
+    auto stride = (size_t)options.width * 4;
+    auto frame = ++window.frame;
+    if (options.damage == DamageRect) {
+        auto x = (uint32_t)((frame * 8) % (options.width - RECT_SIZE));
+        auto y = (uint32_t)((frame * 5) % (options.height - RECT_SIZE));
+        auto value = 0xff000000 | (uint32_t)((frame * 0x050301) & 0xffffff);
+        for (uint32_t row = 0; row < RECT_SIZE; row++) {
+            fill_row(window.rect_pixels.data() + (size_t)row * RECT_SIZE * 4, RECT_SIZE, value);
+        }
+        revyv_window_update(revyv_ctx, window.id, window.rect_pixels.data(), window.rect_pixels.size(), x, y, RECT_SIZE, RECT_SIZE);
+        return window.rect_pixels.size();
+    }
+    if (options.damage == DamageFull) {
+        for (uint32_t y = 0; y < options.height; y++) {
+            auto shade = (uint32_t)((y / 4 + frame) & 0xff);
+            fill_row(window.pixels.data() + y * stride, options.width, 0xff000000 | shade << 16 | shade << 8 | 0x80);
+        }
+    } else if (options.damage == DamageScroll) {
+        auto rows = std::min(SCROLL_ROWS, options.height);
+        std::memmove(window.pixels.data(), window.pixels.data() + rows * stride, (options.height - rows) * stride);
+        for (uint32_t i = 0; i < rows; i++) {
+            auto content_row = (uint64_t)(frame * rows + options.height - rows + i);
+            paint_text_row(window.pixels.data() + (options.height - rows + i) * stride, options.width, content_row / LINE_HEIGHT, (uint32_t)(content_row % LINE_HEIGHT));
+        }
+    } else {
+        auto words = (uint32_t*)window.pixels.data();
+        for (size_t i = 0; i < (size_t)options.width * options.height; i++) {
+            /* xorshift32, much cheaper than painting with std::mt19937. */
+            window.random ^= window.random << 13;
+            window.random ^= window.random >> 17;
+            window.random ^= window.random << 5;
+            words[i] = 0xff000000 | window.random;
+        }
+    }
+    revyv_window_update(revyv_ctx, window.id, window.pixels.data(), window.pixels.size(), 0, 0, options.width, options.height);
+    return window.pixels.size();
+}
 
-    cairo_set_source_rgb(cairoCtx, 0.5, 0.5, 0.5);
-    cairo_rectangle(cairoCtx, x - 150, y - 150, 300, 300);
-    cairo_fill(cairoCtx);
+static LoadWindow create_window(void* revyv_ctx, const LoadOptions& options, uint32_t index)
+{
+    LoadWindow window {};
+    window.pixels.resize((size_t)options.width * options.height * 4);
+    window.rect_pixels.resize((size_t)RECT_SIZE * RECT_SIZE * 4);
+    window.random = 2463534242u + index;
+    auto stride = (size_t)options.width * 4;
+    for (uint32_t y = 0; y < options.height; y++) {
+        paint_text_row(window.pixels.data() + y * stride, options.width, y / LINE_HEIGHT, y % LINE_HEIGHT);
+    }
+    /* Cascaded, so the compositor has overlapping windows to deal with. */
+    auto offset = (double)(index * 32);
+    window.id = revyv_window_create(revyv_ctx, window.pixels.data(), window.pixels.size(), offset, offset, options.width, options.height, revyv_context_get_native_raster_type(revyv_ctx));
+    return window;
+}
 
-    cairo_surface_flush(surface);
+static void write_report(std::ostream& stream, const LoadOptions& options, const LoadCounters& counters, const RevyvLatencySummary& latency)
+{
+    auto seconds = options.duration;
+    stream << "{\"width\":" << options.width << ",\"height\":" << options.height << ",\"fps\":" << options.fps
+           << ",\"damage\":\"" << get_damage_name(options.damage) << "\",\"windows\":" << options.window_count
+           << ",\"async\":" << (options.async_submission ? "true" : "false")
+           << ",\"duration\":" << seconds << ",\"updates_sent\":" << counters.updates_sent
+           << ",\"updates_per_second\":" << (double)counters.updates_sent / seconds
+           << ",\"presented\":" << counters.presented << ",\"presented_per_second\":" << (double)counters.presented / seconds
+           << ",\"bytes_sent\":" << counters.bytes_sent << ",\"bytes_per_second\":" << (double)counters.bytes_sent / seconds
+           << ",\"late_frames\":" << counters.late_frames << ",\"latency\":{\"count\":" << latency.count
+           << ",\"p50_ms\":" << (double)latency.p50_ns / 1e6 << ",\"p99_ms\":" << (double)latency.p99_ns / 1e6
+           << ",\"max_ms\":" << (double)latency.max_ns / 1e6 << "}}" << std::endl;
+}
 
-    unsigned long data_size = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, cairo_image_surface_get_width(surface)) * cairo_image_surface_get_height(surface);
-    revyv_window_update(revyv_ctx, window_id, cairo_image_surface_get_data(surface), data_size, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+static LoadOptions parse_options(int argc, char** argv)
+{
+    argh::parser cmdl({ "--width", "--height", "--fps", "--damage", "--windows", "--duration", "--warmup", "--out" });
+    cmdl.parse(argc, argv);
+    LoadOptions options { 1920, 1080, 60, DamageFull, 1, 10, 1, "", false };
+    if (!cmdl("width").str().empty()) {
+        options.width = std::max(RECT_SIZE + 1, (uint32_t)std::atoi(cmdl("width").str().c_str()));
+    }
+    if (!cmdl("height").str().empty()) {
+        options.height = std::max(RECT_SIZE + 1, (uint32_t)std::atoi(cmdl("height").str().c_str()));
+    }
+    if (!cmdl("fps").str().empty()) {
+        options.fps = std::max(1.0, std::atof(cmdl("fps").str().c_str()));
+    }
+    if (!cmdl("damage").str().empty()) {
+        options.damage = parse_damage(cmdl("damage").str());
+    }
+    if (!cmdl("windows").str().empty()) {
+        options.window_count = std::max(1, std::atoi(cmdl("windows").str().c_str()));
+    }
+    if (!cmdl("duration").str().empty()) {
+        options.duration = std::max(0.1, std::atof(cmdl("duration").str().c_str()));
+    }
+    if (!cmdl("warmup").str().empty()) {
+        options.warmup = std::max(0.0, std::atof(cmdl("warmup").str().c_str()));
+    }
+    options.out_path = cmdl("out").str();
+    options.async_submission = cmdl["async"];
+    return options;
 }
 
-int main(int, char*[])
+int main(int argc, char** argv)
 {
-    void* revyv_ctx = revyv_context_create();
-
-    uint32_t window_id = create_window(revyv_ctx);
-
-    bool moveWindow = false;
-
-    revyv_window_move(revyv_ctx, window_id, 0, 0);
-    std::this_thread::sleep_for(std::chrono::milliseconds(250));
-    revyv_window_move(revyv_ctx, window_id, 100, 100);
-    std::this_thread::sleep_for(std::chrono::milliseconds(250));
-    revyv_window_move(revyv_ctx, window_id, 200, 200);
-
-    paint(revyv_ctx, window_id, 200, 200);
-    std::this_thread::sleep_for(std::chrono::milliseconds(250));
-    paint(revyv_ctx, window_id, 300, 200);
-    std::this_thread::sleep_for(std::chrono::milliseconds(250));
-    paint(revyv_ctx, window_id, 400, 200);
-
-    while (true) {
-        auto event = revyv_event_wait(revyv_ctx);
-        if (event.type == RevyvEventTypeMouseButton) {
-            if (event.mouse_event.button == RevyvMouseButtonTypeLeft) {
-                if (event.mouse_event.button_state == RevyvMouseButtonStatePressed) {
-                    std::cout << "Mouse left pressed" << std::endl;
-                } else if (event.mouse_event.button_state == RevyvMouseButtonStateReleased) {
-                    std::cout << "Mouse left released" << std::endl;
+    try {
+        auto options = parse_options(argc, argv);
+        void* revyv_ctx = revyv_context_create();
+        revyv_context_set_frame_acknowledgements(revyv_ctx, true);
+        revyv_context_set_async_submission(revyv_ctx, options.async_submission);
+
+        std::vector<LoadWindow> windows;
+        for (uint32_t i = 0; i < options.window_count; i++) {
+            windows.push_back(create_window(revyv_ctx, options, i));
+        }
+
+        auto frame_interval = (uint64_t)(1e9 / options.fps);
+        auto start = get_time_ns();
+        auto measure_at = start + (uint64_t)(options.warmup * 1e9);
+        auto end = measure_at + (uint64_t)(options.duration * 1e9);
+        auto next_frame_at = start;
+        bool measuring = false;
+        LoadCounters counters {};
+        std::vector<RevyvEvent> events(64);
+        for (auto now = start; now < end; now = get_time_ns()) {
+            if (!measuring && now >= measure_at) {
+                /* Whatever happened while the compositor warmed up is left out. */
+                measuring = true;
+                counters = {};
+                revyv_context_reset_frame_latency(revyv_ctx);
+            }
+            if (now >= next_frame_at) {
+                for (auto& window : windows) {
+                    counters.bytes_sent += paint(revyv_ctx, window, options);
+                    counters.updates_sent++;
                 }
-            } else if (event.mouse_event.button == RevyvMouseButtonTypeRight) {
-                if (event.mouse_event.button_state == RevyvMouseButtonStatePressed) {
-                    std::cout << "Mouse right pressed" << std::endl;
-                } else if (event.mouse_event.button_state == RevyvMouseButtonStateReleased) {
-                    std::cout << "Mouse right released" << std::endl;
+                next_frame_at += frame_interval;
+                if (next_frame_at < get_time_ns()) {
+                    counters.late_frames++;
+                    next_frame_at = get_time_ns();
                 }
+                continue;
             }
-        } else if (event.type == RevyvEventTypeMouseMove) {
-            std::cout << "Mouse move (" << event.mouse_event.x << "," << event.mouse_event.y << ") "
-                      << "[" << event.mouse_event.abs_x << "," << event.mouse_event.abs_y << "]" << std::endl;
-            if (moveWindow) {
-                revyv_window_move(
-                    revyv_ctx,
-                    window_id,
-                    event.mouse_event.abs_x - WINDOW_WIDTH / 2,
-                    event.mouse_event.abs_y - WINDOW_HEIGHT / 2);
-            } else {
-                paint(revyv_ctx, window_id, event.mouse_event.x, event.mouse_event.y);
-            }
-        } else if (event.type == RevyvEventTypeMouseScroll) {
-            std::cout << "Mouse scroll "
-                      << "(" << event.mouse_event.scroll_x << "," << event.mouse_event.scroll_y << ")"
-                      << std::endl;
-        } else if (event.type == RevyvEventTypeText) {
-            std::cout << event.text_event.text << std::flush;
-        } else if (event.type == RevyvEventTypeKey) {
-            if (event.key_event.scancode == REVYV_SCANCODE_RETURN && event.key_event.state == RevyvKeyStatePressed) {
-                moveWindow = !moveWindow;
-                std::cout << "Window move activated" << std::endl;
+            auto timeout_ms = (int)((next_frame_at - now) / 1000000);
+            auto count = revyv_event_poll(revyv_ctx, events.data(), events.size(), timeout_ms);
+            for (size_t i = 0; i < count; i++) {
+                if (events[i].type == RevyvEventTypeFramePresented) {
+                    counters.presented++;
+                }
             }
         }
+
+        auto latency = revyv_context_get_frame_latency(revyv_ctx);
+        if (!options.out_path.empty()) {
+            std::ofstream stream(options.out_path);
+            write_report(stream, options, counters, latency);
+        }
+        write_report(std::cout, options, counters, latency);
+
+        for (auto& window : windows) {
+            revyv_window_destroy(revyv_ctx, window.id);
+        }
+        revyv_context_destroy(revyv_ctx);
+        return 0;
+    } catch (std::exception& e) {
+        std::cout << __func__ << ": " << e.what() << std::endl;
+        return -1;
     }
 }
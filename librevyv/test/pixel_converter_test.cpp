@@ -0,0 +1,78 @@
+#include "pixel_converter.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace revyv;
+
+static const WindowRasterType RASTER_TYPES[] = { WindowRasterRGBA, WindowRasterARGB, WindowRasterABGR, WindowRasterBGRA };
+static const PixelAlphaOperation ALPHA_OPERATIONS[] = { PixelAlphaKeep, PixelAlphaPremultiply, PixelAlphaUnpremultiply };
+static const PixelConverterPath SIMD_PATHS[] = { PixelConverterPathSSE4, PixelConverterPathAVX2, PixelConverterPathNEON };
+
+static const char* get_alpha_operation_name(PixelAlphaOperation alpha_operation)
+{
+    switch (alpha_operation) {
+    case PixelAlphaPremultiply:
+        return "premultiply";
+    case PixelAlphaUnpremultiply:
+        return "unpremultiply";
+    default:
+        return "keep";
+    }
+}
+
+/*
+ * Every alpha value against every color value, with the alpha in each of
+ * the four bytes so it lands on the alpha channel whatever the raster type.
+ * Three more pixels leave a tail the SIMD kernels hand to the scalar one.
+ */
+static std::vector<unsigned char> make_pixels()
+{
+    std::vector<unsigned char> pixels;
+    for (int position = 0; position < 4; position++) {
+        for (int alpha = 0; alpha < 256; alpha++) {
+            for (int color = 0; color < 256; color++) {
+                for (int byte = 0; byte < 4; byte++) {
+                    pixels.push_back((unsigned char)(byte == position ? alpha : color));
+                }
+            }
+        }
+    }
+    pixels.resize(pixels.size() + 3 * 4, 0x80);
+    return pixels;
+}
+
+/* Every SIMD path the CPU has must give exactly what the scalar one gives, byte for byte. */
+int main()
+{
+    auto source = make_pixels();
+    auto pixel_count = source.size() / 4;
+    std::vector<unsigned char> expected(source.size());
+    std::vector<unsigned char> actual(source.size());
+    size_t failures = 0;
+    for (auto path : SIMD_PATHS) {
+        if (!PixelConverter::is_path_supported(path)) {
+            std::cout << "Skipping " << PixelConverter::get_path_name(path) << ", not supported" << std::endl;
+            continue;
+        }
+        for (auto from : RASTER_TYPES) {
+            for (auto to : RASTER_TYPES) {
+                for (auto alpha_operation : ALPHA_OPERATIONS) {
+                    PixelConverter(from, to, alpha_operation, PixelConverterPathScalar).convert(source.data(), expected.data(), pixel_count);
+                    PixelConverter(from, to, alpha_operation, path).convert(source.data(), actual.data(), pixel_count);
+                    size_t differences = 0;
+                    for (size_t i = 0; i < actual.size(); i++) {
+                        differences += actual[i] != expected[i] ? 1 : 0;
+                    }
+                    if (differences > 0) {
+                        failures++;
+                        std::cout << "FAILED: " << PixelConverter::get_path_name(path) << " " << PixelConverter::get_raster_type_name(from)
+                                  << " to " << PixelConverter::get_raster_type_name(to) << " " << get_alpha_operation_name(alpha_operation)
+                                  << ", " << differences << " bytes differ from scalar" << std::endl;
+                    }
+                }
+            }
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include "browser_app.h"
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+BrowserApp::BrowserApp()
+{
+    if (pipe(_wake_pipe) == -1) {
+        throw std::runtime_error("pipe() failed");
+    }
+    for (auto fd : _wake_pipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+}
+
+BrowserApp::~BrowserApp()
+{
+    close(_wake_pipe[0]);
+    close(_wake_pipe[1]);
+}
+
+CefRefPtr<CefBrowserProcessHandler> BrowserApp::GetBrowserProcessHandler()
+{
+    return this;
+}
+
+void BrowserApp::OnScheduleMessagePumpWork(int64_t delay_ms)
+{
+    {
+        /* A new request replaces the pending one. */
+        std::lock_guard<std::mutex> lock(_mutex);
+        _work_scheduled = true;
+        _work_time = Clock::now() + std::chrono::milliseconds(delay_ms > 0 ? delay_ms : 0);
+    }
+    wake();
+}
+
+int BrowserApp::get_fd() const
+{
+    return _wake_pipe[0];
+}
+
+void BrowserApp::wake() const
+{
+    char byte = 0;
+    /* A full pipe already wakes the loop. */
+    (void)!write(_wake_pipe[1], &byte, 1);
+}
+
+int BrowserApp::get_timeout()
+{
+    char bytes[64];
+    while (read(_wake_pipe[0], bytes, sizeof(bytes)) > 0) {
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_work_scheduled) {
+        return -1;
+    }
+    auto delay = std::chrono::ceil<std::chrono::milliseconds>(_work_time - Clock::now()).count();
+    return delay > 0 ? (int)delay : 0;
+}
+
+bool BrowserApp::take_due_work()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_work_scheduled || Clock::now() < _work_time) {
+        return false;
+    }
+    _work_scheduled = false;
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef BROWSERAPP_H
+#define BROWSERAPP_H
+
+#include "include/cef_app.h"
+#include <chrono>
+#include <mutex>
+
+/*
+ * Drives CEF's external message pump. CEF asks for message loop work from
+ * any thread, the main loop waits on get_fd() next to the revyv fd and
+ * calls CefDoMessageLoopWork() once take_due_work() says it is time.
+ */
+class BrowserApp : public CefApp, public CefBrowserProcessHandler {
+public:
+    BrowserApp();
+
+    ~BrowserApp() override;
+
+    CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler() override;
+
+    void OnScheduleMessagePumpWork(int64_t delay_ms) override;
+
+    /* Readable after work was scheduled or wake() was called. */
+    [[nodiscard]] int get_fd() const;
+
+    /* Async signal safe. */
+    void wake() const;
+
+    /* Milliseconds until the scheduled work is due, -1 when there is none. */
+    [[nodiscard]] int get_timeout();
+
+    /* Whether the scheduled work is due, which it then no longer is. */
+    bool take_due_work();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int _wake_pipe[2] = { -1, -1 };
+    std::mutex _mutex;
+    bool _work_scheduled = false;
+    Clock::time_point _work_time;
+
+    IMPLEMENT_REFCOUNTING(BrowserApp);
+};
+
+#endif
@@ -9,3 +9,18 @@ CefRefPtr<CefRenderHandler> BrowserClient::GetRenderHandler()
 {
     return _render_handler;
 }
+
+CefRefPtr<CefLifeSpanHandler> BrowserClient::GetLifeSpanHandler()
+{
+    return this;
+}
+
+void BrowserClient::OnBeforeClose(CefRefPtr<CefBrowser> browser)
+{
+    _closed = true;
+}
+
+bool BrowserClient::is_closed() const
+{
+    return _closed;
+}
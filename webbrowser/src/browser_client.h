@@ -4,14 +4,22 @@
 #include "include/cef_client.h"
 #include "render_handler.h"
 
-class BrowserClient : public CefClient {
+class BrowserClient : public CefClient, public CefLifeSpanHandler {
 public:
     explicit BrowserClient(RenderHandler* renderHandler);
 
     CefRefPtr<CefRenderHandler> GetRenderHandler() override;
 
+    CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override;
+
+    void OnBeforeClose(CefRefPtr<CefBrowser> browser) override;
+
+    /* Once the browser closed, CEF can be shut down. Only for the UI thread. */
+    [[nodiscard]] bool is_closed() const;
+
 private:
     CefRefPtr<CefRenderHandler> _render_handler;
+    bool _closed = false;
 
     IMPLEMENT_REFCOUNTING(BrowserClient);
 };
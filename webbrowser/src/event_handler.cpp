@@ -1,77 +1,82 @@
-#include "event_thread.h"
+#include "event_handler.h"
 #include "chromium_keycodes.h"
 #include "include/cef_app.h"
 #include "include/cef_render_handler.h"
-#include <revyv/revyv.h>
+#include "render_handler.h"
 
-void EventThread::event_thread(CefBrowser* browser, void* aslCtx)
+EventHandler::EventHandler(CefBrowser* browser)
+    : _browser(browser)
 {
-    RevyvEvent event;
-    bool mouse_down = false;
-    while (true) {
-        event = revyv_event_wait(aslCtx);
-        if (event.type == RevyvEventTypeMouseButton && event.mouse_event.button == RevyvMouseButtonTypeLeft
-            && event.mouse_event.button_state == RevyvMouseButtonStatePressed) {
-            mouse_down = true;
-            CefMouseEvent cef_mouse_event;
-            cef_mouse_event.x = (int)event.mouse_event.x;
-            cef_mouse_event.y = (int)event.mouse_event.y;
-            browser->GetHost()->SendMouseClickEvent(cef_mouse_event, MBT_LEFT, false, event.mouse_event.clicks <= 3 ? event.mouse_event.clicks : 3);
-        } else if (event.type == RevyvEventTypeMouseButton && event.mouse_event.button == RevyvMouseButtonTypeLeft
-            && event.mouse_event.button_state == RevyvMouseButtonStateReleased) {
-            mouse_down = false;
-            CefMouseEvent cef_mouse_event;
-            cef_mouse_event.x = (int)event.mouse_event.x;
-            cef_mouse_event.y = (int)event.mouse_event.y;
-            browser->GetHost()->SendMouseClickEvent(cef_mouse_event, MBT_LEFT, true, event.mouse_event.clicks <= 3 ? event.mouse_event.clicks : 3);
-        } else if (event.type == RevyvEventTypeMouseMove) {
-            CefMouseEvent cef_mouse_event;
-            if (mouse_down) {
-                cef_mouse_event.modifiers = EVENTFLAG_LEFT_MOUSE_BUTTON;
-            }
-            cef_mouse_event.x = (int)event.mouse_event.x;
-            cef_mouse_event.y = (int)event.mouse_event.y;
-            browser->GetHost()->SendMouseMoveEvent(cef_mouse_event, false);
-        } else if (event.type == RevyvEventTypeMouseScroll) {
-            CefMouseEvent cef_mouse_event;
-            cef_mouse_event.x = (int)event.mouse_event.x;
-            cef_mouse_event.y = (int)event.mouse_event.y;
-            int velocity = 20;
-            browser->GetHost()->SendMouseWheelEvent(cef_mouse_event, event.mouse_event.scroll_x * velocity, event.mouse_event.scroll_y * velocity);
-        } else if (event.type == RevyvEventTypeText) {
-            for (size_t i = 0; i < event.text_event.text_size; i++) {
-                CefKeyEvent cefEvent;
-                cefEvent.type = KEYEVENT_CHAR;
-                cefEvent.character = (unsigned char)event.text_event.text[0];
-                browser->GetHost()->SendKeyEvent(cefEvent);
-            }
-        } else if (event.type == RevyvEventTypeKey) {
-            CefKeyEvent cef_key_event;
-            cef_key_event.is_system_key = false;
-            cef_key_event.modifiers = get_chromium_key_modifiers(event.key_event.keymod);
-            if (event.key_event.state == RevyvKeyStatePressed) {
-                cef_key_event.type = KEYEVENT_KEYDOWN;
-            } else if (event.key_event.state == RevyvKeyStateReleased) {
-                cef_key_event.type = KEYEVENT_KEYUP;
-            }
-            auto code = get_chromium_keyboard_code(event.key_event.scancode);
-            if (code != VKEY_UNKNOWN) {
-                cef_key_event.windows_key_code = code;
-                browser->GetHost()->SendKeyEvent(cef_key_event);
-            }
-            /* Apparently, just sending a VKEY_RETURN is not enough, and not working
-             * properly in some cases. That's why we send here an additional KEYEVENT_CHAR. */
-            if (event.key_event.state == RevyvKeyStatePressed && event.key_event.scancode == REVYV_SCANCODE_RETURN) {
-                CefKeyEvent cef_char_event;
-                cef_char_event.type = KEYEVENT_CHAR;
-                cef_char_event.character = '\r';
-                browser->GetHost()->SendKeyEvent(cef_char_event);
-            }
+}
+
+void EventHandler::handle_event(const RevyvEvent& event)
+{
+    if (event.type == RevyvEventTypeMouseButton && event.mouse_event.button == RevyvMouseButtonTypeLeft
+        && event.mouse_event.button_state == RevyvMouseButtonStatePressed) {
+        _mouse_down = true;
+        CefMouseEvent cef_mouse_event;
+        cef_mouse_event.x = (int)event.mouse_event.x;
+        cef_mouse_event.y = (int)event.mouse_event.y;
+        _browser->GetHost()->SendMouseClickEvent(cef_mouse_event, MBT_LEFT, false, event.mouse_event.clicks <= 3 ? event.mouse_event.clicks : 3);
+    } else if (event.type == RevyvEventTypeMouseButton && event.mouse_event.button == RevyvMouseButtonTypeLeft
+        && event.mouse_event.button_state == RevyvMouseButtonStateReleased) {
+        _mouse_down = false;
+        CefMouseEvent cef_mouse_event;
+        cef_mouse_event.x = (int)event.mouse_event.x;
+        cef_mouse_event.y = (int)event.mouse_event.y;
+        _browser->GetHost()->SendMouseClickEvent(cef_mouse_event, MBT_LEFT, true, event.mouse_event.clicks <= 3 ? event.mouse_event.clicks : 3);
+    } else if (event.type == RevyvEventTypeMouseMove) {
+        CefMouseEvent cef_mouse_event;
+        if (_mouse_down) {
+            cef_mouse_event.modifiers = EVENTFLAG_LEFT_MOUSE_BUTTON;
+        }
+        cef_mouse_event.x = (int)event.mouse_event.x;
+        cef_mouse_event.y = (int)event.mouse_event.y;
+        _browser->GetHost()->SendMouseMoveEvent(cef_mouse_event, false);
+    } else if (event.type == RevyvEventTypeMouseScroll) {
+        CefMouseEvent cef_mouse_event;
+        cef_mouse_event.x = (int)event.mouse_event.x;
+        cef_mouse_event.y = (int)event.mouse_event.y;
+        int velocity = 20;
+        _browser->GetHost()->SendMouseWheelEvent(cef_mouse_event, event.mouse_event.scroll_x * velocity, event.mouse_event.scroll_y * velocity);
+    } else if (event.type == RevyvEventTypeText) {
+        for (size_t i = 0; i < event.text_event.text_size; i++) {
+            CefKeyEvent cefEvent;
+            cefEvent.type = KEYEVENT_CHAR;
+            cefEvent.character = (unsigned char)event.text_event.text[0];
+            _browser->GetHost()->SendKeyEvent(cefEvent);
+        }
+    } else if (event.type == RevyvEventTypeKey) {
+        CefKeyEvent cef_key_event;
+        cef_key_event.is_system_key = false;
+        cef_key_event.modifiers = get_chromium_key_modifiers(event.key_event.keymod);
+        if (event.key_event.state == RevyvKeyStatePressed) {
+            cef_key_event.type = KEYEVENT_KEYDOWN;
+        } else if (event.key_event.state == RevyvKeyStateReleased) {
+            cef_key_event.type = KEYEVENT_KEYUP;
+        }
+        auto code = get_chromium_keyboard_code(event.key_event.scancode);
+        if (code != VKEY_UNKNOWN) {
+            cef_key_event.windows_key_code = code;
+            _browser->GetHost()->SendKeyEvent(cef_key_event);
+        }
+        /* Apparently, just sending a VKEY_RETURN is not enough, and not working
+         * properly in some cases. That's why we send here an additional KEYEVENT_CHAR. */
+        if (event.key_event.state == RevyvKeyStatePressed && event.key_event.scancode == REVYV_SCANCODE_RETURN) {
+            CefKeyEvent cef_char_event;
+            cef_char_event.type = KEYEVENT_CHAR;
+            cef_char_event.character = '\r';
+            _browser->GetHost()->SendKeyEvent(cef_char_event);
         }
+    } else if (event.type == RevyvEventTypeWindowScale) {
+        auto render_handler = _browser->GetHost()->GetClient()->GetRenderHandler();
+        static_cast<RenderHandler*>(render_handler.get())->set_scale(event.scale_event.scale);
+        _browser->GetHost()->NotifyScreenInfoChanged();
+        _browser->GetHost()->WasResized();
     }
 }
 
-uint32_t EventThread::get_chromium_key_modifiers(int32_t keymod)
+uint32_t EventHandler::get_chromium_key_modifiers(int32_t keymod)
 {
     uint32_t result = 0;
     if ((keymod & REVYV_KMOD_LSHIFT) || (keymod & REVYV_KMOD_RSHIFT)) {
@@ -86,7 +91,7 @@ uint32_t EventThread::get_chromium_key_modifiers(int32_t keymod)
     return result;
 }
 
-int EventThread::get_chromium_keyboard_code(int32_t scancode)
+int EventHandler::get_chromium_keyboard_code(int32_t scancode)
 {
     switch (scancode) {
     case REVYV_SCANCODE_A:
@@ -0,0 +1,25 @@
+#ifndef EVENTHANDLER_H
+#define EVENTHANDLER_H
+
+#include "include/cef_browser.h"
+#include <cstdint>
+#include <revyv/revyv.h>
+
+/* Forwards revyv events to the browser, called from the browser's UI thread. */
+class EventHandler {
+public:
+    explicit EventHandler(CefBrowser* browser);
+
+    void handle_event(const RevyvEvent& event);
+
+private:
+    static int get_chromium_keyboard_code(int32_t scancode);
+
+    static uint32_t get_chromium_key_modifiers(int32_t keymod);
+
+private:
+    CefBrowser* _browser;
+    bool _mouse_down = false;
+};
+
+#endif
@@ -1,15 +1,29 @@
+#include "browser_app.h"
 #include "browser_client.h"
-#include "event_thread.h"
+#include "event_handler.h"
 #include "include/cef_app.h"
 #include "include/cef_render_handler.h"
 #include "render_handler.h"
 #include <argh.h>
+#include <csignal>
 #include <iostream>
+#include <poll.h>
 #include <revyv/revyv.h>
-#include <thread>
 
 void* revyv = nullptr;
 
+static const size_t MAX_EVENTS = 64;
+
+/* Set by SIGINT and SIGTERM, the browser is then closed and CEF shut down. */
+static volatile sig_atomic_t quit_requested = 0;
+static BrowserApp* signal_app = nullptr;
+
+static void request_quit(int)
+{
+    quit_requested = 1;
+    signal_app->wake();
+}
+
 int main(int argc, char* argv[])
 {
     CefMainArgs args(argc, argv);
@@ -37,7 +51,8 @@ int main(int argc, char* argv[])
         height = values[3];
     }
 
-    int result = CefExecuteProcess(args, nullptr, nullptr);
+    CefRefPtr<BrowserApp> app = new BrowserApp();
+    int result = CefExecuteProcess(args, app, nullptr);
     if (result >= 0) {
         // The child proccess terminated, we exit
         return result;
@@ -45,11 +60,15 @@ int main(int argc, char* argv[])
     if (result == -1) {
         /* Parent proccess */
         revyv = revyv_context_create();
+        /* OnPaint runs on the browser UI thread, which only copies the dirty rects then. */
+        revyv_context_set_async_submission(revyv, true);
     }
 
     CefSettings settings;
     settings.windowless_rendering_enabled = true;
-    if (!CefInitialize(args, settings, nullptr, nullptr)) {
+    /* CEF work is scheduled through the app, instead of polling for it. */
+    settings.external_message_pump = true;
+    if (!CefInitialize(args, settings, app, nullptr)) {
         return -1;
     }
 
@@ -62,12 +81,40 @@ int main(int argc, char* argv[])
     CefRefPtr<BrowserClient> browserClient = new BrowserClient(new RenderHandler(revyv, x, y, width, height));
     CefRefPtr<CefBrowser> browser = CefBrowserHost::CreateBrowserSync(window_info, browserClient.get(), url, browser_settings, nullptr, nullptr);
 
-    std::thread thread(EventThread::event_thread, browser.get(), revyv);
+    signal_app = app.get();
+    signal(SIGINT, request_quit);
+    signal(SIGTERM, request_quit);
 
-    CefRunMessageLoop();
-    CefShutdown();
+    /* Revyv events and browser work share this thread, it sleeps until either has something to do. */
+    EventHandler event_handler(browser.get());
+    RevyvEvent events[MAX_EVENTS];
+    pollfd fds[2] = { { revyv_context_get_fd(revyv), POLLIN, 0 }, { app->get_fd(), POLLIN, 0 } };
+    bool closing = false;
+    while (!browserClient->is_closed()) {
+        if (quit_requested && !closing) {
+            closing = true;
+            browser->GetHost()->CloseBrowser(true);
+        }
+        /* The revyv fd is edge triggered, drain everything that arrived. */
+        size_t count;
+        do {
+            count = revyv_event_poll(revyv, events, MAX_EVENTS, 0);
+            for (size_t i = 0; i < count; i++) {
+                event_handler.handle_event(events[i]);
+            }
+        } while (count == MAX_EVENTS);
+        if (app->take_due_work()) {
+            CefDoMessageLoopWork();
+            continue;
+        }
+        poll(fds, 2, app->get_timeout());
+    }
 
-    thread.join();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    browser = nullptr;
+    browserClient = nullptr;
+    CefShutdown();
 
     return 0;
 }
@@ -2,6 +2,7 @@
 #define RENDERHANDLER_H
 
 #include "include/cef_render_handler.h"
+#include <atomic>
 
 class RenderHandler : public CefRenderHandler {
 public:
@@ -9,8 +10,12 @@ public:
 
     void GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) override;
 
+    bool GetScreenInfo(CefRefPtr<CefBrowser> browser, CefScreenInfo& screen_info) override;
+
     void OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const void* buffer, int width, int height) override;
 
+    void set_scale(double scale);
+
 private:
     void* _revyv_ctx = nullptr;
     double _x {};
@@ -18,6 +23,9 @@ private:
     double _width {};
     double _height {};
     uint32_t _window_id {};
+    int _buffer_width {};
+    int _buffer_height {};
+    std::atomic<double> _scale { 1.0 };
 
 public:
     IMPLEMENT_REFCOUNTING(RenderHandler);